@@ -50,8 +50,16 @@ Application::Application(char *infile) {
 	srand (time(NULL));
 	par->setparams(infile);
 	log = new Log(par);
-	en = new EmulNet(par);
-	en1 = new EmulNet(par);
+	// MP1 and MP2 share the transport, on lanes of their own
+	if ( 0 == strcmp(par->TRANSPORT, "udp") ) {
+		en = new UdpTransport(par, par->PORTNUM);
+	}
+	else if ( 0 == strcmp(par->TRANSPORT, "shm") ) {
+		en = new ShmTransport(par);
+	}
+	else {
+		en = new EmulNet(par);
+	}
 	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
 	mp2 = (MP2Node **) malloc(par->EN_GPSZ * sizeof(MP2Node *));
 
@@ -66,7 +74,7 @@ Application::Application(char *infile) {
 		joinaddr = getjoinaddr();
 		addressOfMemberNode = (Address *) en->ENinit(addressOfMemberNode, par->PORTNUM);
 		mp1[i] = new MP1Node(memberNode, par, en, log, addressOfMemberNode);
-		mp2[i] = new MP2Node(memberNode, par, en1, log, addressOfMemberNode);
+		mp2[i] = new MP2Node(memberNode, par, en, log, addressOfMemberNode);
 		log->LOG(&(mp1[i]->getMemberNode()->addr), "APP");
 		log->LOG(&(mp2[i]->getMemberNode()->addr), "APP MP2");
 		delete addressOfMemberNode;
@@ -79,7 +87,6 @@ Application::Application(char *infile) {
 Application::~Application() {
 	delete log;
 	delete en;
-	delete en1;
 	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
 		delete mp1[i];
 		delete mp2[i];
@@ -120,9 +127,16 @@ int Application::run()
 		//fail();
 	}
 
+	// Keep the state of the surviving nodes for a warm restart
+	for ( i = 0; i <= par->EN_GPSZ-1; i++ ) {
+		if ( !mp2[i]->getMemberNode()->bFailed ) {
+			mp2[i]->saveSnapshot();
+			mp2[i]->logStats();
+		}
+	}
+
 	// Clean up
 	en->ENcleanup();
-	en1->ENcleanup();
 
 	for(i=0;i<=par->EN_GPSZ-1;i++) {
 		 mp1[i]->finishUpThisNode();
@@ -207,6 +221,10 @@ void Application::mp2Run() {
 			// Step 2
 			mp2[i]->recvLoop();
 		}
+		else if ( mp2[i]->getMemberNode()->bFailed ) {
+			// A failed node loses its in-memory state
+			mp2[i]->releaseStorage();
+		}
 	}
 
 	/**
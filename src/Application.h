@@ -13,6 +13,8 @@
 #include "Params.h"
 #include "Member.h"
 #include "EmulNet.h"
+#include "UdpTransport.h"
+#include "ShmTransport.h"
 #include "Queue.h"
 #include "MP2Node.h"
 #include "Node.h"
@@ -51,8 +53,7 @@ private:
 	// Address for introduction to the group
 	// Coordinator Node
 	char JOINADDR[30];
-	EmulNet *en;
-	EmulNet *en1;
+	Transport *en;
     Log *log;
 	MP1Node **mp1;
 	MP2Node **mp2;
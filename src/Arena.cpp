@@ -0,0 +1,197 @@
+/**********************************
+ * FILE NAME: Arena.cpp
+ *
+ * DESCRIPTION: Arena class definition
+ **********************************/
+
+#include "Arena.h"
+
+/*
+ * Block size of every size class, in bytes
+ */
+static const size_t classSizes[ARENA_CLASSES] = {
+	16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+/**
+ * constructor
+ */
+Arena::Arena(): large(NULL), bytesInUse(0), bytesAllocated(0), bytesReserved(0) {
+	for ( int i = 0; i < ARENA_CLASSES; i++ ) {
+		freeList[i] = NULL;
+		slabCursor[i] = NULL;
+		slabEnd[i] = NULL;
+	}
+}
+
+/**
+ * Destructor
+ */
+Arena::~Arena() {
+	reset();
+}
+
+/**
+ * FUNCTION NAME: sizeClass
+ *
+ * DESCRIPTION: Maps a request size to its size class
+ *
+ * RETURNS:
+ * class index, or -1 if the size is served by malloc
+ */
+int Arena::sizeClass(size_t size) {
+	if ( size > ARENA_MAX_SMALL ) {
+		return -1;
+	}
+	int i = 0;
+	while ( classSizes[i] < size ) {
+		i++;
+	}
+	return i;
+}
+
+/**
+ * FUNCTION NAME: classSize
+ *
+ * DESCRIPTION: Block size of a size class
+ */
+size_t Arena::classSize(int sizeClass) {
+	return classSizes[sizeClass];
+}
+
+/**
+ * FUNCTION NAME: blockSize
+ *
+ * DESCRIPTION: Bytes an allocation of size really takes: the block of its size class,
+ * 				or the requested bytes and their header for a large allocation
+ */
+size_t Arena::blockSize(size_t size) {
+	int c = sizeClass(size);
+	return c < 0 ? sizeof(ArenaLarge) + size : classSizes[c];
+}
+
+/**
+ * FUNCTION NAME: allocate
+ *
+ * DESCRIPTION: Returns a block of at least size bytes, 16 byte aligned
+ */
+void *Arena::allocate(size_t size) {
+	int c = sizeClass(size);
+	bytesInUse += size;
+	bytesAllocated += blockSize(size);
+
+	if ( c < 0 ) {
+		ArenaLarge *block = (ArenaLarge *) malloc(sizeof(ArenaLarge) + size);
+		block->prev = NULL;
+		block->next = large;
+		block->size = size;
+		if ( large != NULL ) {
+			large->prev = block;
+		}
+		large = block;
+		bytesReserved += sizeof(ArenaLarge) + size;
+		return block + 1;
+	}
+
+	if ( freeList[c] != NULL ) {
+		void *block = freeList[c];
+		freeList[c] = *(void **)block;
+		return block;
+	}
+
+	if ( slabCursor[c] == slabEnd[c] ) {
+		char *slab = (char *) malloc(ARENA_SLAB_SIZE);
+		slabs.push_back(slab);
+		bytesReserved += ARENA_SLAB_SIZE;
+		slabCursor[c] = slab;
+		slabEnd[c] = slab + (ARENA_SLAB_SIZE / classSizes[c]) * classSizes[c];
+	}
+	void *block = slabCursor[c];
+	slabCursor[c] += classSizes[c];
+	return block;
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Gives a block back to the arena. size must be the size it was allocated with.
+ */
+void Arena::release(void *block, size_t size) {
+	if ( block == NULL ) {
+		return;
+	}
+	int c = sizeClass(size);
+	bytesInUse -= size;
+	bytesAllocated -= blockSize(size);
+
+	if ( c < 0 ) {
+		ArenaLarge *header = (ArenaLarge *)block - 1;
+		if ( header->prev != NULL ) {
+			header->prev->next = header->next;
+		}
+		else {
+			large = header->next;
+		}
+		if ( header->next != NULL ) {
+			header->next->prev = header->prev;
+		}
+		bytesReserved -= sizeof(ArenaLarge) + header->size;
+		free(header);
+		return;
+	}
+
+	*(void **)block = freeList[c];
+	freeList[c] = block;
+}
+
+/**
+ * FUNCTION NAME: reset
+ *
+ * DESCRIPTION: Releases every block handed out by this arena at once
+ */
+void Arena::reset() {
+	for ( size_t i = 0; i < slabs.size(); i++ ) {
+		free(slabs[i]);
+	}
+	slabs.clear();
+	while ( large != NULL ) {
+		ArenaLarge *next = large->next;
+		free(large);
+		large = next;
+	}
+	for ( int i = 0; i < ARENA_CLASSES; i++ ) {
+		freeList[i] = NULL;
+		slabCursor[i] = NULL;
+		slabEnd[i] = NULL;
+	}
+	bytesInUse = 0;
+	bytesAllocated = 0;
+	bytesReserved = 0;
+}
+
+/**
+ * FUNCTION NAME: getBytesInUse
+ *
+ * DESCRIPTION: Bytes requested by live allocations
+ */
+size_t Arena::getBytesInUse() {
+	return bytesInUse;
+}
+
+/**
+ * FUNCTION NAME: getBytesAllocated
+ *
+ * DESCRIPTION: Bytes of the blocks held by live allocations
+ */
+size_t Arena::getBytesAllocated() {
+	return bytesAllocated;
+}
+
+/**
+ * FUNCTION NAME: getBytesReserved
+ *
+ * DESCRIPTION: Bytes obtained from the system (slabs and large blocks)
+ */
+size_t Arena::getBytesReserved() {
+	return bytesReserved;
+}
@@ -0,0 +1,77 @@
+/**********************************
+ * FILE NAME: Arena.h
+ *
+ * DESCRIPTION: Header file of Arena class
+ **********************************/
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// number of slab size classes
+#define ARENA_CLASSES 14
+// largest request served from a slab, bigger ones go to malloc
+#define ARENA_MAX_SMALL 2048
+// bytes carved into blocks at a time for one size class
+#define ARENA_SLAB_SIZE (32 * 1024)
+
+/**
+ * STRUCT NAME: ArenaLarge
+ *
+ * DESCRIPTION: Header in front of every allocation too big for a slab
+ */
+typedef struct ArenaLarge {
+	struct ArenaLarge *prev;
+	struct ArenaLarge *next;
+	size_t size;
+	size_t pad;
+} ArenaLarge;
+
+/**
+ * CLASS NAME: Arena
+ *
+ * DESCRIPTION: Size class slab allocator. Small blocks are carved out of slabs
+ * 				and recycled through per class free lists; everything the arena
+ * 				handed out is released at once by reset().
+ */
+class Arena {
+private:
+	// free list heads, linked through the freed blocks
+	void *freeList[ARENA_CLASSES];
+	// bump region of the current slab of every class
+	char *slabCursor[ARENA_CLASSES];
+	char *slabEnd[ARENA_CLASSES];
+	// every slab ever allocated
+	vector<char *> slabs;
+	// list of live large allocations
+	ArenaLarge *large;
+	size_t bytesInUse;
+	// bytesInUse rounded up to whole blocks, with the headers of large allocations
+	size_t bytesAllocated;
+	size_t bytesReserved;
+
+	Arena(const Arena &another);
+	Arena& operator =(const Arena &another);
+
+public:
+	Arena();
+	virtual ~Arena();
+	static int sizeClass(size_t size);
+	static size_t classSize(int sizeClass);
+	static size_t blockSize(size_t size);
+	void *allocate(size_t size);
+	void release(void *block, size_t size);
+	void reset();
+	size_t getBytesInUse();
+	size_t getBytesAllocated();
+	size_t getBytesReserved();
+};
+
+#endif /* ARENA_H_ */
@@ -0,0 +1,116 @@
+/**********************************
+ * FILE NAME: BloomFilter.cpp
+ *
+ * DESCRIPTION: BloomFilter class definition
+ **********************************/
+
+#include "BloomFilter.h"
+
+/**
+ * constructor
+ */
+BloomFilter::BloomFilter(size_t capacity): capacity(max(capacity, (size_t)BLOOM_MIN_KEYS)), keys(0) {
+	counters.assign(this->capacity * BLOOM_COUNTERS_PER_KEY, 0);
+}
+
+/**
+ * FUNCTION NAME: indexes
+ *
+ * DESCRIPTION: Counter positions of a hash, by double hashing over a remixed copy of it
+ */
+void BloomFilter::indexes(uint64_t hash, size_t *out) const {
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	uint64_t step = (hash >> 32) | 1;
+	for ( int i = 0; i < BLOOM_HASHES; i++ ) {
+		out[i] = hash % counters.size();
+		hash += step;
+	}
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Adds a key hash
+ */
+void BloomFilter::add(uint64_t hash) {
+	size_t idx[BLOOM_HASHES];
+	indexes(hash, idx);
+	for ( int i = 0; i < BLOOM_HASHES; i++ ) {
+		if ( counters[idx[i]] != BLOOM_SATURATED ) {
+			counters[idx[i]]++;
+		}
+	}
+	keys++;
+}
+
+/**
+ * FUNCTION NAME: remove
+ *
+ * DESCRIPTION: Removes a key hash that was added before
+ */
+void BloomFilter::remove(uint64_t hash) {
+	size_t idx[BLOOM_HASHES];
+	indexes(hash, idx);
+	for ( int i = 0; i < BLOOM_HASHES; i++ ) {
+		if ( counters[idx[i]] != BLOOM_SATURATED ) {
+			counters[idx[i]]--;
+		}
+	}
+	keys--;
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * RETURNS:
+ * false if the key hash is certainly absent
+ * true if it may be present
+ */
+bool BloomFilter::mayContain(uint64_t hash) const {
+	size_t idx[BLOOM_HASHES];
+	indexes(hash, idx);
+	for ( int i = 0; i < BLOOM_HASHES; i++ ) {
+		if ( counters[idx[i]] == 0 ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: isOverloaded
+ *
+ * DESCRIPTION: Returns if the filter holds more keys than it was sized for
+ */
+bool BloomFilter::isOverloaded() const {
+	return keys > capacity;
+}
+
+/**
+ * FUNCTION NAME: getCapacity
+ *
+ * DESCRIPTION: Returns the number of keys the filter was sized for
+ */
+size_t BloomFilter::getCapacity() const {
+	return capacity;
+}
+
+/**
+ * FUNCTION NAME: getKeys
+ *
+ * DESCRIPTION: Returns the number of keys in the filter
+ */
+size_t BloomFilter::getKeys() const {
+	return keys;
+}
+
+/**
+ * FUNCTION NAME: getFootprint
+ *
+ * DESCRIPTION: Returns the bytes the filter takes, its counters included
+ */
+size_t BloomFilter::getFootprint() const {
+	return sizeof(BloomFilter) + counters.capacity();
+}
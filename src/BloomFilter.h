@@ -0,0 +1,55 @@
+/**********************************
+ * FILE NAME: BloomFilter.h
+ *
+ * DESCRIPTION: Header file of BloomFilter class
+ **********************************/
+
+#ifndef BLOOMFILTER_H_
+#define BLOOMFILTER_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+// counters per key the filter is sized for (about 1% false positives)
+#define BLOOM_COUNTERS_PER_KEY 10
+// counters touched per key
+#define BLOOM_HASHES 7
+// keys a new filter is sized for
+#define BLOOM_MIN_KEYS 16
+// a counter that reaches this value is never decremented again
+#define BLOOM_SATURATED 255
+
+/**
+ * CLASS NAME: BloomFilter
+ *
+ * DESCRIPTION: Counting Bloom filter over 64 bit key hashes. Byte counters allow keys to be
+ * 				removed again; a saturated counter sticks, which can only cost false positives.
+ * 				The filter is sized for a number of keys and reports when it holds more, so
+ * 				the owner can rebuild it larger.
+ */
+class BloomFilter {
+private:
+	vector<unsigned char> counters;
+	size_t capacity;
+	size_t keys;
+
+	void indexes(uint64_t hash, size_t *out) const;
+
+public:
+	BloomFilter(size_t capacity);
+	void add(uint64_t hash);
+	void remove(uint64_t hash);
+	bool mayContain(uint64_t hash) const;
+	bool isOverloaded() const;
+	size_t getCapacity() const;
+	size_t getKeys() const;
+	size_t getFootprint() const;
+};
+
+#endif /* BLOOMFILTER_H_ */
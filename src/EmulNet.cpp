@@ -6,39 +6,28 @@
 
 #include "EmulNet.h"
 
+// share of a link with a bandwidth limit each lane gets while all lanes have frames waiting
+static const int laneWeight[EN_LANES] = { 8, 4, 2, 1 };
+static const char *laneName[EN_LANES] = { "membership", "request", "reply", "bulk" };
+
 /**
  * Constructor
  */
-EmulNet::EmulNet(Params *p)
+EmulNet::EmulNet(Params *p): Transport(p)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
-	int i,j;
-	par = p;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			sent_msgs[i][j] = 0;
-			recv_msgs[i][j] = 0;
-		}
-	}
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
 
 /**
  * Copy constructor
  */
-EmulNet::EmulNet(EmulNet &anotherEmulNet) {
-	int i, j;
-	this->par = anotherEmulNet.par;
+EmulNet::EmulNet(EmulNet &anotherEmulNet): Transport(anotherEmulNet.par) {
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->nodes = anotherEmulNet.nodes;
 	this->emulnet = anotherEmulNet.emulnet;
 }
 
@@ -46,15 +35,9 @@ EmulNet::EmulNet(EmulNet &anotherEmulNet) {
  * Assignment operator overloading
  */
 EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->nodes = anotherEmulNet.nodes;
 	this->emulnet = anotherEmulNet.emulnet;
 	return *this;
 }
@@ -77,103 +60,292 @@ void *EmulNet::ENinit(Address *myaddr, short port) {
 }
 
 /**
- * FUNCTION NAME: ENsend
- *
- * DESCRIPTION: EmulNet send function
+ * FUNCTION NAME: nodeOf
  *
- * RETURNS:
- * size
+ * DESCRIPTION: Counters of the node at addr, and room for its frames
  */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
-	en_msg *em;
-	static char temp[2048];
-	int sendmsg = rand() % 100;
+en_node &EmulNet::nodeOf(Address *addr) {
+	int id = *(int *)(addr->addr);
+	assert(id >= 0);
+	if ( id >= (int)nodes.size() ) {
+		nodes.resize(id + 1);
+	}
+	emulnet.grow(id);
+	return nodes[id];
+}
 
-	if( (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
-		return 0;
+/**
+ * FUNCTION NAME: countAt
+ *
+ * DESCRIPTION: Counts one message at tick time
+ */
+void EmulNet::countAt(vector<int> &counts, int time) {
+	if ( time >= (int)counts.size() ) {
+		counts.resize(time + 1, 0);
 	}
+	counts[time]++;
+}
 
-	em = (en_msg *)malloc(sizeof(en_msg) + size);
-	em->size = size;
+/**
+ * FUNCTION NAME: openFrame
+ *
+ * DESCRIPTION: Frame from myaddr to toaddr on lane with room for bytes more bytes. A frame
+ * 				only holds messages sent in the tick it was opened, so it is sent at that
+ * 				tick: one that is full or was opened in an earlier tick is closed, i.e.
+ * 				queued for delivery as it is, and a new one started.
+ */
+en_msg *EmulNet::openFrame(Address *myaddr, Address *toaddr, int bytes, int lane) {
+	int dst = *(int *)(toaddr->addr);
+	nodeOf(toaddr);
+	vector<en_msg *> &frames = emulnet.batches[dst];
+
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		en_msg *em = frames[i];
+		if ( em->lane != lane || memcmp(em->from.addr, myaddr->addr, sizeof(em->from.addr)) != 0 ) {
+			continue;
+		}
+		if ( em->time == par->getcurrtime() && em->size + bytes <= EN_BATCH_BYTES ) {
+			if ( em->size + bytes > em->capacity ) {
+				en_msg *bigger = allocFrame(em->size + bytes);
+				bigger->size = em->size;
+				bigger->time = em->time;
+				bigger->lane = em->lane;
+				memcpy(&(bigger->from.addr), &(em->from.addr), sizeof(em->from.addr));
+				memcpy(&(bigger->to.addr), &(em->to.addr), sizeof(em->to.addr));
+				memcpy((char *)(bigger + 1), (char *)(em + 1), em->size);
+				ENrelease(em);
+				em = bigger;
+				frames[i] = em;
+			}
+			return em;
+		}
+		emulnet.openframes--;
+		frames.erase(frames.begin() + i);
+		schedule(em);
+		break;
+	}
 
+	en_msg *em = allocFrame(bytes);
 	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
 	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
-	memcpy(em + 1, data, size);
+	em->time = par->getcurrtime();
+	em->lane = lane;
+	frames.push_back(em);
+	emulnet.openframes++;
+	nodeOf(myaddr).lanes[lane].frames++;
+	return em;
+}
 
-	emulnet.buff[emulnet.currbuffsize++] = em;
+/**
+ * FUNCTION NAME: ENreserve
+ *
+ * DESCRIPTION: Sends a message of size bytes that the caller writes into the returned
+ * 				buffer, which is the message's place in the open frame to its destination
+ * 				on lane. The buffer is valid until the next call to this EmulNet.
+ *
+ * RETURNS:
+ * the buffer, NULL if the message was dropped, also when NET_INBOX_LIMIT messages wait
+ * for toaddr on lane
+ */
+char *EmulNet::ENreserve(Address *myaddr, Address *toaddr, int size, int lane) {
+	en_msg *em;
 
-	int src = *(int *)(myaddr->addr);
-	int time = par->getcurrtime();
+	if ( dropped(size) ) {
+		return NULL;
+	}
+	en_lane &inbox = nodeOf(toaddr).lanes[lane];
+	if ( inbox.queued >= par->NET_INBOX_LIMIT ) {
+		inbox.overflow++;
+		return NULL;
+	}
 
-	assert(src <= MAX_NODES);
-	assert(time < MAX_TIME);
+	em = openFrame(myaddr, toaddr, sizeof(int) + size, lane);
+	char *end = (char *)(em + 1) + em->size;
+	memcpy(end, &size, sizeof(int));
+	em->size += sizeof(int) + size;
+
+	en_node &src = nodeOf(myaddr);
+	countAt(src.sent, par->getcurrtime());
+	src.lanes[lane].sent++;
+	en_lane &dst = nodeOf(toaddr).lanes[lane];
+	if ( ++dst.queued >= par->NET_HIGH_WATERMARK && !dst.congested ) {
+		dst.congested = true;
+		dst.backpressure++;
+	}
+
+	return end + sizeof(int);
+}
 
-	sent_msgs[src][time]++;
+/**
+ * FUNCTION NAME: schedule
+ *
+ * DESCRIPTION: Closes a frame sent at tick frame->time: queues it on its link if the link
+ * 				has a bandwidth limit, or else in the inbox of its destination right away,
+ * 				due after the delay of the link from that tick on
+ */
+void EmulNet::schedule(en_msg *frame) {
+	int src, dst;
+	memcpy(&src, frame->from.addr, sizeof(int));
+	memcpy(&dst, frame->to.addr, sizeof(int));
+	LinkModel model = par->linkModel(src, dst);
+
+	if ( model.bandwidth == 0 ) {
+		arrive(frame, frame->time, model);
+		return;
+	}
+	en_link &link = nodeOf(&frame->to).links[src];
+	int lane = frame->lane;
+	double tag = max(link.virtualTime, link.lastTag[lane]) + (double)frame->size / laneWeight[lane];
+	link.lastTag[lane] = tag;
+	link.queue[lane].push_back(make_pair(tag, frame));
+}
 
-	#ifdef DEBUGLOG
-		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
-	#endif
+/**
+ * FUNCTION NAME: arrive
+ *
+ * DESCRIPTION: Queues a frame its link sent at tick sent in the inbox of its destination,
+ * 				due after the latency and jitter of the link
+ */
+void EmulNet::arrive(en_msg *frame, double sent, LinkModel &link) {
+	int dst;
+	memcpy(&dst, frame->to.addr, sizeof(int));
 
-	return size;
+	frame->time = (int)ceil(sent) + link.latency;
+	if ( link.jitter > 0 ) {
+		frame->time += rand() % (link.jitter + 1);
+	}
+
+	emulnet.inbox[dst * EN_LANES + frame->lane].insert(make_pair(frame->time, frame));
+	emulnet.currbuffsize++;
 }
 
 /**
- * FUNCTION NAME: ENsend
+ * FUNCTION NAME: advance
  *
- * DESCRIPTION: EmulNet send function
+ * DESCRIPTION: Sends the frames queued on a link with a bandwidth limit that the link
+ * 				starts sending by tick now. A frame is chosen once the link is free, among
+ * 				the frames closed by then, so later frames never overtake it.
+ */
+void EmulNet::advance(en_link &link, LinkModel &model, int now) {
+	while ( true ) {
+		// the link idles until the first frame
+		double start = -1;
+		for ( int lane = 0; lane < EN_LANES; lane++ ) {
+			if ( !link.queue[lane].empty() && (start < 0 || link.queue[lane].front().second->time < start) ) {
+				start = link.queue[lane].front().second->time;
+			}
+		}
+		if ( start < 0 ) {
+			return;
+		}
+		start = max(start, link.clock);
+		if ( start > now ) {
+			return;
+		}
+
+		int next = -1;
+		for ( int lane = 0; lane < EN_LANES; lane++ ) {
+			if ( link.queue[lane].empty() || link.queue[lane].front().second->time > start ) {
+				continue;
+			}
+			if ( next < 0 || link.queue[lane].front().first < link.queue[next].front().first ) {
+				next = lane;
+			}
+		}
+		en_msg *frame = link.queue[next].front().second;
+		link.virtualTime = link.queue[next].front().first;
+		link.queue[next].pop_front();
+		link.clock = start + (double)frame->size / model.bandwidth;
+		arrive(frame, link.clock, model);
+	}
+}
+
+/**
+ * FUNCTION NAME: takeFrame
  *
- * RETURNS:
- * size
- */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
-	char * str = (char *) malloc(data.length() * sizeof(char));
-	memcpy(str, data.c_str(), data.size());
-	int ret = this->ENsend(myaddr, toaddr, str, (data.length() * sizeof(char)));
-	free(str);
-	return ret;
+ * DESCRIPTION: Appends a delivered frame to frames, counting its messages as received
+ */
+void EmulNet::takeFrame(en_msg *frame, vector<en_msg *> &frames, en_node &node) {
+	int time = par->getcurrtime();
+	en_lane &lane = node.lanes[frame->lane];
+	int pos = 0;
+	char *data;
+	int sz;
+	while ( ENnext(frame, pos, data, sz) ) {
+		countAt(node.recv, time);
+		lane.recv++;
+		lane.queued--;
+	}
+	frames.push_back(frame);
 }
 
 /**
- * FUNCTION NAME: ENrecv
+ * FUNCTION NAME: ENrecvFrames
  *
- * DESCRIPTION: EmulNet receive function
+ * DESCRIPTION: Zero copy receive: closes the frames open to myaddr on lanes and appends
+ * 				the frames due for it on lanes to frames, lane by lane in priority order and
+ * 				in the order they are due. The caller reads the messages in place with
+ * 				ENnext and gives every frame back with ENrelease.
  *
  * RETURN:
- * 0
+ * number of frames taken
  */
-int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
-	// times is always assumed to be 1
-	int i;
-	char* tmp;
-	int sz;
-	en_msg *emsg;
-
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
+int EmulNet::ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes) {
+	int dst = *(int *)(myaddr->addr);
+	int now = par->getcurrtime();
+	nodeOf(myaddr);
+	size_t before = frames.size();
+
+	vector<en_msg *> &open = emulnet.batches[dst];
+	size_t kept = 0;
+	for ( size_t i = 0; i < open.size(); i++ ) {
+		if ( lanes & LANE_MASK(open[i]->lane) ) {
+			emulnet.openframes--;
+			schedule(open[i]);
+		}
+		else {
+			open[kept++] = open[i];
+		}
+	}
+	open.resize(kept);
 
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
+	en_node &node = nodeOf(myaddr);
+	for ( map<int, en_link>::iterator it = node.links.begin(); it != node.links.end(); it++ ) {
+		LinkModel model = par->linkModel(it->first, dst);
+		advance(it->second, model, now);
+	}
 
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
+	for ( int lane = 0; lane < EN_LANES; lane++ ) {
+		if ( !(lanes & LANE_MASK(lane)) ) {
+			continue;
+		}
+		multimap<int, en_msg *> &inbox = emulnet.inbox[dst * EN_LANES + lane];
+		multimap<int, en_msg *>::iterator due = inbox.upper_bound(now);
+		for ( multimap<int, en_msg *>::iterator it = inbox.begin(); it != due; it++ ) {
 			emulnet.currbuffsize--;
+			takeFrame(it->second, frames, node);
+		}
+		inbox.erase(inbox.begin(), due);
 
-			(*enq)(queue, (char *)tmp, sz);
-
-			free(emsg);
-
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
-
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
-
-			recv_msgs[dst][time]++;
+		// senders may go on once the node caught up, well below the high watermark so
+		// that a node receiving a little at a time does not flap between the two states
+		if ( node.lanes[lane].queued < par->lowWatermark() ) {
+			node.lanes[lane].congested = false;
 		}
 	}
 
-	return 0;
+	return frames.size() - before;
+}
+
+/**
+ * FUNCTION NAME: ENcongested
+ *
+ * DESCRIPTION: Backpressure signal: whether senders to toaddr should hold their messages
+ * 				on lane back, e.g. queue them locally, until toaddr catches up. Messages
+ * 				sent anyway are still delivered.
+ */
+bool EmulNet::ENcongested(Address *toaddr, int lane) {
+	return nodeOf(toaddr).lanes[lane].congested;
 }
 
 /**
@@ -188,31 +360,67 @@ int EmulNet::ENcleanup() {
 
 	FILE* file = fopen("msgcount.log", "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	for ( i = 0; i < (int)emulnet.inbox.size(); i++ ) {
+		for ( multimap<int, en_msg *>::iterator it = emulnet.inbox[i].begin(); it != emulnet.inbox[i].end(); it++ ) {
+			free(it->second);
+		}
+		emulnet.inbox[i].clear();
+	}
+	for ( i = 0; i < (int)emulnet.batches.size(); i++ ) {
+		for ( j = 0; j < (int)emulnet.batches[i].size(); j++ ) {
+			free(emulnet.batches[i][j]);
+		}
+		emulnet.batches[i].clear();
+	}
+	emulnet.currbuffsize = 0;
+	emulnet.openframes = 0;
+	releasePool();
+	for ( i = 0; i < (int)nodes.size(); i++ ) {
+		for ( map<int, en_link>::iterator it = nodes[i].links.begin(); it != nodes[i].links.end(); it++ ) {
+			for ( int lane = 0; lane < EN_LANES; lane++ ) {
+				for ( size_t k = 0; k < it->second.queue[lane].size(); k++ ) {
+					free(it->second.queue[lane][k].second);
+				}
+			}
+		}
+		nodes[i].links.clear();
+		for ( int lane = 0; lane < EN_LANES; lane++ ) {
+			nodes[i].lanes[lane].queued = 0;
+			nodes[i].lanes[lane].congested = false;
+		}
 	}
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
+		// a node that never sent nor received has no counters
+		en_node none;
+		en_node &node = i < (int)nodes.size() ? nodes[i] : none;
 		fprintf(file, "node %3d ", i);
 		sent_total = 0;
 		recv_total = 0;
 
 		for (j = 0; j < par->getcurrtime(); j++) {
+			int sent = j < (int)node.sent.size() ? node.sent[j] : 0;
+			int recv = j < (int)node.recv.size() ? node.recv[j] : 0;
 
-			sent_total += sent_msgs[i][j];
-			recv_total += recv_msgs[i][j];
+			sent_total += sent;
+			recv_total += recv;
 			if (i != 67) {
-				fprintf(file, " (%4d, %4d)", sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, " (%4d, %4d)", sent, recv);
 				if (j % 10 == 9) {
 					fprintf(file, "\n         ");
 				}
 			}
 			else {
-				fprintf(file, "special %4d %4d %4d\n", j, sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, "special %4d %4d %4d\n", j, sent, recv);
 			}
 		}
 		fprintf(file, "\n");
-		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
+		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n", i, sent_total, recv_total);
+		for ( int lane = 0; lane < EN_LANES; lane++ ) {
+			en_lane &counters = node.lanes[lane];
+			fprintf(file, "         %-10s sent %6u  recv %6u  frames %6u  backpressure %6u  overflow %6u\n", laneName[lane], counters.sent, counters.recv, counters.frames, counters.backpressure, counters.overflow);
+		}
+		fprintf(file, "\n");
 	}
 
 	fclose(file);
@@ -7,27 +7,71 @@
 #ifndef _EMULNET_H_
 #define _EMULNET_H_
 
-#define MAX_NODES 1000
-#define MAX_TIME 3600
-#define ENBUFFSIZE 30000
-
 #include "stdincludes.h"
+#include <deque>
 #include "Params.h"
 #include "Member.h"
+#include "Transport.h"
 
 using namespace std;
 
 /**
- * Struct Name: en_msg
+ * Struct Name: en_lane
+ *
+ * DESCRIPTION: Traffic counters of one lane of a node
+ */
+typedef struct en_lane {
+	// Messages sent and received, and frames sent
+	int sent;
+	int recv;
+	int frames;
+	// Messages waiting for the node, and whether senders to it are held back
+	int queued;
+	bool congested;
+	// Times senders to the node were held back
+	int backpressure;
+	// Messages dropped because NET_INBOX_LIMIT messages were waiting for the node
+	int overflow;
+	en_lane(): sent(0), recv(0), frames(0), queued(0), congested(false), backpressure(0), overflow(0) {}
+} en_lane;
+
+/**
+ * Struct Name: en_link
+ *
+ * DESCRIPTION: Link with a bandwidth limit into a node. Closed frames wait in the queue of
+ * 				their lane and are sent one at a time by self clocked fair queuing: every
+ * 				frame is tagged with the virtual time it would be done at if the link
+ * 				were shared by the lanes in proportion to their weight, and the link
+ * 				sends the frame with the lowest tag among those sent by then.
  */
-typedef struct en_msg {
-	// Number of bytes after the class
-	int size;
-	// Source node
-	Address from;
-	// Destination node
-	Address to;
-}en_msg;
+typedef struct en_link {
+	// frames waiting to be sent by lane, with their tags
+	deque<pair<double, en_msg*> > queue[EN_LANES];
+	double lastTag[EN_LANES];
+	// tag of the frame sent last
+	double virtualTime;
+	// tick up to which the link is busy sending
+	double clock;
+	en_link(): virtualTime(0), clock(0) {
+		for ( int i = 0; i < EN_LANES; i++ ) {
+			lastTag[i] = 0;
+		}
+	}
+} en_link;
+
+/**
+ * Struct Name: en_node
+ *
+ * DESCRIPTION: Traffic counters of one node, grown as the node and the run go on
+ */
+typedef struct en_node {
+	// Messages sent and received on all lanes, per tick
+	vector<int> sent;
+	vector<int> recv;
+	en_lane lanes[EN_LANES];
+	// Links with a bandwidth limit into the node, by source node id
+	map<int, en_link> links;
+} en_node;
 
 /**
  * Class Name: EM
@@ -37,19 +81,28 @@ public:
 	int nextid;
 	int currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
-	EM() {}
+	// closed frames by destination node id and lane, keyed and ordered by the tick they are due
+	vector<multimap<int, en_msg*> > inbox;
+	// frames still accepting messages, by destination node id
+	vector<vector<en_msg*> > batches;
+	int openframes;
+	EM(): openframes(0) {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->inbox = anotherEM.inbox;
+		this->batches = anotherEM.batches;
+		this->openframes = anotherEM.openframes;
 		return *this;
 	}
+	// makes room for the frames of node id
+	void grow(int id) {
+		if ( id >= (int)batches.size() ) {
+			inbox.resize((id + 1) * EN_LANES);
+			batches.resize(id + 1);
+		}
+	}
 	int getNextId() {
 		return nextid;
 	}
@@ -74,25 +127,47 @@ public:
 /**
  * CLASS NAME: EmulNet
  *
- * DESCRIPTION: This class defines an emulated network
+ * DESCRIPTION: This class defines an emulated network. Messages sent from one node to
+ * 				another are coalesced into one frame until the destination receives, the
+ * 				tick ends or the frame reaches EN_BATCH_BYTES, so a burst costs one buffer
+ * 				slot and one allocation per destination rather than one per message. Frames
+ * 				wait in the inbox of their destination, so a receive only touches its own.
+ * 				The buffer grows as needed. Once NET_HIGH_WATERMARK messages wait for a
+ * 				node, ENcongested asks its senders to hold back until fewer than the low
+ * 				watermark (Params::lowWatermark) are left waiting; once
+ * 				NET_INBOX_LIMIT wait on a lane, what is sent to it on the lane is dropped,
+ * 				as a full ENBUFFSIZE buffer used to, so a node that never receives
+ * 				cannot make the buffer grow without bound.
+ * 				A closed frame is due after the delay of its link (Params::linkModel):
+ * 				latency, up to jitter more ticks, which reorders frames, and the time the
+ * 				frames queued on the link before it take at its bandwidth, from the tick
+ * 				its messages were sent. A message sent at tick t is delivered by the first receive from tick t + delay on, and never
+ * 				before the next receive. Lanes share a link with a bandwidth limit by
+ * 				weight, membership first; each has its own inbox and backpressure.
  */
-class EmulNet
+class EmulNet : public Transport
 { 	
 private:
-	Params* par;
-	int sent_msgs[MAX_NODES + 1][MAX_TIME];
-	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	// counters by node id
+	vector<en_node> nodes;
 	int enInited;
 	EM emulnet;
+	en_node &nodeOf(Address *addr);
+	static void countAt(vector<int> &counts, int time);
+	en_msg *openFrame(Address *myaddr, Address *toaddr, int bytes, int lane);
+	void schedule(en_msg *frame);
+	void arrive(en_msg *frame, double sent, LinkModel &link);
+	void advance(en_link &link, LinkModel &model, int now);
+	void takeFrame(en_msg *frame, vector<en_msg *> &frames, en_node &node);
 public:
  	EmulNet(Params *p);
  	EmulNet(EmulNet &anotherEmulNet);
  	EmulNet& operator = (EmulNet &anotherEmulNet);
  	virtual ~EmulNet();
 	void *ENinit(Address *myaddr, short port);
-	int ENsend(Address *myaddr, Address *toaddr, string data);
-	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
-	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	char *ENreserve(Address *myaddr, Address *toaddr, int size, int lane);
+	int ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes);
+	bool ENcongested(Address *toaddr, int lane);
 	int ENcleanup();
 };
 
@@ -5,37 +5,197 @@
  **********************************/
 #include "Entry.h"
 
+/**
+ * constructor
+ */
+Record::Record(): value(NULL) {
+	memset(&header, 0, sizeof(header));
+}
+
+/**
+ * constructor
+ *
+ * DESCRIPTION: View the record starting at data
+ */
+Record::Record(const char *data) {
+	memcpy(&header, data, sizeof(header));
+	value = data + sizeof(RecordHeader);
+}
+
+/**
+ * FUNCTION NAME: matches
+ *
+ * DESCRIPTION: Returns if the size bytes at data hold exactly one record: a header and
+ * 				as many value bytes as it says
+ */
+bool Record::matches(const char *data, size_t size) {
+	RecordHeader stored;
+	if ( size < sizeof(stored) ) {
+		return false;
+	}
+	memcpy(&stored, data, sizeof(stored));
+	return stored.valueLen == size - sizeof(stored);
+}
+
+/**
+ * FUNCTION NAME: getTimestamp
+ *
+ * DESCRIPTION: getter
+ */
+int Record::getTimestamp() {
+	return header.timestamp;
+}
+
+/**
+ * FUNCTION NAME: getExpires
+ *
+ * DESCRIPTION: getter
+ */
+int Record::getExpires() {
+	return header.expires;
+}
+
+/**
+ * FUNCTION NAME: getReplica
+ *
+ * DESCRIPTION: getter
+ */
+ReplicaType Record::getReplica() {
+	return static_cast<ReplicaType>(header.replica);
+}
+
+/**
+ * FUNCTION NAME: getFlags
+ *
+ * DESCRIPTION: getter
+ */
+unsigned char Record::getFlags() {
+	return header.flags;
+}
+
+/**
+ * FUNCTION NAME: isTombstone
+ *
+ * DESCRIPTION: Returns if the record marks a deleted key
+ */
+bool Record::isTombstone() {
+	return (header.flags & RECORD_TOMBSTONE) != 0;
+}
+
+/**
+ * FUNCTION NAME: getValueLength
+ *
+ * DESCRIPTION: getter
+ */
+unsigned int Record::getValueLength() {
+	return header.valueLen;
+}
+
+/**
+ * FUNCTION NAME: getValue
+ *
+ * DESCRIPTION: Copy of the value bytes
+ */
+string Record::getValue() {
+	return string(value, header.valueLen);
+}
+
 /**
  * constructor
  */
 Entry::Entry(string _value, int _timestamp, ReplicaType _replica){
 	this->delimiter = ":";
-	value = _value;
+	valueData = NULL;
+	valueSize = 0;
+	value = std::move(_value);
 	timestamp = _timestamp;
 	replica = _replica;
+	flags = 0;
+	expires = 0;
+}
+
+/**
+ * constructor
+ */
+Entry::Entry(string _value, int _timestamp, ReplicaType _replica, unsigned char _flags){
+	this->delimiter = ":";
+	valueData = NULL;
+	valueSize = 0;
+	value = std::move(_value);
+	timestamp = _timestamp;
+	replica = _replica;
+	flags = _flags;
+	expires = 0;
 }
 
 /**
  * constructor
  *
- * DESCRIPTION: Convert string to get an Entry object
+ * DESCRIPTION: Entry viewing the _valueSize bytes at _value, e.g. in a received message,
+ * 				so that storing it copies them once, into the table
  */
-Entry::Entry(string entry){
-	vector<string> tuple;
+Entry::Entry(const char *_value, size_t _valueSize, int _timestamp, ReplicaType _replica, unsigned char _flags){
 	this->delimiter = ":";
-	size_t pos = entry.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = entry.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + delimiter.size();
-		pos = entry.find(delimiter, start);
-	}
-	tuple.push_back(entry.substr(start));
+	valueData = _value;
+	valueSize = _valueSize;
+	timestamp = _timestamp;
+	replica = _replica;
+	flags = _flags;
+	expires = 0;
+}
+
+/**
+ * constructor
+ *
+ * DESCRIPTION: Get an Entry object from a stored record
+ */
+Entry::Entry(Record record){
+	this->delimiter = ":";
+	valueData = NULL;
+	valueSize = 0;
+	value.assign(record.value, record.getValueLength());
+	timestamp = record.getTimestamp();
+	replica = record.getReplica();
+	flags = record.getFlags();
+	expires = record.getExpires();
+}
 
-	value = tuple.at(0);
-	timestamp = stoi(tuple.at(1));
-	replica = static_cast<ReplicaType>(stoi(tuple.at(2)));
+/**
+ * FUNCTION NAME: getValueData
+ *
+ * DESCRIPTION: The value bytes, viewed or in value
+ */
+const char *Entry::getValueData() {
+	return valueData != NULL ? valueData : value.data();
+}
+
+/**
+ * FUNCTION NAME: getValueSize
+ *
+ * DESCRIPTION: Number of value bytes
+ */
+size_t Entry::getValueSize() {
+	return valueData != NULL ? valueSize : value.size();
+}
+
+/**
+ * FUNCTION NAME: isTombstone
+ *
+ * DESCRIPTION: Returns if the entry marks a deleted key
+ */
+bool Entry::isTombstone() {
+	return (flags & RECORD_TOMBSTONE) != 0;
+}
+
+/**
+ * FUNCTION NAME: supersedes
+ *
+ * DESCRIPTION: Returns if a version of a key written at timestamp replaces one written at
+ * 				otherTimestamp: the newer one wins, and a delete wins a tie, so that a
+ * 				write and a delete in the same tick leave the key deleted everywhere
+ */
+bool Entry::supersedes(int timestamp, bool tombstone, int otherTimestamp, bool otherTombstone) {
+	return timestamp > otherTimestamp || (timestamp == otherTimestamp && tombstone && !otherTombstone);
 }
 
 /**
@@ -44,5 +204,35 @@ Entry::Entry(string entry){
  * DESCRIPTION: Convert the object to a string representation
  */
 string Entry::convertToString() {
-	return value + delimiter + to_string(timestamp) + delimiter + to_string(replica);
+	string entry;
+	entry.reserve(getValueSize() + 32);
+	entry.append(getValueData(), getValueSize());
+	entry += delimiter + to_string(timestamp) + delimiter + to_string(replica) + delimiter + to_string(flags);
+	return entry;
+}
+
+/**
+ * FUNCTION NAME: recordSize
+ *
+ * DESCRIPTION: Size of the binary record (header and value bytes)
+ */
+size_t Entry::recordSize() {
+	return sizeof(RecordHeader) + getValueSize();
+}
+
+/**
+ * FUNCTION NAME: writeRecord
+ *
+ * DESCRIPTION: Write the binary record into buffer, which holds recordSize() bytes
+ */
+void Entry::writeRecord(char *buffer) {
+	RecordHeader header;
+	header.timestamp = timestamp;
+	header.expires = expires;
+	header.replica = (unsigned char)replica;
+	header.flags = flags;
+	header.reserved = 0;
+	header.valueLen = getValueSize();
+	memcpy(buffer, &header, sizeof(RecordHeader));
+	memcpy(buffer + sizeof(RecordHeader), getValueData(), getValueSize());
 }
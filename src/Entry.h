@@ -4,9 +4,57 @@
  * DESCRIPTION: Header file Entry class
  **********************************/
 
+#ifndef ENTRY_H_
+#define ENTRY_H_
+
 #include "stdincludes.h"
 #include "Message.h"
 
+/*
+ * Macros
+ */
+// record flag: the key was deleted at the record's timestamp, the value is empty
+#define RECORD_TOMBSTONE 0x01
+
+/**
+ * STRUCT NAME: RecordHeader
+ *
+ * DESCRIPTION: Fixed binary header stored in front of the value bytes of every
+ * 				record held by the HashTable
+ */
+typedef struct RecordHeader {
+	int timestamp;
+	// globaltime at which the record expires, 0 if it never does
+	int expires;
+	unsigned char replica;
+	unsigned char flags;
+	unsigned short reserved;
+	unsigned int valueLen;
+} RecordHeader;
+
+/**
+ * CLASS NAME: Record
+ *
+ * DESCRIPTION: Read only view of a stored record. The header is copied out, since a
+ * 				record of a mapped snapshot need not be aligned; the value points into the
+ * 				HashTable and is valid until the table is modified.
+ */
+class Record {
+public:
+	RecordHeader header;
+	const char *value;
+	Record();
+	Record(const char *data);
+	static bool matches(const char *data, size_t size);
+	int getTimestamp();
+	int getExpires();
+	ReplicaType getReplica();
+	unsigned char getFlags();
+	bool isTombstone();
+	unsigned int getValueLength();
+	string getValue();
+};
+
 /**
  * CLASS NAME: Entry
  *
@@ -15,11 +63,27 @@
 class Entry{
 public:
 	string value;
+	// value bytes the Entry views instead of holding them in value, NULL if it holds them
+	const char *valueData;
+	size_t valueSize;
 	int timestamp;
 	ReplicaType replica;
+	unsigned char flags;
+	// kept in the stored record only, not in the string form
+	int expires;
 	string delimiter;
 
-	Entry(string entry);
 	Entry(string _value, int _timestamp, ReplicaType _replica);
+	Entry(string _value, int _timestamp, ReplicaType _replica, unsigned char _flags);
+	Entry(const char *_value, size_t _valueSize, int _timestamp, ReplicaType _replica, unsigned char _flags);
+	Entry(Record record);
+	const char *getValueData();
+	size_t getValueSize();
+	bool isTombstone();
+	static bool supersedes(int timestamp, bool tombstone, int otherTimestamp, bool otherTombstone);
 	string convertToString();
+	size_t recordSize();
+	void writeRecord(char *buffer);
 };
+
+#endif /* ENTRY_H_ */
@@ -0,0 +1,684 @@
+/**********************************
+ * FILE NAME: FlatTable.cpp
+ *
+ * DESCRIPTION: FlatTable class definition
+ **********************************/
+
+#include "FlatTable.h"
+
+/**
+ * FUNCTION NAME: matchGroup
+ *
+ * DESCRIPTION: Compares FT_GROUP_WIDTH control bytes against value
+ *
+ * RETURNS:
+ * bit mask with bit i set when group[i] == value
+ */
+static inline unsigned int matchGroup(const signed char *group, signed char value) {
+#ifdef __SSE2__
+	__m128i ctrlBytes = _mm_loadu_si128((const __m128i *)group);
+	return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrlBytes, _mm_set1_epi8(value)));
+#else
+	unsigned int mask = 0;
+	for ( int i = 0; i < FT_GROUP_WIDTH; i++ ) {
+		if ( group[i] == value ) {
+			mask |= (1u << i);
+		}
+	}
+	return mask;
+#endif
+}
+
+/**
+ * constructor
+ */
+FlatTable::FlatTable(): ctrl(NULL), slots(NULL), capacity(0), size(0), bytes(0), arena(new Arena()), ownsArena(true) {}
+
+/**
+ * constructor
+ *
+ * DESCRIPTION: Table whose key and value bytes live in a shared arena
+ */
+FlatTable::FlatTable(Arena *arena): ctrl(NULL), slots(NULL), capacity(0), size(0), bytes(0), arena(arena), ownsArena(false) {}
+
+/**
+ * copy constructor
+ *
+ * DESCRIPTION: The copy always owns a fresh arena
+ */
+FlatTable::FlatTable(const FlatTable &another): ctrl(NULL), slots(NULL), capacity(0), size(0), bytes(0), arena(new Arena()), ownsArena(true) {
+	copyFrom(another);
+}
+
+/**
+ * Assignment operator overloading
+ */
+FlatTable& FlatTable::operator =(const FlatTable &another) {
+	if ( this != &another ) {
+		clear();
+		copyFrom(another);
+	}
+	return *this;
+}
+
+/**
+ * Destructor
+ */
+FlatTable::~FlatTable() {
+	clear();
+	if ( ownsArena ) {
+		delete arena;
+	}
+}
+
+/**
+ * FUNCTION NAME: hashBytes
+ *
+ * DESCRIPTION: 64 bit MurmurHash2 (MurmurHash64A) of a byte range. Hashes with different
+ * 				seeds are independent.
+ */
+size_t FlatTable::hashBytes(const char *data, size_t len, uint64_t seed) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	uint64_t h = seed ^ (len * m);
+	const char *end = data + (len & ~(size_t)7);
+
+	for ( const char *p = data; p != end; p += 8 ) {
+		uint64_t k;
+		memcpy(&k, p, sizeof(k));
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+	}
+
+	const unsigned char *tail = (const unsigned char *)end;
+	switch ( len & 7 ) {
+		case 7: h ^= uint64_t(tail[6]) << 48;
+		case 6: h ^= uint64_t(tail[5]) << 40;
+		case 5: h ^= uint64_t(tail[4]) << 32;
+		case 4: h ^= uint64_t(tail[3]) << 24;
+		case 3: h ^= uint64_t(tail[2]) << 16;
+		case 2: h ^= uint64_t(tail[1]) << 8;
+		case 1: h ^= uint64_t(tail[0]);
+			h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return (size_t)h;
+}
+
+/**
+ * FUNCTION NAME: slotKey
+ *
+ * DESCRIPTION: Returns the key bytes of an occupied slot
+ */
+const char *FlatTable::slotKey(const FlatSlot &slot) const {
+	return slot.keyLen <= FT_INLINE_KEY ? slot.inlineKey : slot.heapKey;
+}
+
+/**
+ * FUNCTION NAME: setCtrl
+ *
+ * DESCRIPTION: Sets a control byte and its mirror past the end of the array,
+ * 				so that a group load starting near the end wraps around
+ */
+void FlatTable::setCtrl(size_t index, signed char value) {
+	ctrl[index] = value;
+	if ( index < FT_GROUP_WIDTH - 1 ) {
+		ctrl[capacity + index] = value;
+	}
+}
+
+/**
+ * FUNCTION NAME: initSlots
+ *
+ * DESCRIPTION: Allocates empty control bytes and slots for newCapacity cells
+ */
+void FlatTable::initSlots(size_t newCapacity) {
+	capacity = newCapacity;
+	ctrl = (signed char *) malloc(capacity + FT_GROUP_WIDTH - 1);
+	memset(ctrl, FT_EMPTY, capacity + FT_GROUP_WIDTH - 1);
+	slots = (FlatSlot *) malloc(capacity * sizeof(FlatSlot));
+}
+
+/**
+ * FUNCTION NAME: releaseSlot
+ *
+ * DESCRIPTION: Gives the key and value blocks of an occupied slot back to the arena
+ */
+void FlatTable::releaseSlot(FlatSlot &slot) {
+	if ( slot.keyLen > FT_INLINE_KEY ) {
+		arena->release(slot.heapKey, slot.keyLen);
+	}
+	arena->release(slot.value, slot.valueLen);
+}
+
+/**
+ * FUNCTION NAME: rehash
+ *
+ * DESCRIPTION: Moves every slot into a table of newCapacity cells. Key and value
+ * 				buffers are handed over, not copied.
+ */
+void FlatTable::rehash(size_t newCapacity) {
+	signed char *oldCtrl = ctrl;
+	FlatSlot *oldSlots = slots;
+	size_t oldCapacity = capacity;
+
+	initSlots(newCapacity);
+	for ( size_t i = 0; i < oldCapacity; i++ ) {
+		if ( oldCtrl[i] != FT_EMPTY ) {
+			size_t index = findEmpty(oldSlots[i].hash);
+			slots[index] = oldSlots[i];
+			setCtrl(index, h2(oldSlots[i].hash));
+		}
+	}
+	free(oldCtrl);
+	free(oldSlots);
+}
+
+/**
+ * FUNCTION NAME: findIndex
+ *
+ * DESCRIPTION: Probes for key starting at its home slot
+ *
+ * RETURNS:
+ * slot index if found
+ * capacity otherwise
+ */
+size_t FlatTable::findIndex(const char *key, size_t keyLen, size_t hash) const {
+	if ( size == 0 ) {
+		return capacity;
+	}
+	size_t mask = capacity - 1;
+	size_t pos = h1(hash) & mask;
+	signed char tag = h2(hash);
+
+	for ( size_t probed = 0; probed < capacity; probed += FT_GROUP_WIDTH ) {
+		unsigned int empties = matchGroup(ctrl + pos, FT_EMPTY);
+		unsigned int hits = matchGroup(ctrl + pos, tag);
+		if ( empties ) {
+			// the run of a key never crosses an empty slot
+			hits &= (empties & (0u - empties)) - 1;
+		}
+		while ( hits ) {
+			size_t index = (pos + __builtin_ctz(hits)) & mask;
+			const FlatSlot &slot = slots[index];
+			if ( slot.hash == hash && slot.keyLen == keyLen && 0 == memcmp(slotKey(slot), key, keyLen) ) {
+				return index;
+			}
+			hits &= hits - 1;
+		}
+		if ( empties ) {
+			break;
+		}
+		pos = (pos + FT_GROUP_WIDTH) & mask;
+	}
+	return capacity;
+}
+
+/**
+ * FUNCTION NAME: findEmpty
+ *
+ * DESCRIPTION: Returns the first free slot at or after the home slot of hash.
+ * 				The load factor guarantees that one exists.
+ */
+size_t FlatTable::findEmpty(size_t hash) const {
+	size_t mask = capacity - 1;
+	size_t pos = h1(hash) & mask;
+	while ( true ) {
+		unsigned int empties = matchGroup(ctrl + pos, FT_EMPTY);
+		if ( empties ) {
+			return (pos + __builtin_ctz(empties)) & mask;
+		}
+		pos = (pos + FT_GROUP_WIDTH) & mask;
+	}
+}
+
+/**
+ * FUNCTION NAME: eraseIndex
+ *
+ * DESCRIPTION: Empties slot index and shifts the rest of its probe run back by one,
+ * 				so lookups never need a tombstone to keep probing
+ */
+void FlatTable::eraseIndex(size_t index) {
+	size_t mask = capacity - 1;
+	size_t next = (index + 1) & mask;
+	while ( ctrl[next] != FT_EMPTY ) {
+		size_t home = h1(slots[next].hash) & mask;
+		// move next into the hole if the hole lies on next's probe path
+		if ( ((next - home) & mask) >= ((next - index) & mask) ) {
+			slots[index] = slots[next];
+			setCtrl(index, ctrl[next]);
+			index = next;
+		}
+		next = (next + 1) & mask;
+	}
+	setCtrl(index, FT_EMPTY);
+}
+
+/**
+ * FUNCTION NAME: copyFrom
+ *
+ * DESCRIPTION: Deep copies another table into this (empty) table
+ */
+void FlatTable::copyFrom(const FlatTable &another) {
+	if ( another.capacity == 0 ) {
+		return;
+	}
+	initSlots(another.capacity);
+	memcpy(ctrl, another.ctrl, capacity + FT_GROUP_WIDTH - 1);
+	for ( size_t i = 0; i < capacity; i++ ) {
+		if ( ctrl[i] == FT_EMPTY ) {
+			continue;
+		}
+		FlatSlot &slot = slots[i];
+		slot = another.slots[i];
+		if ( slot.keyLen > FT_INLINE_KEY ) {
+			slot.heapKey = (char *) arena->allocate(slot.keyLen);
+			memcpy(slot.heapKey, another.slots[i].heapKey, slot.keyLen);
+		}
+		slot.value = (char *) arena->allocate(slot.valueLen);
+		memcpy(slot.value, another.slots[i].value, slot.valueLen);
+	}
+	size = another.size;
+	bytes = another.bytes;
+}
+
+/**
+ * FUNCTION NAME: emplace
+ *
+ * DESCRIPTION: Inserts key with an uninitialized value buffer of valueLen bytes
+ * 				unless the key is already present. The caller fills the buffer in place.
+ *
+ * RETURNS:
+ * value buffer if inserted
+ * NULL if the key already existed
+ */
+char *FlatTable::emplace(const char *key, size_t keyLen, size_t valueLen) {
+	size_t hash = hashBytes(key, keyLen);
+	if ( findIndex(key, keyLen, hash) != capacity ) {
+		return NULL;
+	}
+	if ( capacity == 0 ) {
+		initSlots(FT_MIN_CAPACITY);
+	}
+	else if ( (size + 1) * 8 > capacity * 7 ) {
+		rehash(capacity * 2);
+	}
+
+	size_t index = findEmpty(hash);
+	FlatSlot &slot = slots[index];
+	slot.hash = hash;
+	slot.keyLen = keyLen;
+	slot.referenced = 1;
+	if ( slot.keyLen <= FT_INLINE_KEY ) {
+		memcpy(slot.inlineKey, key, keyLen);
+	}
+	else {
+		slot.heapKey = (char *) arena->allocate(keyLen);
+		memcpy(slot.heapKey, key, keyLen);
+	}
+	slot.valueLen = valueLen;
+	slot.value = (char *) arena->allocate(valueLen);
+	setCtrl(index, h2(hash));
+	size++;
+	bytes += keyLen + valueLen;
+	return slot.value;
+}
+
+/**
+ * FUNCTION NAME: assign
+ *
+ * DESCRIPTION: Resizes the value buffer of an existing key to valueLen bytes.
+ * 				The caller overwrites the buffer in place.
+ *
+ * RETURNS:
+ * value buffer if the key was found
+ * NULL otherwise
+ */
+char *FlatTable::assign(const char *key, size_t keyLen, size_t valueLen) {
+	size_t index = findIndex(key, keyLen, hashBytes(key, keyLen));
+	if ( index == capacity ) {
+		return NULL;
+	}
+	FlatSlot &slot = slots[index];
+	slot.referenced = 1;
+	if ( slot.valueLen != valueLen ) {
+		// a block of the same size class comes straight back off the free list
+		arena->release(slot.value, slot.valueLen);
+		bytes = bytes - slot.valueLen + valueLen;
+		slot.valueLen = valueLen;
+		slot.value = (char *) arena->allocate(valueLen);
+	}
+	return slot.value;
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Looks up key without copying its value and sets its reference bit,
+ * 				so a lookup counts as an access for sweep
+ *
+ * RETURNS:
+ * pointer to the value bytes (valid until the next modification) if found
+ * NULL otherwise
+ */
+const char *FlatTable::lookup(const char *key, size_t keyLen, size_t &valueLen) {
+	size_t index = findIndex(key, keyLen, hashBytes(key, keyLen));
+	if ( index == capacity ) {
+		return NULL;
+	}
+	slots[index].referenced = 1;
+	valueLen = slots[index].valueLen;
+	return slots[index].value;
+}
+
+/**
+ * FUNCTION NAME: emplace
+ *
+ * DESCRIPTION: Inserts (key, value) unless the key is already present
+ *
+ * RETURNS:
+ * true if inserted
+ * false if the key already existed
+ */
+bool FlatTable::emplace(const string &key, const string &value) {
+	char *buffer = emplace(key.data(), key.size(), value.size());
+	if ( buffer == NULL ) {
+		return false;
+	}
+	memcpy(buffer, value.data(), value.size());
+	return true;
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Looks up key and copies its value out
+ *
+ * RETURNS:
+ * true if found
+ * false otherwise
+ */
+bool FlatTable::find(const string &key, string &value) {
+	size_t valueLen;
+	const char *data = lookup(key.data(), key.size(), valueLen);
+	if ( data == NULL ) {
+		return false;
+	}
+	value.assign(data, valueLen);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: assign
+ *
+ * DESCRIPTION: Replaces the value of an existing key
+ *
+ * RETURNS:
+ * true if the key was found
+ * false otherwise
+ */
+bool FlatTable::assign(const string &key, const string &value) {
+	char *buffer = assign(key.data(), key.size(), value.size());
+	if ( buffer == NULL ) {
+		return false;
+	}
+	memcpy(buffer, value.data(), value.size());
+	return true;
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * DESCRIPTION: Removes key from the table
+ *
+ * RETURNS:
+ * number of removed entries (0 or 1)
+ */
+size_t FlatTable::erase(const string &key) {
+	size_t index = findIndex(key.data(), key.size(), hashBytes(key.data(), key.size()));
+	if ( index == capacity ) {
+		return 0;
+	}
+	bytes -= slots[index].keyLen + slots[index].valueLen;
+	releaseSlot(slots[index]);
+	eraseIndex(index);
+	size--;
+	return 1;
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: Returns 1 if key is present, 0 otherwise
+ */
+size_t FlatTable::count(const string &key) const {
+	return findIndex(key.data(), key.size(), hashBytes(key.data(), key.size())) != capacity ? 1 : 0;
+}
+
+/**
+ * FUNCTION NAME: empty
+ *
+ * DESCRIPTION: Returns if the table holds no entries
+ */
+bool FlatTable::empty() const {
+	return size == 0;
+}
+
+/**
+ * FUNCTION NAME: getSize
+ *
+ * DESCRIPTION: Returns the number of entries
+ */
+size_t FlatTable::getSize() const {
+	return size;
+}
+
+/**
+ * FUNCTION NAME: getCapacity
+ *
+ * DESCRIPTION: Returns the number of slots
+ */
+size_t FlatTable::getCapacity() const {
+	return capacity;
+}
+
+/**
+ * FUNCTION NAME: getBytes
+ *
+ * DESCRIPTION: Returns the key and value bytes held by the table
+ */
+size_t FlatTable::getBytes() const {
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: getFootprint
+ *
+ * DESCRIPTION: Returns the bytes of the table itself: the object, its slots and control
+ * 				bytes, empty slots included. Key and value blocks are the arena's.
+ */
+size_t FlatTable::getFootprint() const {
+	if ( capacity == 0 ) {
+		return sizeof(FlatTable);
+	}
+	return sizeof(FlatTable) + capacity * sizeof(FlatSlot) + capacity + FT_GROUP_WIDTH - 1;
+}
+
+/**
+ * FUNCTION NAME: sweep
+ *
+ * DESCRIPTION: The CLOCK hand passes the occupied slot index: its reference bit is cleared
+ *
+ * RETURNS:
+ * true if the entry was accessed since the hand last passed it
+ * false if it is a candidate for eviction
+ */
+bool FlatTable::sweep(size_t index) {
+	bool referenced = slots[index].referenced;
+	slots[index].referenced = 0;
+	return referenced;
+}
+
+/**
+ * FUNCTION NAME: getArena
+ *
+ * DESCRIPTION: Returns the arena holding the key and value bytes
+ */
+Arena *FlatTable::getArena() const {
+	return arena;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Removes all entries and releases the slot arrays.
+ * 				An owned arena is reset in bulk instead of releasing slot by slot.
+ */
+void FlatTable::clear() {
+	if ( ownsArena ) {
+		arena->reset();
+	}
+	else {
+		for ( size_t i = 0; i < capacity; i++ ) {
+			if ( ctrl[i] != FT_EMPTY ) {
+				releaseSlot(slots[i]);
+			}
+		}
+	}
+	free(ctrl);
+	free(slots);
+	ctrl = NULL;
+	slots = NULL;
+	capacity = 0;
+	size = 0;
+	bytes = 0;
+}
+
+/**
+ * FUNCTION NAME: begin
+ *
+ * DESCRIPTION: Iterator to the first occupied slot
+ */
+FlatTable::iterator FlatTable::begin() const {
+	return iterator(this, 0);
+}
+
+/**
+ * FUNCTION NAME: end
+ *
+ * DESCRIPTION: Past the end iterator
+ */
+FlatTable::iterator FlatTable::end() const {
+	return iterator(this, capacity);
+}
+
+/**
+ * constructor
+ */
+FlatTable::iterator::iterator(const FlatTable *table, size_t index): table(table), index(index) {
+	skipEmpty();
+}
+
+/**
+ * FUNCTION NAME: skipEmpty
+ *
+ * DESCRIPTION: Advances to the next occupied slot
+ */
+void FlatTable::iterator::skipEmpty() {
+	while ( index < table->capacity && table->ctrl[index] == FT_EMPTY ) {
+		index++;
+	}
+}
+
+/**
+ * Increment operator overloading
+ */
+FlatTable::iterator& FlatTable::iterator::operator ++() {
+	index++;
+	skipEmpty();
+	return *this;
+}
+
+/**
+ * Compare two iterators
+ */
+bool FlatTable::iterator::operator !=(const iterator &another) const {
+	return index != another.index || table != another.table;
+}
+
+/**
+ * Compare two iterators
+ */
+bool FlatTable::iterator::operator ==(const iterator &another) const {
+	return !(*this != another);
+}
+
+/**
+ * FUNCTION NAME: getIndex
+ *
+ * DESCRIPTION: Slot of the current entry, to resume an iteration later
+ */
+size_t FlatTable::iterator::getIndex() const {
+	return index;
+}
+
+/**
+ * FUNCTION NAME: keyData
+ *
+ * DESCRIPTION: Key bytes of the current slot
+ */
+const char *FlatTable::iterator::keyData() const {
+	return table->slotKey(table->slots[index]);
+}
+
+/**
+ * FUNCTION NAME: keyLength
+ *
+ * DESCRIPTION: Key length of the current slot
+ */
+size_t FlatTable::iterator::keyLength() const {
+	return table->slots[index].keyLen;
+}
+
+/**
+ * FUNCTION NAME: valueData
+ *
+ * DESCRIPTION: Value bytes of the current slot
+ */
+const char *FlatTable::iterator::valueData() const {
+	return table->slots[index].value;
+}
+
+/**
+ * FUNCTION NAME: valueLength
+ *
+ * DESCRIPTION: Value length of the current slot
+ */
+size_t FlatTable::iterator::valueLength() const {
+	return table->slots[index].valueLen;
+}
+
+/**
+ * FUNCTION NAME: key
+ *
+ * DESCRIPTION: Copy of the key of the current slot
+ */
+string FlatTable::iterator::key() const {
+	return string(keyData(), keyLength());
+}
+
+/**
+ * FUNCTION NAME: value
+ *
+ * DESCRIPTION: Copy of the value of the current slot
+ */
+string FlatTable::iterator::value() const {
+	const FlatSlot &slot = table->slots[index];
+	return string(slot.value, slot.valueLen);
+}
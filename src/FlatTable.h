@@ -0,0 +1,139 @@
+/**********************************
+ * FILE NAME: FlatTable.h
+ *
+ * DESCRIPTION: Header file of FlatTable class
+ **********************************/
+
+#ifndef FLATTABLE_H_
+#define FLATTABLE_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include <stdint.h>
+#include "Arena.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ * Macros
+ */
+// control bytes scanned per probe step
+#define FT_GROUP_WIDTH 16
+// keys up to this many bytes live inside the slot itself
+#define FT_INLINE_KEY 16
+// smallest non-empty capacity (power of two)
+#define FT_MIN_CAPACITY 16
+// control byte of an unused slot; full slots hold a 7 bit hash fragment
+#define FT_EMPTY ((signed char)-128)
+// seed of the hash the table probes with
+#define FT_HASH_SEED 0x9747b28c
+
+/**
+ * STRUCT NAME: FlatSlot
+ *
+ * DESCRIPTION: One key/value cell of the table. Short keys are stored inline,
+ * 				longer keys and all values are blocks of the table's Arena.
+ */
+typedef struct FlatSlot {
+	size_t hash;
+	unsigned int keyLen : 31;
+	// CLOCK reference bit: set on every access, cleared by sweep
+	unsigned int referenced : 1;
+	unsigned int valueLen;
+	union {
+		char inlineKey[FT_INLINE_KEY];
+		char *heapKey;
+	};
+	char *value;
+} FlatSlot;
+
+/**
+ * CLASS NAME: FlatTable
+ *
+ * DESCRIPTION: Open addressing hash table with linear probing. A parallel array of
+ * 				control bytes is probed FT_GROUP_WIDTH slots at a time (SSE2 when available).
+ * 				Deletes use backward shifting, so the table never holds tombstones.
+ * 				Key and value bytes come from an Arena, either owned by the table
+ * 				(released in bulk by clear) or shared with other tables.
+ */
+class FlatTable {
+private:
+	signed char *ctrl;
+	FlatSlot *slots;
+	size_t capacity;
+	size_t size;
+	// key and value bytes of all entries
+	size_t bytes;
+	Arena *arena;
+	bool ownsArena;
+
+	static size_t h1(size_t hash) { return hash >> 7; }
+	static signed char h2(size_t hash) { return (signed char)(hash & 0x7F); }
+	const char *slotKey(const FlatSlot &slot) const;
+	void setCtrl(size_t index, signed char value);
+	void initSlots(size_t newCapacity);
+	void releaseSlot(FlatSlot &slot);
+	void rehash(size_t newCapacity);
+	size_t findIndex(const char *key, size_t keyLen, size_t hash) const;
+	size_t findEmpty(size_t hash) const;
+	void eraseIndex(size_t index);
+	void copyFrom(const FlatTable &another);
+
+public:
+	/**
+	 * CLASS NAME: iterator
+	 *
+	 * DESCRIPTION: Forward iterator over the occupied slots
+	 */
+	class iterator {
+	private:
+		const FlatTable *table;
+		size_t index;
+		void skipEmpty();
+	public:
+		iterator(const FlatTable *table, size_t index);
+		iterator& operator ++();
+		bool operator !=(const iterator &another) const;
+		bool operator ==(const iterator &another) const;
+		size_t getIndex() const;
+		const char *keyData() const;
+		size_t keyLength() const;
+		const char *valueData() const;
+		size_t valueLength() const;
+		string key() const;
+		string value() const;
+	};
+
+	FlatTable();
+	FlatTable(Arena *arena);
+	FlatTable(const FlatTable &another);
+	FlatTable& operator =(const FlatTable &another);
+	virtual ~FlatTable();
+
+	static size_t hashBytes(const char *data, size_t len, uint64_t seed = FT_HASH_SEED);
+
+	char *emplace(const char *key, size_t keyLen, size_t valueLen);
+	char *assign(const char *key, size_t keyLen, size_t valueLen);
+	const char *lookup(const char *key, size_t keyLen, size_t &valueLen);
+	bool emplace(const string &key, const string &value);
+	bool find(const string &key, string &value);
+	bool assign(const string &key, const string &value);
+	size_t erase(const string &key);
+	size_t count(const string &key) const;
+	bool empty() const;
+	size_t getSize() const;
+	size_t getCapacity() const;
+	size_t getBytes() const;
+	size_t getFootprint() const;
+	bool sweep(size_t index);
+	Arena *getArena() const;
+	void clear();
+	iterator begin() const;
+	iterator end() const;
+};
+
+#endif /* FLATTABLE_H_ */
@@ -6,9 +6,13 @@
 
 #include "HashTable.h"
 
-HashTable::HashTable() {}
+HashTable::HashTable(): logStore(NULL), snapshot(NULL), snapshotRemaining(0), rebuildCursor(0), purgeToken(0), purgeSlot(0),
+	memoryBudget(0), clockToken(0), clockSlot(0), evictions(0), evictedBytes(0), pressureEvents(0) {}
 
-HashTable::~HashTable() {}
+HashTable::~HashTable() {
+	delete logStore;
+	delete snapshot;
+}
 
 /**
  * FUNCTION NAME: create
@@ -19,8 +23,11 @@ HashTable::~HashTable() {}
  * true on SUCCESS
  * false in FAILURE
  */
-bool HashTable::create(string key, string value) {
-	hashTable.emplace(key, value);
+bool HashTable::create(const string &key, const string &value) {
+	promote(key);
+	if ( hashTable.emplace(key, value) && logStore != NULL ) {
+		logStore->put(key.data(), key.size(), value.data(), value.size());
+	}
 	return true;
 }
 
@@ -33,13 +40,18 @@ bool HashTable::create(string key, string value) {
  * string value if found
  * else it returns a NULL
  */
-string HashTable::read(string key) {
-	map<string, string>::iterator search;
+string HashTable::read(const string &key) {
+	string value;
 
-	search = hashTable.find(key);
-	if ( search != hashTable.end() ) {
+	if ( hashTable.find(key, value) ) {
 		// Value found
-		return search->second;
+		return value;
+	}
+	size_t size;
+	const char *data = snapshotLookup(key, size);
+	if ( data != NULL ) {
+		// Served straight from the mapped snapshot
+		return string(data, size);
 	}
 	else {
 		// Value not found
@@ -57,17 +69,15 @@ string HashTable::read(string key) {
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::update(string key, string newValue) {
-	map<string, string>::iterator update;
-
-	if (read(key).empty()) {
-		// Key not found
+bool HashTable::update(const string &key, const string &newValue) {
+	promote(key);
+	// Single probe: fails if the key is not found
+	if ( !hashTable.assign(key, newValue) ) {
 		return false;
 	}
-	// Key found
-	//update = hashTable.at(key) = newValue;
-	hashTable.at(key) = newValue;
-	// Update successful
+	if ( logStore != NULL ) {
+		logStore->put(key.data(), key.size(), newValue.data(), newValue.size());
+	}
 	return true;
 }
 
@@ -80,17 +90,15 @@ bool HashTable::update(string key, string newValue) {
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::deleteKey(string key) {
-	uint eraseCount = 0;
-
-	if (read(key).empty()) {
+bool HashTable::deleteKey(const string &key) {
+	promote(key);
+	// Single probe: erase reports whether the key was found
+	if ( hashTable.erase(key) < 1 ) {
 		// Key not found
 		return false;
 	}
-	eraseCount = hashTable.erase(key);
-	if ( eraseCount < 1 ) {
-		// Could not erase
-		return false;
+	if ( logStore != NULL ) {
+		logStore->del(key.data(), key.size());
 	}
 	// Delete was successful
 	return true;
@@ -106,7 +114,7 @@ bool HashTable::deleteKey(string key) {
  * false otherwise
  */
 bool HashTable::isEmpty() {
-	return hashTable.empty();
+	return hashTable.empty() && snapshotRemaining == 0;
 }
 
 /**
@@ -118,16 +126,18 @@ bool HashTable::isEmpty() {
  * size of the table as unit
  */
 unsigned long HashTable::currentSize() {
-	return (unsigned  long)hashTable.size();
+	return (unsigned  long)(hashTable.getSize() + snapshotRemaining);
 }
 
 /**
  * FUNCTION NAME: clear
  *
- * DESCRIPTION: Clear all contents from the hash table
+ * DESCRIPTION: Clear all contents from the hash table.
+ * 				Only the in-memory state is dropped, the durable log is kept for recovery.
  */
 void HashTable::clear() {
 	hashTable.clear();
+	detachSnapshot();
 }
 
 /**
@@ -138,7 +148,470 @@ void HashTable::clear() {
  * RETURNS:
  * unsigned long count (Should be always 1)
  */
-unsigned long HashTable::count(string key) {
-	return (unsigned long) hashTable.count(key);
+unsigned long HashTable::count(const string &key) {
+	size_t size;
+	if ( hashTable.count(key) > 0 || snapshotLookup(key, size) != NULL ) {
+		return 1;
+	}
+	return 0;
+}
+
+
+/**
+ * FUNCTION NAME: createRecord
+ *
+ * DESCRIPTION: This function inserts the key with the binary record of entry,
+ * 				written straight into the table's value buffer.
+ * 				An existing live record is left untouched. When either record is a
+ * 				tombstone the newer one wins, and the tombstone wins a tie, so a stale
+ * 				copy cannot undo a delete.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false in FAILURE
+ */
+bool HashTable::createRecord(const string &key, Entry &entry) {
+	if ( entry.expires != 0 && entry.expires <= expiry.getTime() ) {
+		// Already expired on arrival, e.g. a late re-replicated copy
+		return true;
+	}
+	promote(key);
+	char *buffer = hashTable.emplace(key.data(), key.size(), entry.recordSize());
+	if ( buffer == NULL ) {
+		size_t size;
+		Record existing(hashTable.lookup(key.data(), key.size(), size));
+		if ( (!existing.isTombstone() && !entry.isTombstone())
+				|| !Entry::supersedes(entry.timestamp, entry.isTombstone(), existing.getTimestamp(), existing.isTombstone()) ) {
+			return true;
+		}
+		buffer = hashTable.assign(key.data(), key.size(), entry.recordSize());
+	}
+	entry.writeRecord(buffer);
+	if ( logStore != NULL ) {
+		logStore->put(key.data(), key.size(), buffer, entry.recordSize());
+	}
+	if ( entry.expires != 0 ) {
+		expiry.schedule(key, entry.expires);
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: readRecord
+ *
+ * DESCRIPTION: This function looks up the record of the key without copying it
+ *
+ * RETURNS:
+ * true if found (record views the stored bytes)
+ * false otherwise
+ */
+bool HashTable::readRecord(const string &key, Record &record) {
+	size_t size;
+	const char *data = hashTable.lookup(key.data(), key.size(), size);
+	if ( data == NULL ) {
+		data = snapshotLookup(key, size);
+	}
+	if ( data == NULL ) {
+		return false;
+	}
+	record = Record(data);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: updateRecord
+ *
+ * DESCRIPTION: This function overwrites the record of the key if the key is found
+ * 				and not deleted. The new record keeps no expiry of the old one.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool HashTable::updateRecord(const string &key, Entry &entry) {
+	promote(key);
+	size_t size;
+	const char *data = hashTable.lookup(key.data(), key.size(), size);
+	if ( data == NULL || Record(data).isTombstone() ) {
+		// Key not found
+		return false;
+	}
+	char *buffer = hashTable.assign(key.data(), key.size(), entry.recordSize());
+	entry.writeRecord(buffer);
+	if ( logStore != NULL ) {
+		logStore->put(key.data(), key.size(), buffer, entry.recordSize());
+	}
+	if ( entry.expires != 0 ) {
+		expiry.schedule(key, entry.expires);
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: deleteRecord
+ *
+ * DESCRIPTION: This function replaces the record of the key by a tombstone stamped with
+ * 				timestamp. The tombstone is kept until purgeTombstones expires it.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the key is not found or already deleted
+ */
+bool HashTable::deleteRecord(const string &key, int timestamp) {
+	promote(key);
+	size_t size;
+	const char *data = hashTable.lookup(key.data(), key.size(), size);
+	if ( data == NULL ) {
+		return false;
+	}
+	Record record(data);
+	if ( record.isTombstone() ) {
+		return false;
+	}
+	Entry tombstone("", timestamp, record.getReplica(), RECORD_TOMBSTONE);
+	char *buffer = hashTable.assign(key.data(), key.size(), tombstone.recordSize());
+	tombstone.writeRecord(buffer);
+	if ( logStore != NULL ) {
+		logStore->put(key.data(), key.size(), buffer, tombstone.recordSize());
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: purgeTombstones
+ *
+ * DESCRIPTION: One bounded step of the background compaction. It looks at up to budget
+ * 				records, resuming where the previous step stopped, and erases the
+ * 				tombstones stamped before horizon.
+ *
+ * RETURNS:
+ * number of purged tombstones
+ */
+size_t HashTable::purgeTombstones(int horizon, size_t budget) {
+	vector<string> expired;
+	while ( budget > 0 ) {
+		FlatTable *range = hashTable.getRange(purgeToken);
+		if ( range == NULL || purgeSlot >= range->getCapacity() ) {
+			purgeToken = (purgeToken + 1) % RING_SIZE;
+			purgeSlot = 0;
+			budget--;
+			continue;
+		}
+		FlatTable::iterator it(range, purgeSlot);
+		for ( ; it != range->end() && budget > 0; ++it, budget-- ) {
+			Record record(it.valueData());
+			if ( record.isTombstone() && record.getTimestamp() < horizon ) {
+				expired.push_back(it.key());
+			}
+		}
+		purgeSlot = it == range->end() ? range->getCapacity() : it.getIndex();
+	}
+	// Erase after the scan: backward shifting would move records under the cursor
+	for ( size_t i = 0; i < expired.size(); i++ ) {
+		hashTable.erase(expired[i]);
+		if ( logStore != NULL ) {
+			logStore->del(expired[i].data(), expired[i].size());
+		}
+	}
+	return expired.size();
+}
+
+/**
+ * FUNCTION NAME: expireRecords
+ *
+ * DESCRIPTION: Advances the expiry wheel to globaltime now and erases the records whose
+ * 				time-to-live ran out. A timer whose record was since rewritten with
+ * 				another expiry, deleted or dropped is ignored.
+ *
+ * RETURNS:
+ * number of expired records
+ */
+size_t HashTable::expireRecords(int now) {
+	vector<WheelTimer> due;
+	expiry.advance(now, due);
+	size_t expired = 0;
+	for ( size_t i = 0; i < due.size(); i++ ) {
+		const string &key = due[i].key;
+		size_t size;
+		const char *data = hashTable.lookup(key.data(), key.size(), size);
+		if ( data == NULL || Record(data).getExpires() != due[i].expires ) {
+			continue;
+		}
+		hashTable.erase(key);
+		if ( logStore != NULL ) {
+			logStore->del(key.data(), key.size());
+		}
+		expired++;
+	}
+	return expired;
 }
 
+/**
+ * FUNCTION NAME: setMemoryBudget
+ *
+ * DESCRIPTION: Caps the bytes the table holds (see RangeTable::getMemoryUsage), 0 for no cap.
+ * 				Runs the table as a cache: evictToBudget drops keys once the cap is exceeded.
+ */
+void HashTable::setMemoryBudget(size_t budget) {
+	memoryBudget = budget;
+}
+
+/**
+ * FUNCTION NAME: evictToBudget
+ *
+ * DESCRIPTION: Evicts keys by CLOCK until the table fits its budget again. The hand moves
+ * 				over the token ranges and clears reference bits; keys not accessed since
+ * 				its previous pass are evicted. Tombstones are left to purgeTombstones,
+ * 				dropping one early could bring a deleted key back.
+ *
+ * RETURNS:
+ * number of evicted keys
+ */
+size_t HashTable::evictToBudget() {
+	if ( memoryBudget == 0 ) {
+		return 0;
+	}
+	size_t usage = hashTable.getMemoryUsage();
+	if ( usage <= memoryBudget ) {
+		return 0;
+	}
+	pressureEvents++;
+	size_t evicted = 0;
+	// two laps clear every reference bit, anything still over budget then is tombstones
+	size_t steps = 2 * (hashTable.getSize() + RING_SIZE);
+	while ( usage > memoryBudget && steps > 0 ) {
+		FlatTable *range = hashTable.getRange(clockToken);
+		if ( range == NULL || clockSlot >= range->getCapacity() ) {
+			clockToken = (clockToken + 1) % RING_SIZE;
+			clockSlot = 0;
+			steps--;
+			continue;
+		}
+		vector<string> victims;
+		FlatTable::iterator it(range, clockSlot);
+		for ( ; it != range->end() && usage > memoryBudget && steps > 0; ++it, steps-- ) {
+			if ( range->sweep(it.getIndex()) || Record(it.valueData()).isTombstone() ) {
+				continue;
+			}
+			victims.push_back(it.key());
+			size_t charge = RangeTable::entryBytes(it.keyLength(), it.valueLength());
+			usage -= charge;
+			evictedBytes += charge;
+		}
+		clockSlot = it == range->end() ? range->getCapacity() : it.getIndex();
+		// Erase after the scan: backward shifting would move entries under the hand
+		for ( size_t i = 0; i < victims.size(); i++ ) {
+			hashTable.erase(victims[i]);
+			if ( logStore != NULL ) {
+				logStore->del(victims[i].data(), victims[i].size());
+			}
+		}
+		evicted += victims.size();
+	}
+	evictions += evicted;
+	return evicted;
+}
+
+/**
+ * FUNCTION NAME: dropRange
+ *
+ * DESCRIPTION: Removes every key of a ring token range, e.g. once this node no longer replicates it
+ */
+void HashTable::dropRange(size_t token) {
+	FlatTable *range = hashTable.getRange(token);
+	if ( range == NULL ) {
+		return;
+	}
+	if ( logStore != NULL ) {
+		for ( FlatTable::iterator it = range->begin(); it != range->end(); ++it ) {
+			logStore->del(it.keyData(), it.keyLength());
+		}
+	}
+	hashTable.dropRange(token);
+}
+
+/**
+ * FUNCTION NAME: enableLog
+ *
+ * DESCRIPTION: Puts the table behind a LogStore in dir and recovers whatever it holds
+ *
+ * RETURNS:
+ * number of logged operations recovered from dir
+ */
+size_t HashTable::enableLog(string dir) {
+	if ( logStore != NULL ) {
+		return 0;
+	}
+	logStore = new LogStore(dir);
+	size_t recovered = logStore->recover(&hashTable);
+	for ( size_t token = 0; token < RING_SIZE; token++ ) {
+		FlatTable *range = hashTable.getRange(token);
+		if ( range == NULL ) {
+			continue;
+		}
+		for ( FlatTable::iterator it = range->begin(); it != range->end(); ++it ) {
+			scheduleExpiry(it.keyData(), it.keyLength(), it.valueData(), it.valueLength());
+		}
+	}
+	return recovered;
+}
+
+/**
+ * FUNCTION NAME: commitLog
+ *
+ * DESCRIPTION: Group commits the mutations since the last call and runs one
+ * 				bounded compaction step. Called once per tick.
+ */
+void HashTable::commitLog() {
+	if ( logStore == NULL ) {
+		return;
+	}
+	logStore->commit();
+	logStore->compactStep();
+}
+
+/**
+ * FUNCTION NAME: attachSnapshot
+ *
+ * DESCRIPTION: Serves a freshly mapped snapshot as the initial content of the table.
+ * 				Reads fall through to the mapping, writes first copy the key over
+ * 				(promote), and rebuildStep copies the rest a bounded amount per tick.
+ * 				The table takes ownership of the snapshot.
+ */
+void HashTable::attachSnapshot(Snapshot *snapshot) {
+	detachSnapshot();
+	this->snapshot = snapshot;
+	promoted.assign(snapshot->getIndexCapacity(), false);
+	snapshotRemaining = snapshot->getEntryCount();
+	rebuildCursor = 0;
+}
+
+/**
+ * FUNCTION NAME: rebuildStep
+ *
+ * DESCRIPTION: Copies up to budget snapshot entries into the table. The mapping is
+ * 				dropped once every entry has been copied.
+ *
+ * RETURNS:
+ * true if a snapshot is still attached
+ * false otherwise
+ */
+bool HashTable::rebuildStep(size_t budget) {
+	if ( snapshot == NULL ) {
+		return false;
+	}
+	size_t capacity = snapshot->getIndexCapacity();
+	while ( budget > 0 && rebuildCursor < capacity ) {
+		const char *key;
+		const char *value;
+		size_t keyLen, valueLen;
+		if ( !promoted[rebuildCursor] && snapshot->entryAt(rebuildCursor, key, keyLen, value, valueLen) ) {
+			char *buffer = hashTable.emplace(key, keyLen, valueLen);
+			if ( buffer != NULL ) {
+				memcpy(buffer, value, valueLen);
+				if ( logStore != NULL ) {
+					logStore->put(key, keyLen, value, valueLen);
+				}
+				scheduleExpiry(key, keyLen, value, valueLen);
+			}
+			promoted[rebuildCursor] = true;
+			snapshotRemaining--;
+			budget--;
+		}
+		rebuildCursor++;
+	}
+	if ( rebuildCursor == capacity ) {
+		detachSnapshot();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: finishRebuild
+ *
+ * DESCRIPTION: Copies whatever is left of the snapshot into the table at once
+ */
+void HashTable::finishRebuild() {
+	while ( rebuildStep(snapshotRemaining + 1) );
+}
+
+/**
+ * FUNCTION NAME: snapshotLookup
+ *
+ * DESCRIPTION: Finds a key that is still only held by the attached snapshot
+ *
+ * RETURNS:
+ * pointer to the mapped value, or NULL
+ */
+const char *HashTable::snapshotLookup(const string &key, size_t &valueLen) {
+	if ( snapshot == NULL ) {
+		return NULL;
+	}
+	size_t slot = snapshot->find(key.data(), key.size());
+	const char *keyData;
+	const char *value;
+	size_t keyLen;
+	if ( slot == snapshot->getIndexCapacity() || promoted[slot]
+			|| !snapshot->entryAt(slot, keyData, keyLen, value, valueLen) ) {
+		return NULL;
+	}
+	return value;
+}
+
+/**
+ * FUNCTION NAME: promote
+ *
+ * DESCRIPTION: Copies a key from the snapshot into the table ahead of a write to it,
+ * 				so the write applies to the snapshot's value
+ *
+ * RETURNS:
+ * true if the key was copied
+ * false otherwise
+ */
+bool HashTable::promote(const string &key) {
+	size_t valueLen;
+	const char *value = snapshotLookup(key, valueLen);
+	if ( value == NULL ) {
+		return false;
+	}
+	char *buffer = hashTable.emplace(key.data(), key.size(), valueLen);
+	if ( buffer != NULL ) {
+		memcpy(buffer, value, valueLen);
+		if ( logStore != NULL ) {
+			logStore->put(key.data(), key.size(), value, valueLen);
+		}
+		scheduleExpiry(key.data(), key.size(), value, valueLen);
+	}
+	promoted[snapshot->find(key.data(), key.size())] = true;
+	snapshotRemaining--;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: scheduleExpiry
+ *
+ * DESCRIPTION: Starts the expiry timer of a record restored from the log or a snapshot
+ */
+void HashTable::scheduleExpiry(const char *key, size_t keyLen, const char *data, size_t size) {
+	if ( size < sizeof(RecordHeader) ) {
+		return;
+	}
+	Record record(data);
+	if ( record.getExpires() != 0 ) {
+		expiry.schedule(string(key, keyLen), record.getExpires());
+	}
+}
+
+/**
+ * FUNCTION NAME: detachSnapshot
+ *
+ * DESCRIPTION: Unmaps the snapshot, whatever was not copied yet is dropped
+ */
+void HashTable::detachSnapshot() {
+	delete snapshot;
+	snapshot = NULL;
+	promoted.clear();
+	snapshotRemaining = 0;
+	rebuildCursor = 0;
+}
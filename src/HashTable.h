@@ -13,27 +13,78 @@
 #include "stdincludes.h"
 #include "common.h"
 #include "Entry.h"
+#include "RangeTable.h"
+#include "LogStore.h"
+#include "Snapshot.h"
+#include "TimerWheel.h"
 
 /**
  * CLASS NAME: HashTable
  *
- * DESCRIPTION: This class is a wrapper to the map provided by C++ STL.
+ * DESCRIPTION: This class is a wrapper to the token range partitioned RangeTable.
  *
  */
 class HashTable {
 public:
-	map<string, string> hashTable;
+	RangeTable hashTable;
+	// optional durable engine, NULL when running purely in memory
+	LogStore *logStore;
+	// mapped snapshot still being rebuilt into hashTable, NULL once done
+	Snapshot *snapshot;
+	// snapshot index slots already moved into hashTable (or superseded)
+	vector<bool> promoted;
+	size_t snapshotRemaining;
+	size_t rebuildCursor;
+	// position of the tombstone purge: token range and slot within it
+	size_t purgeToken;
+	size_t purgeSlot;
+	// expiry of the records stored with a time-to-live
+	TimerWheel expiry;
+	// bytes the table may hold before CLOCK eviction starts, 0 for no limit
+	size_t memoryBudget;
+	// position of the CLOCK hand: token range and slot within it
+	size_t clockToken;
+	size_t clockSlot;
+	// memory pressure counters
+	unsigned long evictions;
+	unsigned long evictedBytes;
+	unsigned long pressureEvents;
 //public:
 	HashTable();
-	bool create(string key, string value);
-	string read(string key);
-	bool update(string key, string newValue);
-	bool deleteKey(string key);
+	bool create(const string &key, const string &value);
+	string read(const string &key);
+	bool update(const string &key, const string &newValue);
+	bool deleteKey(const string &key);
 	bool isEmpty();
 	unsigned long currentSize();
 	void clear();
-	unsigned long count(string key);
+	unsigned long count(const string &key);
+	// typed records (RecordHeader followed by the value bytes)
+	bool createRecord(const string &key, Entry &entry);
+	bool readRecord(const string &key, Record &record);
+	bool updateRecord(const string &key, Entry &entry);
+	bool deleteRecord(const string &key, int timestamp);
+	size_t purgeTombstones(int horizon, size_t budget);
+	size_t expireRecords(int now);
+	// memory budget
+	void setMemoryBudget(size_t budget);
+	size_t evictToBudget();
+	// token ranges
+	void dropRange(size_t token);
+	// durability
+	size_t enableLog(string dir);
+	void commitLog();
+	// warm restart
+	void attachSnapshot(Snapshot *snapshot);
+	bool rebuildStep(size_t budget);
+	void finishRebuild();
 	virtual ~HashTable();
+
+private:
+	const char *snapshotLookup(const string &key, size_t &valueLen);
+	bool promote(const string &key);
+	void scheduleExpiry(const char *key, size_t keyLen, const char *data, size_t size);
+	void detachSnapshot();
 };
 
 #endif /* HASHTABLE_H_ */
@@ -73,7 +73,7 @@ void Log::LOG(Address *addr, const char * str, ...) {
 	sprintf(stdstring, "%d.%d.%d.%d:%d ", addr->addr[0], addr->addr[1], addr->addr[2], addr->addr[3], *(short *)&addr->addr[4]);
 
 	va_start(vararglist, str);
-	vsprintf(buffer, str, vararglist);
+	vsnprintf(buffer, sizeof(buffer), str, vararglist);
 	va_end(vararglist);
 
 	if (!firstTime) {
@@ -108,6 +108,15 @@ void Log::LOG(Address *addr, const char * str, ...) {
 
 }
 
+/**
+ * FUNCTION NAME: logLength
+ *
+ * DESCRIPTION: Number of characters of value that go into a log line
+ */
+int Log::logLength(const string &value) {
+	return (int)min(value.size(), (size_t)LOG_VALUE_MAX);
+}
+
 /**
  * FUNCTION NAME: logNodeAdd
  *
@@ -135,15 +144,15 @@ void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
  *
  * DESCRTION: Call this function after successfully create a key value pair
  */
-void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
+void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, const string &key, const string &value){
+	static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: create success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: create success at time %d, transID=%d, key=%s, value=%.*s", str.c_str(), par->getcurrtime(), transID, key.c_str(), logLength(value), value.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -151,15 +160,15 @@ void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function after successfully reading a key
  */
-void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-    static char stdstring[100];
+void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, const string &key, const string &value){
+    static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: read success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: read success at time %d, transID=%d, key=%s, value=%.*s", str.c_str(), par->getcurrtime(), transID, key.c_str(), logLength(value), value.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -167,15 +176,15 @@ void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, str
  *
  * DESCRIPTION: Call this function after successfully updating a key
  */
-void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
+void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, const string &key, const string &newValue){
+    static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: update success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: update success at time %d, transID=%d, key=%s, value=%.*s", str.c_str(), par->getcurrtime(), transID, key.c_str(), logLength(newValue), newValue.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -183,15 +192,15 @@ void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function after successfully deleting a key
  */
-void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, const string &key){
+    static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: delete success at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: delete success at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -199,15 +208,15 @@ void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function if CREATE failed
  */
-void Log::logCreateFail(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
+void Log::logCreateFail(Address * address, bool isCoordinator, int transID, const string &key, const string &value){
+	static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: create fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: create fail at time %d, transID=%d, key=%s, value=%.*s", str.c_str(), par->getcurrtime(), transID, key.c_str(), logLength(value), value.data());
+    LOG(address, "%s", stdstring);
 }
 
 
@@ -216,15 +225,15 @@ void Log::logCreateFail(Address * address, bool isCoordinator, int transID, stri
  *
  * DESCRIPTION: Call this function if READ failed
  */
-void Log::logReadFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+void Log::logReadFail(Address * address, bool isCoordinator, int transID, const string &key){
+    static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: read fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: read fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -232,15 +241,15 @@ void Log::logReadFail(Address * address, bool isCoordinator, int transID, string
  *
  * DESCRIPTION: Call this function if UPDATE failed
  */
-void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
+void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, const string &key, const string &newValue){
+    static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: update fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: update fail at time %d, transID=%d, key=%s, value=%.*s", str.c_str(), par->getcurrtime(), transID, key.c_str(), logLength(newValue), newValue.data());
+    LOG(address, "%s", stdstring);
 }
 
 /**
@@ -248,13 +257,13 @@ void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, stri
  *
  * DESCRIPTION: Call this function if DELETE failed
  */
-void Log::logDeleteFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+void Log::logDeleteFail(Address * address, bool isCoordinator, int transID, const string &key){
+    static char stdstring[LOG_LINE_MAX];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: delete fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+	snprintf(stdstring, sizeof(stdstring), "%s: delete fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
+    LOG(address, "%s", stdstring);
 }
@@ -19,6 +19,9 @@
 #define MAGIC_NUMBER "CS425"
 #define DBG_LOG "dbg.log"
 #define STATS_LOG "stats.log"
+// longest value written out in full, longer (streamed) values are truncated
+#define LOG_VALUE_MAX 512
+#define LOG_LINE_MAX (LOG_VALUE_MAX + 256)
 
 /**
  * CLASS NAME: Log
@@ -29,6 +32,7 @@ class Log{
 private:
 	Params *par;
 	bool firstTime;
+	static int logLength(const string &value);
 public:
 	Log(Params *p);
 	Log(const Log &anotherLog);
@@ -38,15 +42,15 @@ public:
 	void logNodeAdd(Address *, Address *);
 	void logNodeRemove(Address *, Address *);
 	// success
-	void logCreateSuccess(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logReadSuccess(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logUpdateSuccess(Address * address, bool isCoordinator, int transID, string key, string newValue);
-	void logDeleteSuccess(Address * address, bool isCoordinator, int transID, string key);
+	void logCreateSuccess(Address * address, bool isCoordinator, int transID, const string &key, const string &value);
+	void logReadSuccess(Address * address, bool isCoordinator, int transID, const string &key, const string &value);
+	void logUpdateSuccess(Address * address, bool isCoordinator, int transID, const string &key, const string &newValue);
+	void logDeleteSuccess(Address * address, bool isCoordinator, int transID, const string &key);
 	// fail
-	void logCreateFail(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logReadFail(Address * address, bool isCoordinator, int transID, string key);
-	void logUpdateFail(Address * address, bool isCoordinator, int transID, string key, string newValue);
-	void logDeleteFail(Address * address, bool isCoordinator, int transID, string key);
+	void logCreateFail(Address * address, bool isCoordinator, int transID, const string &key, const string &value);
+	void logReadFail(Address * address, bool isCoordinator, int transID, const string &key);
+	void logUpdateFail(Address * address, bool isCoordinator, int transID, const string &key, const string &newValue);
+	void logDeleteFail(Address * address, bool isCoordinator, int transID, const string &key);
 };
 
 #endif /* _LOG_H_ */
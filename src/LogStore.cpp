@@ -0,0 +1,746 @@
+/**********************************
+ * FILE NAME: LogStore.cpp
+ *
+ * DESCRIPTION: LogStore class definition
+ **********************************/
+
+#include "LogStore.h"
+#include <sys/stat.h>
+#include <errno.h>
+
+#define WAL_FILE "wal.log"
+#define MANIFEST_FILE "MANIFEST"
+// checksum, op, key length, value length
+#define WAL_HEADER_SIZE (sizeof(uint32_t) + 1 + 2 * sizeof(uint32_t))
+
+/**
+ * constructor
+ */
+RunReader::RunReader(string path): remaining(0), count(0), sum(LOG_CHECKSUM_SEED), valid(false), corrupt(false), op(LOG_END) {
+	fp = fopen(path.c_str(), "rb");
+	if ( fp != NULL && fseek(fp, 0, SEEK_END) == 0 ) {
+		remaining = ftell(fp);
+		rewind(fp);
+	}
+}
+
+/**
+ * Destructor
+ */
+RunReader::~RunReader() {
+	if ( fp != NULL ) {
+		fclose(fp);
+	}
+}
+
+/**
+ * FUNCTION NAME: read
+ *
+ * DESCRIPTION: Reads len bytes of the run into data and adds them to the checksum
+ *
+ * RETURNS:
+ * false if the run has fewer bytes left or they cannot be read
+ */
+bool RunReader::read(void *data, size_t len) {
+	if ( len > (size_t)remaining || (len > 0 && fread(data, len, 1, fp) != 1) ) {
+		return false;
+	}
+	remaining -= len;
+	sum = LogStore::checksum((const char *)data, len, sum);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: readFooter
+ *
+ * DESCRIPTION: Reads the rest of the footer once its LOG_END was read
+ *
+ * RETURNS:
+ * true if the footer matches the entries read and ends the file
+ */
+bool RunReader::readFooter() {
+	uint64_t entries;
+	uint32_t stored, magic;
+	if ( !read(&entries, sizeof(entries)) ) {
+		return false;
+	}
+	uint32_t covered = sum;
+	if ( !read(&stored, sizeof(stored)) || !read(&magic, sizeof(magic)) ) {
+		return false;
+	}
+	return entries == count && stored == covered && magic == LOG_RUN_MAGIC && remaining == 0;
+}
+
+/**
+ * FUNCTION NAME: next
+ *
+ * DESCRIPTION: Reads the next entry of the run. Nothing is allocated for a length
+ * 				before it is known to fit in the rest of the file.
+ *
+ * RETURNS:
+ * true if an entry was read
+ * false at the end of the run, with corrupt set if the run is damaged
+ */
+bool RunReader::next() {
+	uint32_t keyLen, valueLen;
+	valid = false;
+	if ( fp == NULL || corrupt ) {
+		return false;
+	}
+	if ( !read(&op, 1) ) {
+		corrupt = true;
+		return false;
+	}
+	if ( op == LOG_END ) {
+		corrupt = !readFooter();
+		return false;
+	}
+	if ( (op != LOG_PUT && op != LOG_DEL) || !read(&keyLen, sizeof(keyLen)) || !read(&valueLen, sizeof(valueLen))
+			|| keyLen > (size_t)remaining || valueLen > (size_t)remaining - keyLen ) {
+		corrupt = true;
+		return false;
+	}
+	key.resize(keyLen);
+	value.resize(valueLen);
+	if ( !read(&key[0], keyLen) || !read(&value[0], valueLen) ) {
+		corrupt = true;
+		return false;
+	}
+	count++;
+	valid = true;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: makeDirectories
+ *
+ * DESCRIPTION: Creates directory path and its missing parents, like mkdir -p
+ *
+ * RETURNS:
+ * true if path is a directory afterwards
+ */
+static bool makeDirectories(const string &path) {
+	for ( size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1) ) {
+		string prefix = path.substr(0, slash);
+		if ( mkdir(prefix.c_str(), 0755) < 0 && errno != EEXIST ) {
+			return false;
+		}
+		if ( slash == string::npos ) {
+			break;
+		}
+	}
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/**
+ * FUNCTION NAME: writeAll
+ *
+ * DESCRIPTION: Writes len bytes of data to fd, retrying short writes
+ *
+ * RETURNS:
+ * true if every byte was written
+ */
+static bool writeAll(int fd, const char *data, size_t len) {
+	size_t written = 0;
+	while ( written < len ) {
+		ssize_t n = write(fd, data + written, len - written);
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			return false;
+		}
+		written += n;
+	}
+	return true;
+}
+
+/**
+ * constructor
+ *
+ * DESCRIPTION: Opens the store in directory dir, creating it if needed. A store left in
+ * 				dir by an earlier run is opened as it is and recover() loads its contents.
+ * 				A store that cannot be opened ends the program.
+ */
+LogStore::LogStore(string dir): dir(dir), walSize(0), memtableBytes(0), nextRunId(1), compactOut(NULL), compactCount(0), compactSum(LOG_CHECKSUM_SEED), damaged(false) {
+	if ( !makeDirectories(dir) ) {
+		fprintf(stderr, "Cannot create store directory %s: %s\n", dir.c_str(), strerror(errno));
+		exit(1);
+	}
+	readManifest();
+	walFd = open(runPath(WAL_FILE).c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+	if ( walFd < 0 ) {
+		fprintf(stderr, "Cannot open %s: %s\n", runPath(WAL_FILE).c_str(), strerror(errno));
+		exit(1);
+	}
+}
+
+/**
+ * Destructor
+ */
+LogStore::~LogStore() {
+	commit();
+	// abandon the unfinished compaction, its inputs are still live
+	abandonCompaction();
+	if ( walFd >= 0 ) {
+		close(walFd);
+	}
+}
+
+/**
+ * FUNCTION NAME: checksum
+ *
+ * DESCRIPTION: 32 bit FNV-1a of a byte range, continuing the checksum sum of the bytes before it
+ */
+uint32_t LogStore::checksum(const char *data, size_t len, uint32_t sum) {
+	uint32_t h = sum;
+	for ( size_t i = 0; i < len; i++ ) {
+		h ^= (unsigned char)data[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+/**
+ * FUNCTION NAME: failure
+ *
+ * DESCRIPTION: Reports a failed store operation on path with the current errno
+ */
+void LogStore::failure(const char *operation, const string &path) {
+	fprintf(stderr, "LogStore: %s %s failed: %s\n", operation, path.c_str(), strerror(errno));
+}
+
+/**
+ * FUNCTION NAME: corruption
+ *
+ * DESCRIPTION: Reports the corrupt run at path and stops compacting, so the run and
+ * 				whatever can still be read from it are kept
+ */
+void LogStore::corruption(const string &path) {
+	fprintf(stderr, "LogStore: run %s is corrupt, compaction stopped\n", path.c_str());
+	damaged = true;
+}
+
+/**
+ * FUNCTION NAME: writeRun
+ *
+ * DESCRIPTION: Appends len bytes to a run file and adds them to its checksum sum
+ */
+static void writeRun(FILE *fp, const void *data, size_t len, uint32_t &sum) {
+	fwrite(data, 1, len, fp);
+	sum = LogStore::checksum((const char *)data, len, sum);
+}
+
+/**
+ * FUNCTION NAME: writeRunEntry
+ *
+ * DESCRIPTION: Appends one entry to a run file whose bytes so far have the checksum sum.
+ * 				Write errors stay pending in fp and are reported by writeRunFooter.
+ */
+void LogStore::writeRunEntry(FILE *fp, char op, const string &key, const string &value, uint32_t &sum) {
+	uint32_t keyLen = key.size();
+	uint32_t valueLen = value.size();
+	writeRun(fp, &op, 1, sum);
+	writeRun(fp, &keyLen, sizeof(keyLen), sum);
+	writeRun(fp, &valueLen, sizeof(valueLen), sum);
+	writeRun(fp, key.data(), keyLen, sum);
+	writeRun(fp, value.data(), valueLen, sum);
+}
+
+/**
+ * FUNCTION NAME: writeRunFooter
+ *
+ * DESCRIPTION: Ends a run file of count entries, whose bytes so far have the checksum sum,
+ * 				and forces it to disk. The footer holds the count and the checksum of every
+ * 				byte before the checksum itself.
+ *
+ * RETURNS:
+ * true if the whole file reached the disk
+ */
+bool LogStore::writeRunFooter(FILE *fp, unsigned long count, uint32_t sum) {
+	char op = LOG_END;
+	uint64_t entries = count;
+	uint32_t magic = LOG_RUN_MAGIC;
+	writeRun(fp, &op, 1, sum);
+	writeRun(fp, &entries, sizeof(entries), sum);
+	fwrite(&sum, sizeof(sum), 1, fp);
+	fwrite(&magic, sizeof(magic), 1, fp);
+	return fflush(fp) == 0 && !ferror(fp) && fsync(fileno(fp)) == 0;
+}
+
+/**
+ * FUNCTION NAME: closeRun
+ *
+ * DESCRIPTION: Ends the run file fp of count entries, whose bytes so far have the checksum
+ * 				sum, written at tmp and renames it to its final path. The file is removed
+ * 				if any of it failed.
+ *
+ * RETURNS:
+ * true if the run is complete at path
+ */
+bool LogStore::closeRun(FILE *fp, unsigned long count, uint32_t sum, const string &tmp, const string &path) {
+	bool synced = writeRunFooter(fp, count, sum);
+	if ( !synced ) {
+		failure("writing", tmp);
+	}
+	if ( fclose(fp) != 0 && synced ) {
+		failure("closing", tmp);
+		synced = false;
+	}
+	if ( synced && rename(tmp.c_str(), path.c_str()) < 0 ) {
+		failure("renaming", tmp);
+		synced = false;
+	}
+	if ( !synced ) {
+		unlink(tmp.c_str());
+	}
+	return synced;
+}
+
+/**
+ * FUNCTION NAME: runPath
+ *
+ * DESCRIPTION: Path of a file inside the store directory
+ */
+string LogStore::runPath(string name) {
+	return dir + "/" + name;
+}
+
+/**
+ * FUNCTION NAME: newRunName
+ *
+ * DESCRIPTION: File name for the next sorted run
+ */
+string LogStore::newRunName() {
+	char name[32];
+	sprintf(name, "run-%06d.dat", nextRunId++);
+	return name;
+}
+
+/**
+ * FUNCTION NAME: writeManifest
+ *
+ * DESCRIPTION: Atomically replaces the MANIFEST with the list of runs
+ *
+ * RETURNS:
+ * true if the new MANIFEST is in place, false if the old one still is
+ */
+bool LogStore::writeManifest(const vector<string> &list) {
+	string tmp = runPath(MANIFEST_FILE ".tmp");
+	FILE *fp = fopen(tmp.c_str(), "w");
+	if ( fp == NULL ) {
+		failure("creating", tmp);
+		return false;
+	}
+	for ( size_t i = 0; i < list.size(); i++ ) {
+		fprintf(fp, "%s\n", list[i].c_str());
+	}
+	bool synced = fflush(fp) == 0 && !ferror(fp) && fsync(fileno(fp)) == 0;
+	if ( fclose(fp) != 0 ) {
+		synced = false;
+	}
+	if ( !synced || rename(tmp.c_str(), runPath(MANIFEST_FILE).c_str()) < 0 ) {
+		failure("writing", tmp);
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: readManifest
+ *
+ * DESCRIPTION: Loads the list of live runs
+ */
+void LogStore::readManifest() {
+	char name[64];
+	int id;
+	FILE *fp = fopen(runPath(MANIFEST_FILE).c_str(), "r");
+	if ( fp == NULL ) {
+		return;
+	}
+	while ( fscanf(fp, "%63s", name) == 1 ) {
+		runs.push_back(name);
+		if ( sscanf(name, "run-%d.dat", &id) == 1 && id >= nextRunId ) {
+			nextRunId = id + 1;
+		}
+	}
+	fclose(fp);
+}
+
+/**
+ * FUNCTION NAME: recover
+ *
+ * DESCRIPTION: Rebuilds table from the sorted runs (oldest first) and then replays the write ahead log
+ *
+ * RETURNS:
+ * number of operations applied
+ */
+size_t LogStore::recover(RangeTable *table) {
+	size_t applied = 0;
+	for ( size_t i = 0; i < runs.size(); i++ ) {
+		RunReader reader(runPath(runs[i]));
+		if ( reader.fp == NULL ) {
+			failure("opening", runPath(runs[i]));
+			continue;
+		}
+		while ( reader.next() ) {
+			applied++;
+			if ( reader.op == LOG_PUT ) {
+				char *buffer = table->assign(reader.key.data(), reader.key.size(), reader.value.size());
+				if ( buffer == NULL ) {
+					buffer = table->emplace(reader.key.data(), reader.key.size(), reader.value.size());
+				}
+				memcpy(buffer, reader.value.data(), reader.value.size());
+			}
+			else {
+				table->erase(reader.key);
+			}
+		}
+		if ( reader.corrupt ) {
+			corruption(runPath(runs[i]));
+		}
+	}
+	return applied + replayWal(table);
+}
+
+/**
+ * FUNCTION NAME: replayWal
+ *
+ * DESCRIPTION: Applies the valid prefix of the write ahead log to table and to the memtable.
+ * 				A torn or corrupt tail left by a crash is cut off.
+ *
+ * RETURNS:
+ * number of records applied
+ */
+size_t LogStore::replayWal(RangeTable *table) {
+	string wal;
+	char chunk[65536];
+	ssize_t n;
+	size_t pos = 0;
+	size_t applied = 0;
+
+	lseek(walFd, 0, SEEK_SET);
+	while ( (n = read(walFd, chunk, sizeof(chunk))) > 0 ) {
+		wal.append(chunk, n);
+	}
+
+	while ( pos + WAL_HEADER_SIZE <= wal.size() ) {
+		uint32_t sum, keyLen, valueLen;
+		char op = wal[pos + sizeof(uint32_t)];
+		memcpy(&sum, &wal[pos], sizeof(sum));
+		memcpy(&keyLen, &wal[pos + sizeof(uint32_t) + 1], sizeof(keyLen));
+		memcpy(&valueLen, &wal[pos + 2 * sizeof(uint32_t) + 1], sizeof(valueLen));
+		size_t end = pos + WAL_HEADER_SIZE + keyLen + valueLen;
+		if ( end > wal.size() || sum != checksum(&wal[pos + sizeof(uint32_t)], end - pos - sizeof(uint32_t)) ) {
+			break;
+		}
+
+		const char *key = &wal[pos + WAL_HEADER_SIZE];
+		const char *value = key + keyLen;
+		if ( op == LOG_PUT ) {
+			char *buffer = table->assign(key, keyLen, valueLen);
+			if ( buffer == NULL ) {
+				buffer = table->emplace(key, keyLen, valueLen);
+			}
+			memcpy(buffer, value, valueLen);
+		}
+		else {
+			table->erase(string(key, keyLen));
+		}
+		remember(op, key, keyLen, value, valueLen);
+		pos = end;
+		applied++;
+	}
+
+	walSize = wal.size();
+	if ( pos < wal.size() ) {
+		if ( ftruncate(walFd, pos) < 0 ) {
+			failure("truncating", runPath(WAL_FILE));
+		}
+		else {
+			walSize = pos;
+		}
+	}
+	return applied;
+}
+
+/**
+ * FUNCTION NAME: remember
+ *
+ * DESCRIPTION: Makes op the latest operation on key in the memtable. The key is charged
+ * 				to memtableBytes once, its value every time it changes.
+ */
+void LogStore::remember(char op, const char *key, size_t keyLen, const char *value, size_t valueLen) {
+	pair<map<string, LogEntry>::iterator, bool> inserted = memtable.insert(make_pair(string(key, keyLen), LogEntry()));
+	LogEntry &entry = inserted.first->second;
+	if ( inserted.second ) {
+		memtableBytes += keyLen;
+	}
+	memtableBytes = memtableBytes - entry.value.size() + valueLen;
+	entry.op = op;
+	entry.value.assign(value, valueLen);
+}
+
+/**
+ * FUNCTION NAME: append
+ *
+ * DESCRIPTION: Adds one record to the pending commit group and to the memtable
+ */
+void LogStore::append(char op, const char *key, size_t keyLen, const char *value, size_t valueLen) {
+	size_t start = walBuffer.size();
+	uint32_t keyLen32 = keyLen;
+	uint32_t valueLen32 = valueLen;
+
+	walBuffer.append(sizeof(uint32_t), '\0');
+	walBuffer.push_back(op);
+	walBuffer.append((const char *)&keyLen32, sizeof(keyLen32));
+	walBuffer.append((const char *)&valueLen32, sizeof(valueLen32));
+	walBuffer.append(key, keyLen);
+	walBuffer.append(value, valueLen);
+	uint32_t sum = checksum(&walBuffer[start + sizeof(uint32_t)], walBuffer.size() - start - sizeof(uint32_t));
+	memcpy(&walBuffer[start], &sum, sizeof(sum));
+	remember(op, key, keyLen, value, valueLen);
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Logs the new value of a key
+ */
+void LogStore::put(const char *key, size_t keyLen, const char *value, size_t valueLen) {
+	append(LOG_PUT, key, keyLen, value, valueLen);
+}
+
+/**
+ * FUNCTION NAME: del
+ *
+ * DESCRIPTION: Logs the removal of a key
+ */
+void LogStore::del(const char *key, size_t keyLen) {
+	append(LOG_DEL, key, keyLen, NULL, 0);
+}
+
+/**
+ * FUNCTION NAME: commit
+ *
+ * DESCRIPTION: Group commit. Writes every record appended since the last commit with a single
+ * 				write and sync, then flushes the memtable if it has grown past its limit.
+ * 				A group that fails is cut off the log again and kept for the next commit.
+ *
+ * RETURNS:
+ * true if every record appended so far is on disk
+ */
+bool LogStore::commit() {
+	if ( !walBuffer.empty() ) {
+		if ( !writeAll(walFd, walBuffer.data(), walBuffer.size()) || fdatasync(walFd) < 0 ) {
+			failure("committing to", runPath(WAL_FILE));
+			// a torn group would end the replay before the groups committed after it
+			if ( ftruncate(walFd, walSize) < 0 ) {
+				failure("truncating", runPath(WAL_FILE));
+			}
+			return false;
+		}
+		walSize += walBuffer.size();
+		walBuffer.clear();
+	}
+	if ( memtableBytes >= LOG_MEMTABLE_LIMIT ) {
+		flushMemtable();
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: flushMemtable
+ *
+ * DESCRIPTION: Writes the memtable out as a new sorted run. Once the run is listed in the
+ * 				MANIFEST the write ahead log it came from is no longer needed. If any step
+ * 				fails the log and the memtable are kept, and the next commit tries again.
+ *
+ * RETURNS:
+ * true if the memtable is in a run
+ */
+bool LogStore::flushMemtable() {
+	string name = newRunName();
+	string tmp = runPath(name + ".tmp");
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if ( fp == NULL ) {
+		failure("creating", tmp);
+		return false;
+	}
+	uint32_t sum = LOG_CHECKSUM_SEED;
+	for ( map<string, LogEntry>::iterator it = memtable.begin(); it != memtable.end(); ++it ) {
+		writeRunEntry(fp, it->second.op, it->first, it->second.value, sum);
+	}
+	if ( !closeRun(fp, memtable.size(), sum, tmp, runPath(name)) ) {
+		return false;
+	}
+
+	vector<string> list = runs;
+	list.push_back(name);
+	if ( !writeManifest(list) ) {
+		unlink(runPath(name).c_str());
+		return false;
+	}
+	runs = list;
+	memtable.clear();
+	memtableBytes = 0;
+	// replaying a log the run already holds is harmless, only its space is lost
+	if ( ftruncate(walFd, 0) < 0 ) {
+		failure("truncating", runPath(WAL_FILE));
+	}
+	else {
+		walSize = 0;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: startCompaction
+ *
+ * DESCRIPTION: Starts merging all current runs into one
+ *
+ * RETURNS:
+ * true if the compaction started, false if a run or the output could not be opened
+ */
+bool LogStore::startCompaction() {
+	compactInputNames = runs;
+	for ( size_t i = 0; i < runs.size(); i++ ) {
+		RunReader *reader = new RunReader(runPath(runs[i]));
+		compactInputs.push_back(reader);
+		if ( reader->fp == NULL ) {
+			// merging without it would lose its keys
+			failure("opening", runPath(runs[i]));
+			abandonCompaction();
+			return false;
+		}
+		reader->next();
+		if ( reader->corrupt ) {
+			corruption(runPath(runs[i]));
+			abandonCompaction();
+			return false;
+		}
+	}
+	compactOutName = newRunName();
+	compactOut = fopen(runPath(compactOutName + ".tmp").c_str(), "wb");
+	if ( compactOut == NULL ) {
+		failure("creating", runPath(compactOutName + ".tmp"));
+		abandonCompaction();
+		return false;
+	}
+	compactCount = 0;
+	compactSum = LOG_CHECKSUM_SEED;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: abandonCompaction
+ *
+ * DESCRIPTION: Drops the running compaction; its inputs stay the live runs
+ */
+void LogStore::abandonCompaction() {
+	if ( compactOut != NULL ) {
+		fclose(compactOut);
+		compactOut = NULL;
+		unlink(runPath(compactOutName + ".tmp").c_str());
+	}
+	for ( size_t i = 0; i < compactInputs.size(); i++ ) {
+		delete compactInputs[i];
+	}
+	compactInputs.clear();
+	compactInputNames.clear();
+}
+
+/**
+ * FUNCTION NAME: compactStep
+ *
+ * DESCRIPTION: Runs one bounded step of the background compaction, starting one if
+ * 				there are LOG_COMPACT_TRIGGER runs or more. For equal keys the newest run wins.
+ * 				Deletes are dropped, since the merge always includes the oldest run. An
+ * 				input found corrupt abandons the compaction and keeps all of its inputs.
+ *
+ * RETURNS:
+ * true if a compaction is still in progress
+ */
+bool LogStore::compactStep() {
+	if ( compactOut == NULL ) {
+		if ( damaged || runs.size() < LOG_COMPACT_TRIGGER || !startCompaction() ) {
+			return false;
+		}
+	}
+
+	for ( int budget = 0; budget < LOG_COMPACT_BUDGET; budget++ ) {
+		int winner = -1;
+		for ( size_t i = 0; i < compactInputs.size(); i++ ) {
+			if ( compactInputs[i]->valid && (winner < 0 || compactInputs[i]->key <= compactInputs[winner]->key) ) {
+				winner = i;
+			}
+		}
+		if ( winner < 0 ) {
+			finishCompaction();
+			return false;
+		}
+
+		RunReader *newest = compactInputs[winner];
+		if ( newest->op == LOG_PUT ) {
+			writeRunEntry(compactOut, LOG_PUT, newest->key, newest->value, compactSum);
+			compactCount++;
+		}
+		string key = newest->key;
+		for ( size_t i = 0; i < compactInputs.size(); i++ ) {
+			if ( compactInputs[i]->valid && compactInputs[i]->key == key ) {
+				compactInputs[i]->next();
+			}
+			if ( compactInputs[i]->corrupt ) {
+				corruption(runPath(compactInputNames[i]));
+				abandonCompaction();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: finishCompaction
+ *
+ * DESCRIPTION: Installs the merged run in place of its inputs. The inputs are only removed
+ * 				once the MANIFEST lists the merged run instead of them.
+ */
+void LogStore::finishCompaction() {
+	FILE *fp = compactOut;
+	compactOut = NULL;
+	string merged = runPath(compactOutName);
+	if ( !closeRun(fp, compactCount, compactSum, merged + ".tmp", merged) ) {
+		abandonCompaction();
+		return;
+	}
+
+	// runs flushed while the compaction was running are newer than the merged run
+	vector<string> newRuns;
+	newRuns.push_back(compactOutName);
+	for ( size_t i = compactInputNames.size(); i < runs.size(); i++ ) {
+		newRuns.push_back(runs[i]);
+	}
+	if ( !writeManifest(newRuns) ) {
+		unlink(merged.c_str());
+		abandonCompaction();
+		return;
+	}
+	runs = newRuns;
+
+	for ( size_t i = 0; i < compactInputNames.size(); i++ ) {
+		unlink(runPath(compactInputNames[i]).c_str());
+	}
+	abandonCompaction();
+}
+
+/**
+ * FUNCTION NAME: getRunCount
+ *
+ * DESCRIPTION: Number of live sorted runs
+ */
+size_t LogStore::getRunCount() {
+	return runs.size();
+}
@@ -0,0 +1,143 @@
+/**********************************
+ * FILE NAME: LogStore.h
+ *
+ * DESCRIPTION: Header file of LogStore class
+ **********************************/
+
+#ifndef LOGSTORE_H_
+#define LOGSTORE_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include "RangeTable.h"
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+// memtable size (key and value bytes) that triggers a flush to a sorted run
+#define LOG_MEMTABLE_LIMIT (1024 * 1024)
+// number of sorted runs that triggers a compaction
+#define LOG_COMPACT_TRIGGER 4
+// entries merged per compaction step
+#define LOG_COMPACT_BUDGET 256
+#define LOG_RUN_MAGIC 0x4e52564b
+// initial value of a checksum, which may be extended over more bytes
+#define LOG_CHECKSUM_SEED 2166136261u
+
+/**
+ * Operations recorded in the log and in sorted runs
+ */
+enum LogOp { LOG_END, LOG_PUT, LOG_DEL };
+
+/**
+ * STRUCT NAME: LogEntry
+ *
+ * DESCRIPTION: Latest operation on a key held in the memtable
+ */
+typedef struct LogEntry {
+	char op;
+	string value;
+} LogEntry;
+
+/**
+ * CLASS NAME: RunReader
+ *
+ * DESCRIPTION: Sequential reader of one immutable sorted run file. A run ends with a
+ * 				LOG_END footer holding its entry count and a checksum of everything before
+ * 				it; a run that is cut short, holds lengths past its end or does not match
+ * 				its footer is reported as corrupt rather than as ended.
+ */
+class RunReader {
+private:
+	// bytes not read yet, entries read and checksum of the bytes read
+	long remaining;
+	unsigned long count;
+	uint32_t sum;
+
+	bool read(void *data, size_t len);
+	bool readFooter();
+
+public:
+	FILE *fp;
+	bool valid;
+	bool corrupt;
+	char op;
+	string key;
+	string value;
+	RunReader(string path);
+	virtual ~RunReader();
+	bool next();
+};
+
+/**
+ * CLASS NAME: LogStore
+ *
+ * DESCRIPTION: Log structured persistence behind a HashTable.
+ * 				1) Mutations are appended to a write ahead log and group committed once per tick
+ * 				2) They are also collected in a sorted memtable, which is flushed to an
+ * 				   immutable sorted run file when it grows past LOG_MEMTABLE_LIMIT
+ * 				3) Runs are merged by an incremental compaction, LOG_COMPACT_BUDGET entries per tick
+ * 				The MANIFEST file lists the live runs from oldest to newest.
+ * 				The store outlives the process: opening a directory that holds a store
+ * 				continues it, so recover() loads what earlier runs wrote there. A failed
+ * 				write is reported on stderr and leaves the log and the MANIFEST as they were.
+ */
+class LogStore {
+private:
+	string dir;
+	int walFd;
+	// bytes of committed records in the write ahead log
+	off_t walSize;
+	// records appended since the last commit
+	string walBuffer;
+	map<string, LogEntry> memtable;
+	size_t memtableBytes;
+	// live runs, oldest first
+	vector<string> runs;
+	int nextRunId;
+	// state of the running compaction
+	vector<RunReader *> compactInputs;
+	vector<string> compactInputNames;
+	FILE *compactOut;
+	string compactOutName;
+	unsigned long compactCount;
+	uint32_t compactSum;
+	// a live run is corrupt: it is never compacted away, so what is left of it stays
+	bool damaged;
+
+	LogStore(const LogStore &another);
+	LogStore& operator =(const LogStore &another);
+
+	string runPath(string name);
+	string newRunName();
+	static void failure(const char *operation, const string &path);
+	void corruption(const string &path);
+	void remember(char op, const char *key, size_t keyLen, const char *value, size_t valueLen);
+	void append(char op, const char *key, size_t keyLen, const char *value, size_t valueLen);
+	bool closeRun(FILE *fp, unsigned long count, uint32_t sum, const string &tmp, const string &path);
+	bool writeManifest(const vector<string> &list);
+	void readManifest();
+	bool flushMemtable();
+	bool startCompaction();
+	void abandonCompaction();
+	void finishCompaction();
+	size_t replayWal(RangeTable *table);
+
+public:
+	LogStore(string dir);
+	virtual ~LogStore();
+	static uint32_t checksum(const char *data, size_t len, uint32_t sum = LOG_CHECKSUM_SEED);
+	static void writeRunEntry(FILE *fp, char op, const string &key, const string &value, uint32_t &sum);
+	static bool writeRunFooter(FILE *fp, unsigned long count, uint32_t sum);
+	size_t recover(RangeTable *table);
+	void put(const char *key, size_t keyLen, const char *value, size_t valueLen);
+	void del(const char *key, size_t keyLen);
+	bool commit();
+	bool compactStep();
+	size_t getRunCount();
+};
+
+#endif /* LOGSTORE_H_ */
@@ -16,7 +16,7 @@
  * You can add new members to the class if you think it
  * is necessary for your logic to work
  */
-MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Address *address) {
+MP1Node::MP1Node(Member *member, Params *params, Transport *emul, Log *log, Address *address) {
 	for( int i = 0; i < 6; i++ ) {
 		NULLADDR[i] = 0;
 	}
@@ -45,7 +45,7 @@ int MP1Node::recvLoop() {
     	return false;
     }
     else {
-    	return emulNet->ENrecv(&(memberNode->addr), enqueueWrapper, NULL, 1, &(memberNode->mp1q));
+    	return emulNet->ENrecv(&(memberNode->addr), LANE_MASK(LANE_MEMBERSHIP), enqueueWrapper, NULL, 1, &(memberNode->mp1q));
     }
 }
 
@@ -56,7 +56,9 @@ int MP1Node::recvLoop() {
  */
 int MP1Node::enqueueWrapper(void *env, char *buff, int size) {
 	Queue q;
-	return q.enqueue((queue<q_elt> *)env, (void *)buff, size);
+	char *copy = (char *) malloc(size * sizeof(char));
+	memcpy(copy, buff, size);
+	return q.enqueue((queue<q_elt> *)env, (void *)copy, size);
 }
 
 /**
@@ -149,7 +151,7 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
 #endif
 
         // send JOINREQ message to introducer member
-        emulNet->ENsend(&memberNode->addr, joinaddr, msg, msgsize);
+        emulNet->ENsend(&memberNode->addr, joinaddr, msg, msgsize, LANE_MEMBERSHIP);
 
         free(msg);
     }
@@ -226,6 +228,7 @@ void MP1Node::checkMessages() {
     	size = memberNode->mp1q.front().size;
     	memberNode->mp1q.pop();
     	recvCallBack((void *)memberNode, (char *)ptr, size);
+    	free(ptr);
     }
     return;
 }
@@ -306,7 +309,7 @@ void MP1Node::sendMemberList(enum MsgTypes msgType, Address address) {
             
         }
     }
-    emulNet->ENsend(&memberNode->addr, &address, (char *)msg, sizeOfMessage);
+    emulNet->ENsend(&memberNode->addr, &address, (char *)msg, sizeOfMessage, LANE_MEMBERSHIP);
     free(msg);
 }
 
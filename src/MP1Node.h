@@ -12,7 +12,7 @@
 #include "Log.h"
 #include "Params.h"
 #include "Member.h"
-#include "EmulNet.h"
+#include "Transport.h"
 #include "Queue.h"
 
 /**
@@ -53,7 +53,7 @@ typedef struct MessageHdr {
  */
 class MP1Node {
 private:
-	EmulNet *emulNet;
+	Transport *emulNet;
 	Log *log;
 	Params *par;
 	Member *memberNode;
@@ -70,7 +70,7 @@ private:
 	void updateSelfMemberListEntry();
 
 public:
-	MP1Node(Member *, Params *, EmulNet *, Log *, Address *);
+	MP1Node(Member *, Params *, Transport *, Log *, Address *);
 	Member * getMemberNode() {
 		return memberNode;
 	}
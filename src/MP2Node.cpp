@@ -4,18 +4,35 @@
  * DESCRIPTION: MP2Node class definition
  **********************************/
 #include "MP2Node.h"
+#include <sys/stat.h>
 
 /**
  * constructor
  */
-MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet *emulNet, Log *log, Address *address)
+MP2Node::MP2Node(Member *memberNode, Params *par, Transport *emulNet, Log *log, Address *address)
 {
 	this->memberNode = memberNode;
 	this->par = par;
 	this->emulNet = emulNet;
 	this->log = log;
 	ht = new HashTable();
+	ht->setMemoryBudget(par->MEMORY_BUDGET);
+	readCache = par->READ_CACHE > 0 ? new ReadCache(par->READ_CACHE) : NULL;
 	this->memberNode->addr = *address;
+	streamer = new MessageStreamer(emulNet, par, *address);
+	if (par->STORE_DIR[0] != '\0') {
+		// recover whatever this node persisted before a restart, in this run or an earlier one
+		int id;
+		memcpy(&id, &address->addr[0], sizeof(int));
+		string dir = string(par->STORE_DIR) + "/node-" + to_string(id);
+		size_t recovered = ht->enableLog(dir);
+		if (recovered > 0)
+			log->LOG(&memberNode->addr, "recovered %lu logged operations from %s", (unsigned long)recovered, dir.c_str());
+	}
+	else if (par->SNAPSHOT_DIR[0] != '\0') {
+		// the durable log already recovers everything, a snapshot only helps in memory
+		loadSnapshot();
+	}
 }
 
 /**
@@ -60,6 +77,15 @@ bool MP2Node::updateRingVectorUsingMemberLists()
 
 	ring = newRing;
 
+	// a node MP1 no longer lists failed: stop holding back and streaming anything for it
+	for (size_t i = 0; i < prevRing.size(); i++) {
+		bool listed = false;
+		for (size_t j = 0; j < newRing.size() && !listed; j++)
+			listed = *newRing[j].getAddress() == *prevRing[i].getAddress();
+		if (!listed)
+			streamer->forget(*prevRing[i].getAddress());
+	}
+
 	//compare the rings:
 	if (prevRing.size() != newRing.size())
 		return true;
@@ -114,9 +140,8 @@ vector<Node> MP2Node::getMembershipList()
  */
 size_t MP2Node::hashFunction(string key)
 {
-	std::hash<string> hashFunc;
-	size_t ret = hashFunc(key);
-	return ret % RING_SIZE;
+	// the node's storage is partitioned by the same position
+	return RangeTable::token(key.data(), key.size());
 }
 
 /**
@@ -127,22 +152,88 @@ size_t MP2Node::hashFunction(string key)
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
+ * 				A positive ttl makes the replicas drop the key ttl ticks from now.
+ */
+void MP2Node::clientCreate(string key, string value, int ttl)
+{
+	// timestamp -1: every replica stamps the new record on arrival
+	Entry entry(value, -1, PRIMARY);
+	entry.expires = expiryOf(ttl);
+	sendCreate(key, entry);
+}
+
+/**
+ * FUNCTION NAME: expiryOf
+ *
+ * DESCRIPTION: Globaltime at which a record written now with a time-to-live of ttl expires
+ *
+ * RETURNS:
+ * expiry time, 0 if ttl is not positive
+ */
+int MP2Node::expiryOf(int ttl)
+{
+	return ttl > 0 ? par->getcurrtime() + ttl : 0;
+}
+
+/**
+ * FUNCTION NAME: addressesOf
+ *
+ * DESCRIPTION: Addresses of nodes, in order
  */
-void MP2Node::clientCreate(string key, string value)
+vector<Address> MP2Node::addressesOf(vector<Node> &nodes)
+{
+	vector<Address> addresses;
+	for (size_t i = 0; i < nodes.size(); i++)
+		addresses.push_back(*nodes[i].getAddress());
+	return addresses;
+}
+
+/**
+ * FUNCTION NAME: replicaTypesOf
+ *
+ * DESCRIPTION: Replica type of each of the replicas of a key, in order
+ */
+vector<ReplicaType> MP2Node::replicaTypesOf(vector<Node> &nodes)
+{
+	vector<ReplicaType> types;
+	for (size_t i = 0; i < nodes.size(); i++)
+		types.push_back((ReplicaType)i);
+	return types;
+}
+
+/**
+ * FUNCTION NAME: sendCreate
+ *
+ * DESCRIPTION: Sends a CREATE of entry to the replicas of key. An entry with a timestamp
+ * 				re-replicates an existing record (a tombstone included) as it is.
+ */
+void MP2Node::sendCreate(const string &key, Entry entry)
 {
 	vector<Node> replicas = findNodes(key);
 	g_transID++;
+	Message msg(g_transID, memberNode->addr, MessageType::CREATE, key, entry.value, PRIMARY);
+	msg.timestamp = entry.timestamp;
+	msg.flags = entry.flags;
+	msg.expires = entry.expires;
+	vector<Address> to;
+	vector<ReplicaType> types;
 	for (int i = 0; i < replicas.size(); i++)
 	{
-		Message msg(g_transID, memberNode->addr, MessageType::CREATE, key, value, (ReplicaType)i);
 		// preventing from going on network when the node is here!
 		if(*replicas[i].getAddress() == memberNode->addr)
-			handleCreateMsg(msg);
-		else
-			emulNet->ENsend(&memberNode->addr, replicas[i].getAddress(), msg.toString());
+		{
+			Message local = msg;
+			local.replica = (ReplicaType)i;
+			handleCreateMsg(local);
+			continue;
+		}
+		to.push_back(*replicas[i].getAddress());
+		types.push_back((ReplicaType)i);
 	}
+	streamer->multicast(to, types, msg);
 	// Create always meets quorom
-	log->logCreateSuccess(&memberNode->addr, true, g_transID, key, value);
+	if (!entry.isTombstone())
+		log->logCreateSuccess(&memberNode->addr, true, g_transID, key, entry.value);
 }
 /**
  * FUNCTION NAME: clientRead
@@ -152,17 +243,24 @@ void MP2Node::clientCreate(string key, string value)
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
+ * 				A key leased to the read cache is answered without asking the replicas.
  */
 void MP2Node::clientRead(string key)
 {
-	vector<Node> replicas = findNodes(key);
-	g_transID++;
-	for (auto replica : replicas)
+	string value;
+	if (readCache != NULL && readCache->lookup(key, par->getcurrtime(), value))
 	{
-		string l = "sending to " + replica.getAddress()->getAddress();
-		Message msg(g_transID, memberNode->addr, MessageType::READ, key);
-		emulNet->ENsend(&memberNode->addr, replica.getAddress(), msg.toString());
+		g_transID++;
+		log->logReadSuccess(&memberNode->addr, true, g_transID, key, value);
+		return;
 	}
+	vector<Node> replicas = findNodes(key);
+	g_transID++;
+	Message msg(g_transID, memberNode->addr, MessageType::READ, key);
+	// only the primary replica grants a lease, the others ignore the request
+	msg.lease = readCache != NULL ? 1 : 0;
+	vector<Address> to = addressesOf(replicas);
+	streamer->multicast(to, vector<ReplicaType>(), msg);
 	EntryState state;
 	state.timestap = memberNode->heartbeat;
 	state.key = key;
@@ -178,18 +276,22 @@ void MP2Node::clientRead(string key)
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
+ * 				A positive ttl makes the replicas drop the key ttl ticks from now.
  */
-void MP2Node::clientUpdate(string key, string value)
+void MP2Node::clientUpdate(string key, string value, int ttl)
 {
 	vector<Node> replicas = findNodes(key);
+	int expires = expiryOf(ttl);
+	if (readCache != NULL)
+		readCache->invalidate(key);
 	g_transID++;
-	for (int i = 0; i < replicas.size(); i++)
-	{
-		Message msg(g_transID, memberNode->addr, MessageType::UPDATE, key, value, (ReplicaType)i);
-		emulNet->ENsend(&memberNode->addr, replicas[i].getAddress(), msg.toString());
-	}
+	Message msg(g_transID, memberNode->addr, MessageType::UPDATE, key, value, PRIMARY);
+	msg.expires = expires;
+	vector<Address> to = addressesOf(replicas);
+	streamer->multicast(to, replicaTypesOf(replicas), msg);
 	EntryState state;
-	state.timestap = memberNode->heartbeat;
+	// a streamed value takes a few ticks to reach the replicas
+	state.timestap = memberNode->heartbeat + streamer->ticksToSend(value.size());
 	state.key = key;
 	state.type = UPDATE;
 	state.value = value;
@@ -208,12 +310,12 @@ void MP2Node::clientUpdate(string key, string value)
 void MP2Node::clientDelete(string key)
 {
 	vector<Node> replicas = findNodes(key);
+	if (readCache != NULL)
+		readCache->invalidate(key);
 	g_transID++;
-	for (auto replica : replicas)
-	{
-		Message msg(g_transID, memberNode->addr, MessageType::DELETE, key);
-		emulNet->ENsend(&memberNode->addr, replica.getAddress(), msg.toString());
-	}
+	Message msg(g_transID, memberNode->addr, MessageType::DELETE, key);
+	vector<Address> to = addressesOf(replicas);
+	streamer->multicast(to, vector<ReplicaType>(), msg);
 	EntryState state;
 	state.timestap = memberNode->heartbeat;
 	state.key = key;
@@ -226,13 +328,15 @@ void MP2Node::clientDelete(string key)
  *
  * DESCRIPTION: Server side CREATE API
  * 			   	The function does the following:
- * 			   	1) Inserts key value into the local hash table
+ * 			   	1) Inserts the entry into the local hash table, stamped with the global time
+ * 			   	   unless it is a re-replicated record that keeps its timestamp
  * 			   	2) Return true or false based on success or failure
  */
-bool MP2Node::createKeyValue(string key, string value, ReplicaType replica)
+bool MP2Node::createKeyValue(const string &key, Entry &entry)
 {
-	Entry entry(value, this->memberNode->heartbeat, replica);
-	return ht->create(key, entry.convertToString());
+	if (entry.timestamp < 0)
+		entry.timestamp = par->getcurrtime();
+	return ht->createRecord(key, entry);
 }
 
 /**
@@ -241,11 +345,14 @@ bool MP2Node::createKeyValue(string key, string value, ReplicaType replica)
  * DESCRIPTION: Server side READ API
  * 			    This function does the following:
  * 			    1) Read key from local hash table
- * 			    2) Return value
+ * 			    2) Return value, empty if the key is absent or deleted
  */
-string MP2Node::readKey(string key)
+string MP2Node::readKey(const string &key)
 {
-	return ht->read(key);
+	Record record;
+	if (!ht->readRecord(key, record) || record.isTombstone())
+		return "";
+	return record.getValue();
 }
 
 /**
@@ -253,13 +360,13 @@ string MP2Node::readKey(string key)
  *
  * DESCRIPTION: Server side UPDATE API
  * 				This function does the following:
- * 				1) Update the key to the new value in the local hash table
+ * 				1) Update the key to the entry, stamped with the global time, in the local hash table
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica)
+bool MP2Node::updateKeyValue(const string &key, Entry &entry)
 {
-	Entry entry(value, this->memberNode->heartbeat, replica);
-	return ht->update(key, entry.convertToString());
+	entry.timestamp = par->getcurrtime();
+	return ht->updateRecord(key, entry);
 }
 
 /**
@@ -267,12 +374,12 @@ bool MP2Node::updateKeyValue(string key, string value, ReplicaType replica)
  *
  * DESCRIPTION: Server side DELETE API
  * 				This function does the following:
- * 				1) Delete the key from the local hash table
+ * 				1) Replace the key by a tombstone in the local hash table
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::deletekey(string key)
+bool MP2Node::deletekey(const string &key)
 {
-	return ht->deleteKey(key);
+	return ht->deleteRecord(key, par->getcurrtime());
 }
 
 /**
@@ -294,6 +401,10 @@ void MP2Node::checkMessages()
 	/*
 	 * Declare your local variables here
 	 */
+	// reclaim the records whose time-to-live ran out before serving anything
+	ht->expireRecords(par->getcurrtime());
+	pruneLeases();
+
 	// dequeue all messages and handle them
 	while (!memberNode->mp2q.empty())
 	{
@@ -304,13 +415,49 @@ void MP2Node::checkMessages()
 		size = memberNode->mp2q.front().size;
 		memberNode->mp2q.pop();
 
-		string message(data, data + size);
-		Message msg(message);
+		// decoded in one pass; a CREATE or UPDATE value is left in the frame, which is
+		// released only once every queued message was handled
+		Message msg(data, size);
+		if (!msg.valid)
+			continue;
+		// a reply still streaming in keeps its read from timing out
+		if (msg.type == CHUNK)
+			refreshRead(msg.transID);
+		// chunks are kept until the value they carry is complete
+		if (!streamer->receive(msg))
+			continue;
 		dispatchMessages(msg);
 	}
+	// the queued messages pointed into the received frames
+	for (size_t i = 0; i < inFrames.size(); i++)
+		emulNet->ENrelease(inFrames[i]);
+	inFrames.clear();
+	// put the next window of the streamed values on the network
+	streamer->pump();
 
 	checkQuorumAndTimeout();
-	
+	// bring the table back under its memory budget
+	ht->evictToBudget();
+	// group commit everything this tick wrote
+	ht->commitLog();
+	// move a bounded part of a restored snapshot into memory
+	ht->rebuildStep(SNAPSHOT_REBUILD_BUDGET);
+	// background compaction of expired tombstones
+	ht->purgeTombstones(par->getcurrtime() - TOMBSTONE_GRACE, TOMBSTONE_PURGE_BUDGET);
+}
+
+/**
+ * FUNCTION NAME: refreshRead
+ *
+ * DESCRIPTION: A chunk of a reply to the read transID arrived: the read is making progress,
+ * 				so its timeout starts over. A large value takes more ticks to stream than
+ * 				FAIL_TIMEOUT, and its size is not known when the read is sent.
+ */
+void MP2Node::refreshRead(int transID)
+{
+	map<int, EntryState>::iterator job = waitedJobs.find(transID);
+	if (job != waitedJobs.end() && job->second.type == READ && !job->second.done)
+		job->second.timestap = memberNode->heartbeat;
 }
 
 void MP2Node::checkQuorumAndTimeout() {
@@ -318,24 +465,37 @@ void MP2Node::checkQuorumAndTimeout() {
 	while (it != waitedJobs.end())
 	{
 		int tid = it->first;
-		EntryState state = it->second;
+		EntryState &state = it->second;
 		if (state.done) {
 			it++;
 			continue;
 		}
-		if (state.recievedValues.size() >= 2)
+		if (state.replies >= 2)
 		{
 			if(state.type == READ) {
-				Entry entry(state.recievedValues[0]);
-
-				log->logReadSuccess(&memberNode->addr, true, tid, state.key, entry.value);
+				// reconcile the replies: the newest timestamp wins, a tombstone hides values of its tick or older
+				size_t newest = 0;
+				for (size_t i = 1; i < state.records.size(); i++) {
+					Entry &another = state.records[i];
+					if (Entry::supersedes(another.timestamp, another.isTombstone(), state.records[newest].timestamp, state.records[newest].isTombstone()))
+						newest = i;
+				}
+				Entry &entry = state.records[newest];
+
+				if (entry.isTombstone())
+					log->logReadFail(&memberNode->addr, true, tid, state.key);
+				else {
+					log->logReadSuccess(&memberNode->addr, true, tid, state.key, entry.value);
+					if (readCache != NULL && !state.revoked && state.lease > par->getcurrtime())
+						readCache->insert(state.key, entry.value, state.lease);
+				}
 			}
 			else if (state.type == UPDATE)
 				log->logUpdateSuccess(&memberNode->addr, true, tid, state.key, state.value);
 			else if (state.type == DELETE)
 				log->logDeleteSuccess(&memberNode->addr, true, tid, state.key);
 
-			waitedJobs[tid].done = true;
+			state.done = true;
 			// cerr << memberNode->heartbeat - state.timestap << endl;
 		}
 		else if (memberNode->heartbeat - state.timestap >= FAIL_TIMEOUT) {
@@ -345,58 +505,90 @@ void MP2Node::checkQuorumAndTimeout() {
 				log->logUpdateFail(&memberNode->addr, true, tid, state.key, state.value);
 			else if (state.type == DELETE)
 				log->logDeleteFail(&memberNode->addr, true, tid, state.key);	
-			waitedJobs[tid].done = true;
+			state.done = true;
 		}
 		it++;
 	}
 }
-void MP2Node::handleCreateMsg(Message message)
+/**
+ * FUNCTION NAME: logged
+ *
+ * DESCRIPTION: The part of the size value bytes at data that goes into a log line, so that
+ * 				logging does not copy a whole value
+ */
+static string logged(const char *data, size_t size)
+{
+	return string(data, min(size, (size_t)LOG_VALUE_MAX));
+}
+
+void MP2Node::handleCreateMsg(Message &message)
 {
-	bool createWasSuccessfull = this->createKeyValue(message.key, message.value, message.replica);
+	// a re-replicated record keeps its timestamp so that it cannot override a newer delete;
+	// the value is copied once, from the received frame into the table
+	Entry entry(message.getValueData(), message.getValueSize(), message.timestamp, message.replica, message.flags);
+	entry.expires = message.expires;
+	bool createWasSuccessfull = this->createKeyValue(message.key, entry);
+	if (entry.isTombstone())
+		return;
 	if (createWasSuccessfull)
-		log->logCreateSuccess(&memberNode->addr, false, message.transID, message.key, message.value);
+		log->logCreateSuccess(&memberNode->addr, false, message.transID, message.key, logged(entry.getValueData(), entry.getValueSize()));
 	else
-		log->logCreateFail(&memberNode->addr, false, message.transID, message.key, message.value);
+		log->logCreateFail(&memberNode->addr, false, message.transID, message.key, logged(entry.getValueData(), entry.getValueSize()));
 }
 
-void MP2Node::handleUpdateMsg(Message message)
+void MP2Node::handleUpdateMsg(Message &message)
 {
-	bool updateWasSuccessfull = this->updateKeyValue(message.key, message.value, message.replica);
+	revokeLeases(message.key);
+	Entry entry(message.getValueData(), message.getValueSize(), -1, message.replica, 0);
+	entry.expires = message.expires;
+	bool updateWasSuccessfull = this->updateKeyValue(message.key, entry);
 	if (updateWasSuccessfull)
 	{
-		log->logUpdateSuccess(&memberNode->addr, false, message.transID, message.key, message.value);
-		Message msg(message.transID, memberNode->addr, MessageType::REPLY, message.key, message.value);
-		emulNet->ENsend(&memberNode->addr, &message.fromAddr, msg.toString());
+		log->logUpdateSuccess(&memberNode->addr, false, message.transID, message.key, logged(entry.getValueData(), entry.getValueSize()));
+		Message msg(message.transID, memberNode->addr, MessageType::REPLY, true);
+		streamer->send(&message.fromAddr, msg);
 	}
 	else
 	{
-		log->logUpdateFail(&memberNode->addr, false, message.transID, message.key, message.value);
+		log->logUpdateFail(&memberNode->addr, false, message.transID, message.key, logged(entry.getValueData(), entry.getValueSize()));
 	}
 }
 
-void MP2Node::handleReadMsg(Message message)
+void MP2Node::handleReadMsg(Message &message)
 {
-	string value = this->readKey(message.key);
-	if (value != "")
+	// the reply carries the record's timestamp and flags for the coordinator's reconciliation
+	Record record;
+	bool found = ht->readRecord(message.key, record);
+	if (found && !record.isTombstone())
 	{
-		log->logReadSuccess(&memberNode->addr, false, message.transID, message.key, value);
-		Message msg(message.transID, memberNode->addr, MessageType::READREPLY, message.key, value);
-		emulNet->ENsend(&memberNode->addr, &message.fromAddr, msg.toString());
+		log->logReadSuccess(&memberNode->addr, false, message.transID, message.key, logged(record.value, record.getValueLength()));
+		// serialized straight from the stored record, which nothing changes before the send
+		Message msg(message.transID, memberNode->addr, "", record.getTimestamp(), record.getFlags());
+		msg.viewValue(record.value, record.getValueLength());
+		if (message.lease > 0)
+			msg.lease = grantLease(message.key, message.fromAddr);
+		streamer->send(&message.fromAddr, msg);
 	}
 	else
 	{
 		log->logReadFail(&memberNode->addr, false, message.transID, message.key);
+		if (found) {
+			// the tombstone takes part in the coordinator's reconciliation
+			Message msg(message.transID, memberNode->addr, "", record.getTimestamp(), record.getFlags());
+			streamer->send(&message.fromAddr, msg);
+		}
 	}
 }
 
-void MP2Node::handleDeleteMsg(Message message)
+void MP2Node::handleDeleteMsg(Message &message)
 {
+	revokeLeases(message.key);
 	bool deleteWasSuccessfull = this->deletekey(message.key);
 	if (deleteWasSuccessfull)
 	{
 		log->logDeleteSuccess(&memberNode->addr, false, message.transID, message.key);
 		Message msg(message.transID, memberNode->addr, MessageType::REPLY, message.key);
-		emulNet->ENsend(&memberNode->addr, &message.fromAddr, msg.toString());
+		streamer->send(&message.fromAddr, msg);
 	}
 	else
 	{
@@ -404,18 +596,107 @@ void MP2Node::handleDeleteMsg(Message message)
 	}
 }
 
-void MP2Node::handleReplyMsg(Message message)
+void MP2Node::handleReplyMsg(Message &message)
 {
 	map<int, EntryState>::iterator search;
 	search = waitedJobs.find(message.transID);
 	if (search != waitedJobs.end())
 	{
-		string val = message.type == REPLY ? "" : message.value;
-		waitedJobs[message.transID].recievedValues.push_back(val);
+		EntryState &state = search->second;
+		state.replies++;
+		if (message.type == READREPLY)
+			state.records.push_back(Entry(std::move(message.value), message.timestamp, message.replica, message.flags));
+		if (message.lease > 0)
+			state.lease = message.lease;
 	}
 }
 
-void MP2Node::dispatchMessages(Message message)
+void MP2Node::handleInvalidateMsg(Message &message)
+{
+	if (readCache == NULL)
+		return;
+	readCache->invalidate(message.key);
+	// a read still waiting for its quorum may carry the revoked lease, also with a reply
+	// that is still on its way: the reply lane is not ordered with the request lane
+	for (map<int, EntryState>::iterator it = waitedJobs.begin(); it != waitedJobs.end(); it++)
+	{
+		if (!it->second.done && it->second.type == READ && it->second.key == message.key)
+		{
+			it->second.lease = 0;
+			it->second.revoked = true;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: grantLease
+ *
+ * DESCRIPTION: As primary replica of key, lets holder cache key for READ_LEASE ticks.
+ * 				Other replicas grant nothing.
+ *
+ * RETURNS:
+ * globaltime at which the lease ends, 0 if none was granted
+ */
+int MP2Node::grantLease(string key, Address holder)
+{
+	vector<Node> replicas = findNodes(key);
+	if (replicas.empty() || !(*replicas[0].getAddress() == memberNode->addr))
+		return 0;
+	int end = par->getcurrtime() + READ_LEASE;
+	leases[key][holder.getAddress()] = end;
+	leaseExpiry.schedule(key, end);
+	return end;
+}
+
+/**
+ * FUNCTION NAME: revokeLeases
+ *
+ * DESCRIPTION: Key is being written: every holder of a running lease on it drops its cached copy
+ */
+void MP2Node::revokeLeases(string key)
+{
+	map<string, map<string, int> >::iterator search = leases.find(key);
+	if (search == leases.end())
+		return;
+	vector<Address> holders;
+	for (map<string, int>::iterator it = search->second.begin(); it != search->second.end(); it++)
+	{
+		if (it->second > par->getcurrtime())
+			holders.push_back(Address(it->first));
+	}
+	Message msg(g_transID, memberNode->addr, MessageType::INVALIDATE, key);
+	streamer->multicast(holders, vector<ReplicaType>(), msg);
+	leases.erase(search);
+}
+
+/**
+ * FUNCTION NAME: pruneLeases
+ *
+ * DESCRIPTION: Forgets the leases that ended, driven by the lease timer wheel
+ */
+void MP2Node::pruneLeases()
+{
+	vector<WheelTimer> due;
+	leaseExpiry.advance(par->getcurrtime(), due);
+	for (size_t i = 0; i < due.size(); i++)
+	{
+		map<string, map<string, int> >::iterator search = leases.find(due[i].key);
+		if (search == leases.end())
+			continue;
+		map<string, int>::iterator it = search->second.begin();
+		while (it != search->second.end())
+		{
+			if (it->second <= par->getcurrtime())
+				it = search->second.erase(it);
+			else
+				it++;
+		}
+		if (search->second.empty())
+			leases.erase(search);
+	}
+}
+
+void MP2Node::dispatchMessages(Message &message)
 {
 	switch (message.type)
 	{
@@ -435,6 +716,9 @@ void MP2Node::dispatchMessages(Message message)
 	case MessageType::READREPLY:
 		this->handleReplyMsg(message);
 		break;
+	case MessageType::INVALIDATE:
+		this->handleInvalidateMsg(message);
+		break;
 	default:
 		break;
 	}
@@ -448,7 +732,16 @@ void MP2Node::dispatchMessages(Message message)
  */
 vector<Node> MP2Node::findNodes(string key)
 {
-	size_t pos = hashFunction(key);
+	return findNodesAt(hashFunction(key));
+}
+
+/**
+ * FUNCTION NAME: findNodesAt
+ *
+ * DESCRIPTION: Find the replicas of a ring position, shared by every key of that token range
+ */
+vector<Node> MP2Node::findNodesAt(size_t pos)
+{
 	vector<Node> addr_vec;
 	if (ring.size() >= 3)
 	{
@@ -462,7 +755,7 @@ vector<Node> MP2Node::findNodes(string key)
 		else
 		{
 			// go through the ring until pos <= node
-			for (int i = 1; i < ring.size(); i++)
+			for (size_t i = 1; i < ring.size(); i++)
 			{
 				Node addr = ring.at(i);
 				if (pos <= addr.getHashCode())
@@ -481,7 +774,8 @@ vector<Node> MP2Node::findNodes(string key)
 /**
  * FUNCTION NAME: recvLoop
  *
- * DESCRIPTION: Receive messages from EmulNet and push into the queue (mp2q)
+ * DESCRIPTION: Receive messages from the transport and push into the queue (mp2q).
+ * 				The frames are taken over as they are, the queue points into them.
  */
 bool MP2Node::recvLoop()
 {
@@ -491,20 +785,118 @@ bool MP2Node::recvLoop()
 	}
 	else
 	{
-		return emulNet->ENrecv(&(memberNode->addr), this->enqueueWrapper, NULL, 1, &(memberNode->mp2q));
+		Queue q;
+		size_t first = inFrames.size();
+		emulNet->ENrecvFrames(&(memberNode->addr), inFrames, EN_ALL_LANES & ~LANE_MASK(LANE_MEMBERSHIP));
+		for (size_t i = first; i < inFrames.size(); i++)
+		{
+			int pos = 0;
+			char *data;
+			int size;
+			while (Transport::ENnext(inFrames[i], pos, data, size))
+				q.enqueue(&(memberNode->mp2q), data, size);
+		}
+		return inFrames.size() > first;
 	}
 }
 
 /**
- * FUNCTION NAME: enqueueWrapper
+ * FUNCTION NAME: releaseStorage
+ *
+ * DESCRIPTION: A failed node loses everything it held in memory. The hash table
+ * 				is released and the frames of the queued messages go back to the transport.
+ */
+void MP2Node::releaseStorage()
+{
+	ht->clear();
+	queue<q_elt> empty;
+	swap(memberNode->mp2q, empty);
+	for (size_t i = 0; i < inFrames.size(); i++)
+		emulNet->ENrelease(inFrames[i]);
+	inFrames.clear();
+}
+/**
+ * FUNCTION NAME: snapshotPath
+ *
+ * DESCRIPTION: Snapshot file of this node
+ */
+string MP2Node::snapshotPath()
+{
+	int id;
+	memcpy(&id, &memberNode->addr.addr[0], sizeof(int));
+	return string(par->SNAPSHOT_DIR) + "/node-" + to_string(id) + ".snap";
+}
+
+/**
+ * FUNCTION NAME: saveSnapshot
+ *
+ * DESCRIPTION: Writes the hash table, the membership list and the ring of this node
+ * 				to its snapshot file, if SNAPSHOT_DIR is set
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool MP2Node::saveSnapshot()
+{
+	if (par->SNAPSHOT_DIR[0] == '\0')
+		return false;
+	mkdir(par->SNAPSHOT_DIR, 0755);
+	ht->finishRebuild();
+	return Snapshot::write(snapshotPath(), ht->hashTable, memberNode->memberList, ring, memberNode->heartbeat);
+}
+
+/**
+ * FUNCTION NAME: loadSnapshot
  *
- * DESCRIPTION: Enqueue the message from Emulnet into the queue of MP2Node
+ * DESCRIPTION: Maps the snapshot of this node, if there is one. The table serves it
+ * 				right away and copies it into memory over the following ticks. The
+ * 				ring is restored as well so keys can be routed before the node has
+ * 				rejoined; the membership list is refreshed by MP1 on rejoin anyway.
  */
-int MP2Node::enqueueWrapper(void *env, char *buff, int size)
+void MP2Node::loadSnapshot()
 {
-	Queue q;
-	return q.enqueue((queue<q_elt> *)env, (void *)buff, size);
+	Snapshot *snapshot = Snapshot::open(snapshotPath());
+	if (snapshot == NULL)
+		return;
+	ring = snapshot->getRing();
+	memberNode->memberList = snapshot->getMembers();
+	memberNode->heartbeat = snapshot->getHeartbeat();
+	ht->attachSnapshot(snapshot);
 }
+
+/**
+ * FUNCTION NAME: logStats
+ *
+ * DESCRIPTION: Writes storage statistics to the stats log: memory use and eviction counters,
+ * 				streaming, backpressure and read cache counters, then the outcome of the
+ * 				negative lookup filters, node totals first and then every token range
+ * 				whose filter let an absent key through
+ */
+void MP2Node::logStats()
+{
+	unsigned long negatives, falsePositives, hits;
+	RangeTable &table = ht->hashTable;
+	log->LOG(&memberNode->addr, "#STATSLOG# memory usage: %lu budget: %lu evictions: %lu evicted bytes: %lu pressure events: %lu",
+		(unsigned long)table.getMemoryUsage(), (unsigned long)ht->memoryBudget, ht->evictions, ht->evictedBytes, ht->pressureEvents);
+	log->LOG(&memberNode->addr, "#STATSLOG# chunks sent: %lu chunks received: %lu chunks rejected: %lu streams dropped: %lu",
+		streamer->getChunksSent(), streamer->getChunksReceived(), streamer->getChunksRejected(), streamer->getStreamsDropped());
+	log->LOG(&memberNode->addr, "#STATSLOG# messages held back: %lu most held back: %lu dropped: %lu",
+		streamer->getMessagesDeferred(), (unsigned long)streamer->getDeferredPeak(), streamer->getMessagesDropped());
+	if (readCache != NULL)
+		log->LOG(&memberNode->addr, "#STATSLOG# read cache hits: %lu misses: %lu invalidations: %lu evictions: %lu bytes: %lu",
+			readCache->getHits(), readCache->getMisses(), readCache->getInvalidations(), readCache->getEvictions(),
+			(unsigned long)readCache->getBytes());
+	table.getFilterStats(negatives, falsePositives, hits);
+	log->LOG(&memberNode->addr, "#STATSLOG# bloom rejected: %lu false positives: %lu hits: %lu false positive rate: %.4f",
+		negatives, falsePositives, hits, table.falsePositiveRate());
+	for (size_t token = 0; token < RING_SIZE; token++) {
+		if (table.rangeFalsePositiveRate(token) > 0)
+			log->LOG(&memberNode->addr, "#STATSLOG# bloom range: %lu keys: %lu false positive rate: %.4f",
+				(unsigned long)token, (unsigned long)table.rangeCount(token), table.rangeFalsePositiveRate(token));
+	}
+}
+
 /**
  * FUNCTION NAME: stabilizationProtocol
  *
@@ -516,22 +908,28 @@ int MP2Node::enqueueWrapper(void *env, char *buff, int size)
  */
 void MP2Node::stabilizationProtocol()
 {
-	map<string, string> hashTable = ht->hashTable;
-	
-	for (auto it = hashTable.begin(); it != hashTable.end(); it++) {
-		vector<Node> replicas = findNodes(it->first);
-		Entry entry(it->second);
+	// every key is examined below, so take over what is left of a snapshot first
+	ht->finishRebuild();
+
+	// all keys of a token range share their replicas, so ownership is decided per range
+	for (size_t token = 0; token < RING_SIZE; token++) {
+		FlatTable *range = ht->hashTable.getRange(token);
+		if (range == NULL)
+			continue;
+		vector<Node> replicas = findNodesAt(token);
 
 		bool inReplicas = false;
 		for (auto replica : replicas)
 			if (*replica.getAddress() == memberNode->addr)
 				inReplicas = true;
 
-		if (!inReplicas) {
-			ht->deleteKey(it->first);
-		}
-		// Create replicas again
-		this->clientCreate(it->first, entry.value);
+		// Create replicas again, tombstones included and with their original timestamps.
+		// A copy sent to this node is not newer than itself, so the range is not modified.
+		for (FlatTable::iterator it = range->begin(); it != range->end(); ++it)
+			this->sendCreate(it.key(), Entry(Record(it.valueData())));
 		// TODO: create replicas more selectively and efficiently!
+
+		if (!inReplicas)
+			ht->dropRange(token);
 	}
 }
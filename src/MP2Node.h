@@ -12,12 +12,15 @@
  */
 #include <stdarg.h>
 #include "stdincludes.h"
-#include "EmulNet.h"
+#include "Transport.h"
 #include "Node.h"
 #include "HashTable.h"
 #include "Log.h"
 #include "Params.h"
 #include "Message.h"
+#include "ReadCache.h"
+#include "MessageStreamer.h"
+#include "TimerWheel.h"
 #include "Queue.h"
 #include <ctime>
 #include <map>
@@ -26,6 +29,12 @@
 
 
 #define FAIL_TIMEOUT 5
+// globaltime ticks a tombstone is kept before the background compaction may purge it
+#define TOMBSTONE_GRACE 100
+// records the tombstone compaction looks at per tick
+#define TOMBSTONE_PURGE_BUDGET 64
+// globaltime ticks a read lease granted by a primary replica lasts
+#define READ_LEASE 10
 
 class EntryState
 {
@@ -33,10 +42,18 @@ public:
 	string key;
 	
 	string value = "";
-	vector<string> recievedValues;
+	// REPLY and READREPLY messages received
+	int replies = 0;
+	// READ: the records the replicas replied with, tombstones included
+	vector<Entry> records;
 	MessageType type;
 	bool done = false;
 	long timestap = 0;
+	// READ: end of the lease the primary granted with its reply, 0 if none
+	int lease = 0;
+	// READ: the primary revoked the lease while the read waited; a reply arriving after
+	// the revocation carries a value the write may have replaced, so nothing is cached
+	bool revoked = false;
 };
 /**
  * CLASS NAME: MP2Node
@@ -59,27 +76,48 @@ private:
 	vector<Node> ring;
 	// Hash Table
 	HashTable *ht;
+	// Received frames the queued messages point into, released once handled
+	vector<en_msg *> inFrames;
 	// Member representing this member
 	Member *memberNode;
 	// Params object
 	Params *par;
-	// Object of EmulNet
-	EmulNet *emulNet;
+	// Transport the node sends and receives through
+	Transport *emulNet;
+	// Sends messages through the transport, streaming the values too large for one message
+	MessageStreamer *streamer;
 	// Object of Log
 	Log *log;
 	// State of waited jobs
 	map<int, EntryState> waitedJobs;
+	// Coordinator read cache, NULL unless enabled
+	ReadCache *readCache;
+	// Read leases granted as primary replica: key -> holder address -> end of the lease
+	map<string, map<string, int> > leases;
+	// Ends of the granted leases, to forget them
+	TimerWheel leaseExpiry;
 
 	bool updateRingVectorUsingMemberLists();
+	string snapshotPath();
+	void loadSnapshot();
 	void checkQuorumAndTimeout();
-	void handleCreateMsg(Message message);
-	void handleUpdateMsg(Message message);
-	void handleReadMsg(Message message);
-	void handleDeleteMsg(Message message);
-	void handleReplyMsg(Message message);
+	void refreshRead(int transID);
+	void handleCreateMsg(Message &message);
+	void handleUpdateMsg(Message &message);
+	void handleReadMsg(Message &message);
+	void handleDeleteMsg(Message &message);
+	void handleReplyMsg(Message &message);
+	void handleInvalidateMsg(Message &message);
+	int grantLease(string key, Address holder);
+	void revokeLeases(string key);
+	void pruneLeases();
+	void sendCreate(const string &key, Entry entry);
+	int expiryOf(int ttl);
+	static vector<Address> addressesOf(vector<Node> &nodes);
+	static vector<ReplicaType> replicaTypesOf(vector<Node> &nodes);
 
 public:
-	MP2Node(Member *memberNode, Params *par, EmulNet *emulNet, Log *log, Address *addressOfMember);
+	MP2Node(Member *memberNode, Params *par, Transport *emulNet, Log *log, Address *addressOfMember);
 	Member *getMemberNode()
 	{
 		return this->memberNode;
@@ -91,30 +129,40 @@ public:
 	size_t hashFunction(string key);
 	void findNeighbors();
 
-	// client side CRUD APIs
-	void clientCreate(string key, string value);
+	// client side CRUD APIs, ttl in globaltime ticks (0: the record never expires)
+	void clientCreate(string key, string value, int ttl = 0);
 	void clientRead(string key);
-	void clientUpdate(string key, string value);
+	void clientUpdate(string key, string value, int ttl = 0);
 	void clientDelete(string key);
 
 	// receive messages from Emulnet
 	bool recvLoop();
-	static int enqueueWrapper(void *env, char *buff, int size);
 
 	// handle messages from receiving queue
 	void checkMessages();
 
+	// drop all in-memory state of a failed node
+	void releaseStorage();
+
+	// dump the table, membership and ring for a warm restart
+	bool saveSnapshot();
+
+	// write storage statistics to the stats log
+	void logStats();
+
 	// coordinator dispatches messages to corresponding nodes
-	void dispatchMessages(Message message);
+	void dispatchMessages(Message &message);
 
 	// find the addresses of nodes that are responsible for a key
 	vector<Node> findNodes(string key);
+	vector<Node> findNodesAt(size_t pos);
 
 	// server
-	bool createKeyValue(string key, string value, ReplicaType replica);
-	string readKey(string key);
-	bool updateKeyValue(string key, string value, ReplicaType replica);
-	bool deletekey(string key);
+	// entries are moved into the table, so the value is copied once, from the message
+	bool createKeyValue(const string &key, Entry &entry);
+	string readKey(const string &key);
+	bool updateKeyValue(const string &key, Entry &entry);
+	bool deletekey(const string &key);
 
 	// stabilization protocol - handle multiple failures
 	void stabilizationProtocol();
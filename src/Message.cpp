@@ -8,51 +8,289 @@
 /**
  * Constructor
  */
-// transID::fromAddr::CREATE::key::value::ReplicaType
-// transID::fromAddr::READ::key
-// transID::fromAddr::UPDATE::key::value::ReplicaType
-// transID::fromAddr::DELETE::key
-// transID::fromAddr::REPLY::sucess
-// transID::fromAddr::READREPLY::value
-Message::Message(string message){
-	this->delimiter = "::";
-	vector<string> tuple;
-	size_t pos = message.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = message.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + 2;
-		pos = message.find(delimiter, start);
-	}
-	tuple.push_back(message.substr(start));
-
-	transID = stoi(tuple.at(0));
-	Address addr(tuple.at(1));
-	fromAddr = addr;
-	type = static_cast<MessageType>(stoi(tuple.at(2)));
+// version type fromAddr transID, then by type:
+// CREATE, UPDATE: replica flags timestamp expires stream key value
+// READ: lease key
+// DELETE, INVALIDATE: key
+// REPLY: success
+// READREPLY: flags timestamp lease stream value
+// CHUNK: stream offset length bytes
+// type, replica, flags and success are one byte, fromAddr is its 6 raw bytes, integers are
+// varints (timestamp zigzag encoded, it may be -1) and key, value and bytes are prefixed
+// with their length as a varint
+Message::Message(const char *data, size_t size): Message() {
+	const char *end = data + size;
+	valid = false;
+	if (size < MESSAGE_HEADER_SIZE || data[0] != MESSAGE_WIRE_VERSION)
+		return;
+	type = static_cast<MessageType>((unsigned char)data[1]);
+	memcpy(fromAddr.addr, data + 2, sizeof(fromAddr.addr));
+	data += MESSAGE_HEADER_SIZE;
+	unsigned long number[3];
+	if (!getVarint(data, end, number[0]))
+		return;
+	transID = (int)number[0];
 	switch(type){
 		case CREATE:
 		case UPDATE:
-			key = tuple.at(3);
-			value = tuple.at(4);
-			if (tuple.size() > 5)
-				replica = static_cast<ReplicaType>(stoi(tuple.at(5)));
+			if (end - data < 2)
+				return;
+			replica = static_cast<ReplicaType>((unsigned char)data[0]);
+			flags = (unsigned char)data[1];
+			data += 2;
+			if (!getVarint(data, end, number[0]) || !getVarint(data, end, number[1]) || !getVarint(data, end, number[2]))
+				return;
+			timestamp = (int)(number[0] >> 1) ^ -(int)(number[0] & 1);
+			expires = (int)number[1];
+			stream = (int)number[2];
+			// the value is left in the network buffer, to be copied once into the table
+			if (!getBytes(data, end, key) || !getBytes(data, end, valueData, valueSize))
+				return;
 			break;
 		case READ:
+			if (!getVarint(data, end, number[0]))
+				return;
+			lease = (int)number[0];
+			// fall through
 		case DELETE:
-			key = tuple.at(3);
+		case INVALIDATE:
+			if (!getBytes(data, end, key))
+				return;
 			break;
 		case REPLY:
-			if (tuple.at(3) == "1")
-				success = true;
-			else
-				success = false;
+			if (end - data < 1)
+				return;
+			success = data[0] != 0;
+			data++;
 			break;
 		case READREPLY:
-			value = tuple.at(3);
+			if (end - data < 1)
+				return;
+			flags = (unsigned char)data[0];
+			data++;
+			if (!getVarint(data, end, number[0]) || !getVarint(data, end, number[1]) || !getVarint(data, end, number[2]))
+				return;
+			timestamp = (int)(number[0] >> 1) ^ -(int)(number[0] & 1);
+			lease = (int)number[1];
+			stream = (int)number[2];
+			if (!getBytes(data, end, value))
+				return;
 			break;
+		case CHUNK:
+			if (!getVarint(data, end, number[0]) || !getVarint(data, end, number[1]) || !getVarint(data, end, number[2]))
+				return;
+			stream = (int)number[0];
+			offset = number[1];
+			length = number[2];
+			if (!getBytes(data, end, value))
+				return;
+			break;
+		default:
+			return;
 	}
+	valid = data == end;
+}
+
+/**
+ * Constructor
+ */
+Message::Message(){
+	valid = true;
+	transID = 0;
+	type = REPLY;
+	replica = PRIMARY;
+	success = false;
+	timestamp = -1;
+	flags = 0;
+	expires = 0;
+	lease = 0;
+	stream = 0;
+	offset = 0;
+	length = 0;
+	valueData = NULL;
+	valueSize = 0;
+}
+
+/**
+ * Constructor
+ */
+Message::Message(const string &message): Message(message.data(), message.size()) {}
+
+/**
+ * FUNCTION NAME: getValueData
+ *
+ * DESCRIPTION: The value bytes, in the received buffer or in value
+ */
+const char *Message::getValueData() {
+	return valueData != NULL ? valueData : value.data();
+}
+
+/**
+ * FUNCTION NAME: getValueSize
+ *
+ * DESCRIPTION: Number of value bytes
+ */
+size_t Message::getValueSize() {
+	return valueData != NULL ? valueSize : value.size();
+}
+
+/**
+ * FUNCTION NAME: takeValue
+ *
+ * DESCRIPTION: Moves the value out of the Message, copying it if it is only viewed, for a
+ * 				value that has to outlive the buffer it was received in
+ */
+string Message::takeValue() {
+	if (valueData == NULL)
+		return std::move(value);
+	string taken(valueData, valueSize);
+	valueData = NULL;
+	valueSize = 0;
+	return taken;
+}
+
+/**
+ * FUNCTION NAME: viewValue
+ *
+ * DESCRIPTION: Makes the size bytes at data the value without copying them. They have to
+ * 				stay unchanged until the Message is serialized.
+ */
+void Message::viewValue(const char *data, size_t size) {
+	value.clear();
+	valueData = data;
+	valueSize = size;
+}
+
+/**
+ * FUNCTION NAME: setReplica
+ *
+ * DESCRIPTION: Sets the replica type of the serialized message at wire, so one
+ * 				serialization of a CREATE or UPDATE serves all its replicas. Other
+ * 				types have no replica type and are left as they are.
+ */
+void Message::setReplica(char *wire, ReplicaType replica) {
+	MessageType type = (MessageType)wire[1];
+	if (type != CREATE && type != UPDATE) {
+		return;
+	}
+	// the replica byte follows the transID varint
+	char *at = wire + MESSAGE_HEADER_SIZE;
+	while (*at & 0x80) {
+		at++;
+	}
+	at[1] = (char)replica;
+}
+
+/**
+ * FUNCTION NAME: varintSize
+ *
+ * DESCRIPTION: Bytes putVarint writes for number
+ */
+size_t Message::varintSize(unsigned long number) {
+	size_t size = 1;
+	while (number >= 0x80) {
+		number >>= 7;
+		size++;
+	}
+	return size;
+}
+
+/**
+ * FUNCTION NAME: putVarint
+ *
+ * DESCRIPTION: Writes number at out, 7 bits per byte, low bits first
+ *
+ * RETURNS:
+ * the end of the varint
+ */
+char *Message::putVarint(char *out, unsigned long number) {
+	while (number >= 0x80) {
+		*out++ = (char)(number | 0x80);
+		number >>= 7;
+	}
+	*out++ = (char)number;
+	return out;
+}
+
+/**
+ * FUNCTION NAME: putBytes
+ *
+ * DESCRIPTION: Writes bytes at out, prefixed with their length
+ *
+ * RETURNS:
+ * the end of the bytes
+ */
+char *Message::putBytes(char *out, const string &bytes) {
+	return putBytes(out, bytes.data(), bytes.size());
+}
+
+/**
+ * FUNCTION NAME: putBytes
+ *
+ * DESCRIPTION: Writes the size bytes at bytes at out, prefixed with their length
+ *
+ * RETURNS:
+ * the end of the bytes
+ */
+char *Message::putBytes(char *out, const char *bytes, size_t size) {
+	out = putVarint(out, size);
+	memcpy(out, bytes, size);
+	return out + size;
+}
+
+/**
+ * FUNCTION NAME: getVarint
+ *
+ * DESCRIPTION: Reads a varint at data, which is moved past it
+ *
+ * RETURNS:
+ * false if the varint runs past end
+ */
+bool Message::getVarint(const char *&data, const char *end, unsigned long &number) {
+	number = 0;
+	for (int shift = 0; data < end && shift < 64; shift += 7) {
+		unsigned char byte = (unsigned char)*data++;
+		number |= (unsigned long)(byte & 0x7f) << shift;
+		if (byte < 0x80)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: getBytes
+ *
+ * DESCRIPTION: Copies the length prefixed bytes at data into bytes and moves data past them
+ *
+ * RETURNS:
+ * false if they run past end
+ */
+bool Message::getBytes(const char *&data, const char *end, string &bytes) {
+	unsigned long len;
+	if (!getVarint(data, end, len) || len > (unsigned long)(end - data))
+		return false;
+	bytes.assign(data, len);
+	data += len;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: getBytes
+ *
+ * DESCRIPTION: Points bytes at the length prefixed bytes at data, without copying them,
+ * 				and moves data past them
+ *
+ * RETURNS:
+ * false if they run past end
+ */
+bool Message::getBytes(const char *&data, const char *end, const char *&bytes, size_t &size) {
+	unsigned long len;
+	if (!getVarint(data, end, len) || len > (unsigned long)(end - data))
+		return false;
+	bytes = data;
+	size = len;
+	data += len;
+	return true;
 }
 
 /**
@@ -60,39 +298,43 @@ Message::Message(string message){
  */
 // construct a create or update message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica){
-	this->delimiter = "::";
+	valid = true;
+	timestamp = -1;
+	flags = 0;
+	expires = 0;
+	lease = 0;
+	stream = 0;
+	offset = 0;
+	length = 0;
+	valueData = NULL;
+	valueSize = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
-	key = _key;
-	value = _value;
+	key = std::move(_key);
+	value = std::move(_value);
 	replica = _replica;
 }
 
-/**
- * Constructor
- */
-Message::Message(const Message& anotherMessage) {
-	this->delimiter = anotherMessage.delimiter;
-	this->fromAddr = anotherMessage.fromAddr;
-	this->key = anotherMessage.key;
-	this->replica = anotherMessage.replica;
-	this->success = anotherMessage.success;
-	this->transID = anotherMessage.transID;
-	this->type = anotherMessage.type;
-	this->value = anotherMessage.value;
-}
-
 /**
  * Constructor
  */
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value){
-	this->delimiter = "::";
+	valid = true;
+	timestamp = -1;
+	flags = 0;
+	expires = 0;
+	lease = 0;
+	stream = 0;
+	offset = 0;
+	length = 0;
+	valueData = NULL;
+	valueSize = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
-	key = _key;
-	value = _value;
+	key = std::move(_key);
+	value = std::move(_value);
 }
 
 /**
@@ -100,11 +342,20 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
  */
 // construct a read or delete message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key){
-	this->delimiter = "::";
+	valid = true;
+	timestamp = -1;
+	flags = 0;
+	expires = 0;
+	lease = 0;
+	stream = 0;
+	offset = 0;
+	length = 0;
+	valueData = NULL;
+	valueSize = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
-	key = _key;
+	key = std::move(_key);
 }
 
 /**
@@ -112,7 +363,16 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
  */
 // construct reply message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _success){
-	this->delimiter = "::";
+	valid = true;
+	timestamp = -1;
+	flags = 0;
+	expires = 0;
+	lease = 0;
+	stream = 0;
+	offset = 0;
+	length = 0;
+	valueData = NULL;
+	valueSize = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -123,54 +383,141 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _succe
  * Constructor
  */
 // construct read reply message
-Message::Message(int _transID, Address _fromAddr, string _value){
-	this->delimiter = "::";
+Message::Message(int _transID, Address _fromAddr, string _value, int _timestamp, unsigned char _flags){
+	valid = true;
+	timestamp = _timestamp;
+	flags = _flags;
+	expires = 0;
+	lease = 0;
+	stream = 0;
+	offset = 0;
+	length = 0;
+	valueData = NULL;
+	valueSize = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = READREPLY;
-	value = _value;
+	value = std::move(_value);
+}
+
+/**
+ * Constructor
+ */
+// construct chunk message
+Message::Message(Address _fromAddr, int _stream, size_t _offset, size_t _length, string _bytes){
+	valid = true;
+	timestamp = -1;
+	flags = 0;
+	expires = 0;
+	lease = 0;
+	transID = 0;
+	fromAddr = _fromAddr;
+	valueData = NULL;
+	valueSize = 0;
+	type = CHUNK;
+	stream = _stream;
+	offset = _offset;
+	length = _length;
+	value = std::move(_bytes);
 }
 
 /**
  * FUNCTION NAME: toString
  *
- * DESCRIPTION: Serialized Message in string format
+ * DESCRIPTION: Serialized Message in the binary wire format
  */
 string Message::toString(){
-	string message = to_string(transID) + delimiter + fromAddr.getAddress() + delimiter + to_string(type) + delimiter;
+	string message(wireSize(), '\0');
+	serialize(&message[0]);
+	return message;
+}
+
+/**
+ * FUNCTION NAME: wireSize
+ *
+ * DESCRIPTION: Bytes of the serialized Message
+ */
+size_t Message::wireSize(){
+	size_t size = MESSAGE_HEADER_SIZE + varintSize((unsigned int)transID);
 	switch(type){
 		case CREATE:
 		case UPDATE:
-			message += key + delimiter + value + delimiter + to_string(replica);
+			size += 2 + varintSize(((unsigned int)timestamp << 1) ^ (unsigned int)(timestamp >> 31));
+			size += varintSize((unsigned int)expires) + varintSize((unsigned int)stream);
+			size += varintSize(key.size()) + key.size() + varintSize(getValueSize()) + getValueSize();
 			break;
 		case READ:
+			size += varintSize((unsigned int)lease);
+			// fall through
 		case DELETE:
-			message += key;
+		case INVALIDATE:
+			size += varintSize(key.size()) + key.size();
 			break;
 		case REPLY:
-			if (success)
-				message += "1";
-			else
-				message += "0";
+			size += 1;
 			break;
 		case READREPLY:
-			message += value;
+			size += 1 + varintSize(((unsigned int)timestamp << 1) ^ (unsigned int)(timestamp >> 31));
+			size += varintSize((unsigned int)lease) + varintSize((unsigned int)stream);
+			size += varintSize(getValueSize()) + getValueSize();
+			break;
+		case CHUNK:
+			size += varintSize((unsigned int)stream) + varintSize(offset) + varintSize(length);
+			size += varintSize(value.size()) + value.size();
 			break;
 	}
-	return message;
+	return size;
 }
 
 /**
- * Assignment operator overloading
+ * FUNCTION NAME: serialize
+ *
+ * DESCRIPTION: Writes the Message in the binary wire format at out, which has room for
+ * 				wireSize() bytes. Key and value are copied once, straight into out.
+ *
+ * RETURNS:
+ * the end of the serialized Message
  */
-Message& Message::operator =(const Message& anotherMessage) {
-	this->delimiter = anotherMessage.delimiter;
-	this->fromAddr = anotherMessage.fromAddr;
-	this->key = anotherMessage.key;
-	this->replica = anotherMessage.replica;
-	this->success = anotherMessage.success;
-	this->transID = anotherMessage.transID;
-	this->type = anotherMessage.type;
-	this->value = anotherMessage.value;
-	return *this;
+char *Message::serialize(char *out){
+	*out++ = (char)MESSAGE_WIRE_VERSION;
+	*out++ = (char)type;
+	memcpy(out, fromAddr.addr, sizeof(fromAddr.addr));
+	out += sizeof(fromAddr.addr);
+	out = putVarint(out, (unsigned int)transID);
+	switch(type){
+		case CREATE:
+		case UPDATE:
+			*out++ = (char)replica;
+			*out++ = (char)flags;
+			out = putVarint(out, ((unsigned int)timestamp << 1) ^ (unsigned int)(timestamp >> 31));
+			out = putVarint(out, (unsigned int)expires);
+			out = putVarint(out, (unsigned int)stream);
+			out = putBytes(out, key);
+			out = putBytes(out, getValueData(), getValueSize());
+			break;
+		case READ:
+			out = putVarint(out, (unsigned int)lease);
+			// fall through
+		case DELETE:
+		case INVALIDATE:
+			out = putBytes(out, key);
+			break;
+		case REPLY:
+			*out++ = (char)(success ? 1 : 0);
+			break;
+		case READREPLY:
+			*out++ = (char)flags;
+			out = putVarint(out, ((unsigned int)timestamp << 1) ^ (unsigned int)(timestamp >> 31));
+			out = putVarint(out, (unsigned int)lease);
+			out = putVarint(out, (unsigned int)stream);
+			out = putBytes(out, getValueData(), getValueSize());
+			break;
+		case CHUNK:
+			out = putVarint(out, (unsigned int)stream);
+			out = putVarint(out, offset);
+			out = putVarint(out, length);
+			out = putBytes(out, value);
+			break;
+	}
+	return out;
 }
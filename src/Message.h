@@ -10,10 +10,21 @@
 #include "Member.h"
 #include "common.h"
 
+/*
+ * Macros
+ */
+// version byte that starts every serialized message
+#define MESSAGE_WIRE_VERSION 1
+// version byte (1), type (1), address (6)
+#define MESSAGE_HEADER_SIZE 8
+
 /**
  * CLASS NAME: Message
  *
- * DESCRIPTION: This class is used for message passing among nodes
+ * DESCRIPTION: This class is used for message passing among nodes. On the wire a message
+ * 				is a version byte, the type byte and the raw sender address, followed by
+ * 				the fields of its type: integers as varints, key and value prefixed with
+ * 				their length, so they may hold any bytes.
  */
 class Message{
 public:
@@ -21,26 +32,66 @@ public:
 	ReplicaType replica;
 	string key;
 	string value;
+	// CREATE and UPDATE received: the value bytes inside the received buffer, which are
+	// not copied into value; NULL when value holds the value
+	const char *valueData;
+	size_t valueSize;
 	Address fromAddr;
 	int transID;
 	bool success; // success or not 
-	// delimiter
-	string delimiter;
-	// construct a message from a string
-	Message(string message);
-	Message(const Message& anotherMessage);
+	// CREATE: timestamp and flags of a record being re-replicated, -1 to stamp on arrival
+	// READREPLY: timestamp and flags of the record read, a tombstone included
+	int timestamp;
+	unsigned char flags;
+	// CREATE and UPDATE: globaltime at which the record expires, 0 if it never does
+	int expires;
+	// READ: 1 to ask the primary replica for a read lease
+	// READREPLY: globaltime at which the granted lease ends, 0 if none was granted
+	int lease;
+	// CREATE, UPDATE and READREPLY: stream that carries the value, 0 if it is inline
+	// CHUNK: stream the bytes in value belong to, at offset of the length byte value;
+	// transID is the one of the message the stream carries the value of
+	int stream;
+	size_t offset;
+	size_t length;
+	// false if a received buffer was not a complete message of a known version
+	bool valid;
+	Message();
+	// construct a message from a string, or in place from a received buffer, which a
+	// CREATE or UPDATE keeps viewing its value in
+	Message(const string &message);
+	Message(const char *data, size_t size);
 	// construct a create or update message
 	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value);
 	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica);
-	// construct a read or delete message
+	// construct a read, delete or invalidate message
 	Message(int _transID, Address _fromAddr, MessageType _type, string _key);
 	// construct reply message
 	Message(int _transID, Address _fromAddr, MessageType _type, bool _success);
 	// construct read reply message
-	Message(int _transID, Address _fromAddr, string _value);
-	Message& operator = (const Message& anotherMessage);
-	// serialize to a string
+	Message(int _transID, Address _fromAddr, string _value, int _timestamp, unsigned char _flags);
+	// construct chunk message
+	Message(Address _fromAddr, int _stream, size_t _offset, size_t _length, string _bytes);
+	// the value bytes, wherever they are held, and a view of bytes owned by the caller
+	const char *getValueData();
+	size_t getValueSize();
+	string takeValue();
+	void viewValue(const char *data, size_t size);
+	// serialize to a string, or into a buffer of wireSize() bytes
 	string toString();
+	size_t wireSize();
+	char *serialize(char *out);
+	// sets the replica type of a serialized create or update message
+	static void setReplica(char *wire, ReplicaType replica);
+
+private:
+	static size_t varintSize(unsigned long number);
+	static char *putVarint(char *out, unsigned long number);
+	static char *putBytes(char *out, const string &bytes);
+	static char *putBytes(char *out, const char *bytes, size_t size);
+	static bool getVarint(const char *&data, const char *end, unsigned long &number);
+	static bool getBytes(const char *&data, const char *end, string &bytes);
+	static bool getBytes(const char *&data, const char *end, const char *&bytes, size_t &size);
 };
 
 #endif
@@ -0,0 +1,423 @@
+/**********************************
+ * FILE NAME: MessageStreamer.cpp
+ *
+ * DESCRIPTION: MessageStreamer class definition
+ **********************************/
+
+#include "MessageStreamer.h"
+
+/**
+ * constructor
+ */
+MessageStreamer::MessageStreamer(Transport *emulNet, Params *par, Address self):
+	emulNet(emulNet), par(par), self(self), lastStream(0), deferredNow(0), chunksSent(0), chunksReceived(0),
+	chunksRejected(0), streamsDropped(0), messagesDeferred(0), messagesDropped(0), deferredPeak(0) {}
+
+/**
+ * FUNCTION NAME: streamKey
+ *
+ * DESCRIPTION: Key of an incoming stream: stream ids are only unique per sender
+ */
+string MessageStreamer::streamKey(Address &from, int stream) {
+	return from.getAddress() + "#" + to_string(stream);
+}
+
+/**
+ * FUNCTION NAME: deferredKey
+ *
+ * DESCRIPTION: Key of the messages held back from node to on lane
+ */
+string MessageStreamer::deferredKey(Address &to, int lane) {
+	return to.getAddress() + "#" + to_string(lane);
+}
+
+/**
+ * FUNCTION NAME: laneOf
+ *
+ * DESCRIPTION: Lane a message goes on: chunks and re-replicated records (CREATE with the
+ * 				timestamp of the record) are bulk, replies are replies, the rest requests
+ */
+int MessageStreamer::laneOf(Message &message) {
+	switch ( message.type ) {
+		case CHUNK:
+			return LANE_BULK;
+		case CREATE:
+			return message.timestamp >= 0 ? LANE_BULK : LANE_REQUEST;
+		case REPLY:
+		case READREPLY:
+			return LANE_REPLY;
+		default:
+			return LANE_REQUEST;
+	}
+}
+
+/**
+ * FUNCTION NAME: fits
+ *
+ * DESCRIPTION: Returns if a serialized message of wireSize bytes passes the transport
+ */
+bool MessageStreamer::fits(size_t wireSize) {
+	return wireSize + sizeof(en_msg) < (size_t)par->MAX_MSG_SIZE;
+}
+
+/**
+ * FUNCTION NAME: mayTransmit
+ *
+ * DESCRIPTION: Returns if a message to node to on lane may go on the network now: the node
+ * 				is not congested on the lane and no older message to it on it is held back
+ */
+bool MessageStreamer::mayTransmit(Address &to, int lane) {
+	return deferred.find(deferredKey(to, lane)) == deferred.end() && !emulNet->ENcongested(&to, lane);
+}
+
+/**
+ * FUNCTION NAME: hold
+ *
+ * DESCRIPTION: Holds a serialized message to node to on lane back until to caught up, or
+ * 				drops it if STREAM_HOLD_LIMIT messages to to on lane are held already
+ */
+void MessageStreamer::hold(Address &to, int lane, string wire) {
+	string key = deferredKey(to, lane);
+	map<string, Deferred>::iterator held = deferred.find(key);
+	if ( held == deferred.end() ) {
+		held = deferred.insert(make_pair(key, Deferred())).first;
+		held->second.to = to;
+		held->second.lane = lane;
+	}
+	if ( held->second.messages.size() >= STREAM_HOLD_LIMIT ) {
+		messagesDropped++;
+		return;
+	}
+	held->second.messages.push_back(make_pair(par->getcurrtime(), std::move(wire)));
+	messagesDeferred++;
+	deferredPeak = max(deferredPeak, ++deferredNow);
+}
+
+/**
+ * FUNCTION NAME: transmit
+ *
+ * DESCRIPTION: Puts a message on the network, or holds it back serialized while its
+ * 				destination is congested or older messages to it are still held back
+ */
+void MessageStreamer::transmit(Address &to, Message &message) {
+	int lane = laneOf(message);
+	if ( !mayTransmit(to, lane) ) {
+		hold(to, lane, message.toString());
+		return;
+	}
+	// serialized straight into the frame to its destination
+	char *buffer = emulNet->ENreserve(&self, &to, message.wireSize(), lane);
+	if ( buffer != NULL ) {
+		message.serialize(buffer);
+		emulNet->ENcommit();
+	}
+}
+
+/**
+ * FUNCTION NAME: transmit
+ *
+ * DESCRIPTION: Puts a serialized message on the network on lane, or holds it back
+ */
+void MessageStreamer::transmit(Address &to, int lane, const char *wire, size_t size) {
+	if ( !mayTransmit(to, lane) ) {
+		hold(to, lane, string(wire, size));
+		return;
+	}
+	char *buffer = emulNet->ENreserve(&self, &to, size, lane);
+	if ( buffer != NULL ) {
+		memcpy(buffer, wire, size);
+		emulNet->ENcommit();
+	}
+}
+
+/**
+ * FUNCTION NAME: flushDeferred
+ *
+ * DESCRIPTION: Drops the messages held back for more than STREAM_HOLD_TIMEOUT ticks and
+ * 				sends the others of every node and lane that is no longer congested
+ */
+void MessageStreamer::flushDeferred() {
+	map<string, Deferred>::iterator held = deferred.begin();
+	while ( held != deferred.end() ) {
+		deque<pair<int, string> > &messages = held->second.messages;
+		// the oldest are in front
+		while ( !messages.empty() && par->getcurrtime() - messages.front().first > STREAM_HOLD_TIMEOUT ) {
+			messages.pop_front();
+			deferredNow--;
+			messagesDropped++;
+		}
+		while ( !messages.empty() && !emulNet->ENcongested(&held->second.to, held->second.lane) ) {
+			emulNet->ENsend(&self, &held->second.to, messages.front().second, held->second.lane);
+			messages.pop_front();
+			deferredNow--;
+		}
+		if ( messages.empty() ) {
+			held = deferred.erase(held);
+		}
+		else {
+			held++;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: send
+ *
+ * DESCRIPTION: Sends message to node to, streaming its value if the message is too large.
+ * 				The value is moved out of message, or copied if message only views it.
+ */
+void MessageStreamer::send(Address *to, Message &message) {
+	// key, value and at most this many bytes of other fields make up the serialized form
+	if ( fits(message.key.size() + message.getValueSize() + 128) ) {
+		transmit(*to, message);
+		return;
+	}
+	OutStream out;
+	out.to = *to;
+	out.value = message.takeValue();
+	out.header = message;
+	out.header.value.clear();
+	out.header.stream = ++lastStream;
+	out.offset = 0;
+	outgoing.push_back(std::move(out));
+}
+
+/**
+ * FUNCTION NAME: multicast
+ *
+ * DESCRIPTION: Sends message to every node of to. With replicas, the i-th node gets
+ * 				replica type replicas[i]; that is the only field that differs, so the
+ * 				message is serialized once and the bytes copied into the frame to each
+ * 				node. A value too large for one message is streamed to each node.
+ */
+void MessageStreamer::multicast(vector<Address> &to, const vector<ReplicaType> &replicas, Message &message) {
+	if ( !fits(message.key.size() + message.getValueSize() + 128) ) {
+		for ( size_t i = 0; i < to.size(); i++ ) {
+			Message copy = message;
+			if ( !replicas.empty() ) {
+				copy.replica = replicas[i];
+			}
+			send(&to[i], copy);
+		}
+		return;
+	}
+	int lane = laneOf(message);
+	wire.resize(message.wireSize());
+	message.serialize(&wire[0]);
+	for ( size_t i = 0; i < to.size(); i++ ) {
+		if ( !replicas.empty() ) {
+			Message::setReplica(&wire[0], replicas[i]);
+		}
+		transmit(to[i], lane, wire.data(), wire.size());
+	}
+}
+
+/**
+ * FUNCTION NAME: pump
+ *
+ * DESCRIPTION: Called once per tick. Sends the held back messages that may go, puts
+ * 				the next window of every outgoing stream on the network, sends the message
+ * 				of the streams that are done and drops incoming streams that stalled (a
+ * 				chunk was lost). A stream to a node congested on the bulk lane pauses.
+ */
+void MessageStreamer::pump() {
+	flushDeferred();
+
+	deque<OutStream>::iterator out = outgoing.begin();
+	while ( out != outgoing.end() ) {
+		for ( int i = 0; i < STREAM_WINDOW && out->offset < out->value.size() && !emulNet->ENcongested(&out->to, LANE_BULK); i++ ) {
+			size_t len = min((size_t)STREAM_CHUNK_SIZE, out->value.size() - out->offset);
+			Message chunk(self, out->header.stream, out->offset, out->value.size(), out->value.substr(out->offset, len));
+			chunk.transID = out->header.transID;
+			char *buffer = emulNet->ENreserve(&self, &out->to, chunk.wireSize(), LANE_BULK);
+			if ( buffer != NULL ) {
+				chunk.serialize(buffer);
+				emulNet->ENcommit();
+			}
+			out->offset += len;
+			chunksSent++;
+		}
+		if ( out->offset < out->value.size() ) {
+			out++;
+			continue;
+		}
+		transmit(out->to, out->header);
+		out = outgoing.erase(out);
+	}
+
+	map<string, InStream>::iterator in = incoming.begin();
+	while ( in != incoming.end() ) {
+		if ( par->getcurrtime() - in->second.lastActivity > STREAM_TIMEOUT ) {
+			in = incoming.erase(in);
+			streamsDropped++;
+		}
+		else {
+			in++;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: receive
+ *
+ * DESCRIPTION: Takes in a received message. A chunk is copied into its stream; a message
+ * 				whose value is streamed gets the value once all of it arrived. A chunk
+ * 				whose length or place does not fit its stream, or that announces a value
+ * 				over STREAM_MAX_VALUE bytes, is dropped before anything is sized or copied.
+ *
+ * RETURNS:
+ * true if message (possibly replaced by the message a chunk completed) is ready to handle
+ * false if it was kept by the streamer
+ */
+bool MessageStreamer::receive(Message &message) {
+	if ( message.type != CHUNK && message.stream == 0 ) {
+		return true;
+	}
+	string key = streamKey(message.fromAddr, message.stream);
+	if ( message.type == CHUNK && (message.length == 0 || message.length > STREAM_MAX_VALUE
+			|| message.offset > message.length || message.value.size() > message.length - message.offset) ) {
+		chunksRejected++;
+		return false;
+	}
+	InStream &in = incoming[key];
+	in.lastActivity = par->getcurrtime();
+	if ( message.type == CHUNK ) {
+		if ( in.value.empty() ) {
+			in.value.resize(message.length);
+			in.received = 0;
+		}
+		else if ( in.value.size() != message.length ) {
+			chunksRejected++;
+			return false;
+		}
+		memcpy(&in.value[message.offset], message.value.data(), message.value.size());
+		in.received += message.value.size();
+		chunksReceived++;
+		if ( in.received < in.value.size() || !in.headerArrived ) {
+			return false;
+		}
+		message = std::move(in.header);
+	}
+	else if ( in.value.empty() || in.received < in.value.size() ) {
+		// the message overtook some of its chunks
+		in.header = std::move(message);
+		in.headerArrived = true;
+		return false;
+	}
+	// the streamed value replaces the empty one the message carried inline
+	message.valueData = NULL;
+	message.value = std::move(in.value);
+	message.stream = 0;
+	incoming.erase(key);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: forget
+ *
+ * DESCRIPTION: Node failed: drops the messages held back for it, the streams to it and
+ * 				the incomplete streams from it
+ */
+void MessageStreamer::forget(Address &node) {
+	for ( int lane = 0; lane < EN_LANES; lane++ ) {
+		map<string, Deferred>::iterator held = deferred.find(deferredKey(node, lane));
+		if ( held != deferred.end() ) {
+			deferredNow -= held->second.messages.size();
+			messagesDropped += held->second.messages.size();
+			deferred.erase(held);
+		}
+	}
+
+	deque<OutStream>::iterator out = outgoing.begin();
+	while ( out != outgoing.end() ) {
+		if ( out->to == node ) {
+			out = outgoing.erase(out);
+			streamsDropped++;
+		}
+		else {
+			out++;
+		}
+	}
+
+	// incoming streams are keyed by the sender's address first
+	string prefix = node.getAddress() + "#";
+	map<string, InStream>::iterator in = incoming.lower_bound(prefix);
+	while ( in != incoming.end() && in->first.compare(0, prefix.size(), prefix) == 0 ) {
+		in = incoming.erase(in);
+		streamsDropped++;
+	}
+}
+
+/**
+ * FUNCTION NAME: ticksToSend
+ *
+ * DESCRIPTION: Ticks streaming a value of valueSize bytes takes, 0 if it is sent inline
+ */
+size_t MessageStreamer::ticksToSend(size_t valueSize) {
+	size_t chunks = (valueSize + STREAM_CHUNK_SIZE - 1) / STREAM_CHUNK_SIZE;
+	return fits(valueSize + 128) ? 0 : chunks / STREAM_WINDOW + 1;
+}
+
+/**
+ * FUNCTION NAME: getChunksSent
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long MessageStreamer::getChunksSent() {
+	return chunksSent;
+}
+
+/**
+ * FUNCTION NAME: getChunksReceived
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long MessageStreamer::getChunksReceived() {
+	return chunksReceived;
+}
+
+/**
+ * FUNCTION NAME: getChunksRejected
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long MessageStreamer::getChunksRejected() {
+	return chunksRejected;
+}
+
+/**
+ * FUNCTION NAME: getStreamsDropped
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long MessageStreamer::getStreamsDropped() {
+	return streamsDropped;
+}
+
+/**
+ * FUNCTION NAME: getMessagesDeferred
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long MessageStreamer::getMessagesDeferred() {
+	return messagesDeferred;
+}
+
+/**
+ * FUNCTION NAME: getMessagesDropped
+ *
+ * DESCRIPTION: Messages held back that were dropped: over STREAM_HOLD_LIMIT, held for too
+ * 				long or to a node that failed
+ */
+unsigned long MessageStreamer::getMessagesDropped() {
+	return messagesDropped;
+}
+
+/**
+ * FUNCTION NAME: getDeferredPeak
+ *
+ * DESCRIPTION: Most messages held back at the same time
+ */
+size_t MessageStreamer::getDeferredPeak() {
+	return deferredPeak;
+}
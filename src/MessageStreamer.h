@@ -0,0 +1,140 @@
+/**********************************
+ * FILE NAME: MessageStreamer.h
+ *
+ * DESCRIPTION: Header file of MessageStreamer class
+ **********************************/
+
+#ifndef MESSAGESTREAMER_H_
+#define MESSAGESTREAMER_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include <deque>
+#include "Transport.h"
+#include "Message.h"
+
+/*
+ * Macros
+ */
+// value bytes carried by one CHUNK, well below Params::MAX_MSG_SIZE
+#define STREAM_CHUNK_SIZE 2048
+// chunks every outgoing stream may put on the network per tick
+#define STREAM_WINDOW 16
+// ticks an incomplete incoming stream is kept without receiving anything
+#define STREAM_TIMEOUT 20
+// largest value a stream may announce; chunks of a longer one are dropped
+#define STREAM_MAX_VALUE (64 * 1024 * 1024)
+// messages held back from one node on one lane, past which further ones are dropped
+#define STREAM_HOLD_LIMIT 4096
+// ticks a message is held back before it is dropped
+#define STREAM_HOLD_TIMEOUT 20
+
+/**
+ * STRUCT NAME: OutStream
+ *
+ * DESCRIPTION: Value being streamed to one node, followed by its message
+ */
+typedef struct OutStream {
+	Address to;
+	Message header;
+	string value;
+	size_t offset;
+} OutStream;
+
+/**
+ * STRUCT NAME: InStream
+ *
+ * DESCRIPTION: Value being reassembled from the chunks of one stream. The message it
+ * 				belongs to may arrive before the last chunk and waits here.
+ */
+typedef struct InStream {
+	string value;
+	size_t received;
+	bool headerArrived;
+	Message header;
+	int lastActivity;
+} InStream;
+
+/**
+ * STRUCT NAME: Deferred
+ *
+ * DESCRIPTION: Serialized messages held back from one congested node on one lane, in send
+ * 				order, with the tick each was held back at
+ */
+typedef struct Deferred {
+	Address to;
+	int lane;
+	deque<pair<int, string> > messages;
+} Deferred;
+
+/**
+ * CLASS NAME: MessageStreamer
+ *
+ * DESCRIPTION: Sends messages of any size over a Transport, which drops anything larger than
+ * 				Params::MAX_MSG_SIZE. A message whose value does not fit is sent as
+ * 				CHUNK messages carrying the value, followed by the message itself with an
+ * 				empty value and the stream id. Chunks carry their offset, so the receiver
+ * 				copies each straight into the one buffer of the value whatever order they
+ * 				arrive in, and the transID of their message, so the receiver can tell
+ * 				which transaction a stream still in flight belongs to. Every stream puts
+ * 				at most STREAM_WINDOW chunks per tick on the network; the rest wait in
+ * 				the send queue. Messages go on the lane of their
+ * 				type: requests, replies, and bulk for chunks and re-replicated records.
+ * 				Messages to a node the transport reports as congested on their lane are
+ * 				held back and sent, in order, once it caught up. At most STREAM_HOLD_LIMIT
+ * 				are held per node and lane, each for STREAM_HOLD_TIMEOUT ticks, and
+ * 				forget drops everything for a node that failed. A message multicast to
+ * 				several nodes is serialized once and copied to each.
+ */
+class MessageStreamer {
+private:
+	Transport *emulNet;
+	Params *par;
+	Address self;
+	int lastStream;
+	deque<OutStream> outgoing;
+	// incoming streams by sender address and stream id
+	map<string, InStream> incoming;
+	// messages held back by destination address and lane
+	map<string, Deferred> deferred;
+	// serialized message being multicast, kept for its capacity
+	string wire;
+	size_t deferredNow;
+	unsigned long chunksSent;
+	unsigned long chunksReceived;
+	unsigned long chunksRejected;
+	unsigned long streamsDropped;
+	unsigned long messagesDeferred;
+	unsigned long messagesDropped;
+	size_t deferredPeak;
+
+	static string streamKey(Address &from, int stream);
+	static string deferredKey(Address &to, int lane);
+	static int laneOf(Message &message);
+	bool fits(size_t wireSize);
+	bool mayTransmit(Address &to, int lane);
+	void hold(Address &to, int lane, string wire);
+	void transmit(Address &to, Message &message);
+	void transmit(Address &to, int lane, const char *wire, size_t size);
+	void flushDeferred();
+
+public:
+	MessageStreamer(Transport *emulNet, Params *par, Address self);
+	void send(Address *to, Message &message);
+	void multicast(vector<Address> &to, const vector<ReplicaType> &replicas, Message &message);
+	void pump();
+	bool receive(Message &message);
+	void forget(Address &node);
+	size_t ticksToSend(size_t valueSize);
+	unsigned long getChunksSent();
+	unsigned long getChunksReceived();
+	unsigned long getChunksRejected();
+	unsigned long getStreamsDropped();
+	unsigned long getMessagesDeferred();
+	unsigned long getMessagesDropped();
+	size_t getDeferredPeak();
+};
+
+#endif /* MESSAGESTREAMER_H_ */
@@ -9,7 +9,21 @@
 /**
  * Constructor
  */
-Params::Params(): PORTNUM(8001) {}
+Params::Params(): PORTNUM(8001) {
+	STORE_DIR[0] = '\0';
+	SNAPSHOT_DIR[0] = '\0';
+	MEMORY_BUDGET = 0;
+	READ_CACHE = 0;
+	NET_HIGH_WATERMARK = 4096;
+	NET_LOW_WATERMARK = -1;
+	NET_INBOX_LIMIT = 30000;
+	strcpy(TRANSPORT, "emulnet");
+	NET_DEFAULT_LINK.src = -1;
+	NET_DEFAULT_LINK.dst = -1;
+	NET_DEFAULT_LINK.latency = 0;
+	NET_DEFAULT_LINK.jitter = 0;
+	NET_DEFAULT_LINK.bandwidth = 0;
+}
 
 /**
  * FUNCTION NAME: setparams
@@ -40,6 +54,55 @@ void Params::setparams(char *config_file) {
 		this->CRUDTEST = DELETE_TEST;
 	}
 
+	// Optional "NAME: value" settings may follow in any order
+	char name[64];
+	char value[256];
+	while ( fscanf(fp, " %63[^:]: %255s", name, value) == 2 ) {
+		if ( 0 == strcmp(name, "STORE_DIR") ) {
+			strcpy(STORE_DIR, value);
+		}
+		else if ( 0 == strcmp(name, "SNAPSHOT_DIR") ) {
+			strcpy(SNAPSHOT_DIR, value);
+		}
+		else if ( 0 == strcmp(name, "MEMORY_BUDGET") ) {
+			MEMORY_BUDGET = strtoul(value, NULL, 10);
+		}
+		else if ( 0 == strcmp(name, "READ_CACHE") ) {
+			READ_CACHE = strtoul(value, NULL, 10);
+		}
+		else if ( 0 == strcmp(name, "NET_HIGH_WATERMARK") ) {
+			NET_HIGH_WATERMARK = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "NET_LOW_WATERMARK") ) {
+			NET_LOW_WATERMARK = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "NET_INBOX_LIMIT") ) {
+			NET_INBOX_LIMIT = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "NET_LATENCY") ) {
+			NET_DEFAULT_LINK.latency = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "NET_JITTER") ) {
+			NET_DEFAULT_LINK.jitter = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "NET_BANDWIDTH") ) {
+			NET_DEFAULT_LINK.bandwidth = strtoul(value, NULL, 10);
+		}
+		else if ( 0 == strcmp(name, "NET_LINK") ) {
+			// <src>,<dst>,<latency>,<jitter>,<bandwidth>, * for any node
+			LinkModel link = NET_DEFAULT_LINK;
+			char src[16], dst[16];
+			if ( sscanf(value, "%15[^,],%15[^,],%d,%d,%lu", src, dst, &link.latency, &link.jitter, &link.bandwidth) == 5 ) {
+				link.src = strcmp(src, "*") ? atoi(src) : -1;
+				link.dst = strcmp(dst, "*") ? atoi(dst) : -1;
+				NET_LINKS.push_back(link);
+			}
+		}
+		else if ( 0 == strcmp(name, "TRANSPORT") ) {
+			strncpy(TRANSPORT, value, sizeof(TRANSPORT) - 1);
+		}
+	}
+
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
 	EN_GPSZ = MAX_NNB;
@@ -65,3 +128,32 @@ void Params::setparams(char *config_file) {
 int Params::getcurrtime(){
     return globaltime;
 }
+
+/**
+ * FUNCTION NAME: linkModel
+ *
+ * DESCRIPTION: Delay of the link from node src to node dst
+ */
+LinkModel Params::linkModel(int src, int dst) {
+	LinkModel link = NET_DEFAULT_LINK;
+	for ( size_t i = 0; i < NET_LINKS.size(); i++ ) {
+		if ( (NET_LINKS[i].src == -1 || NET_LINKS[i].src == src) && (NET_LINKS[i].dst == -1 || NET_LINKS[i].dst == dst) ) {
+			link = NET_LINKS[i];
+		}
+	}
+	return link;
+}
+
+/**
+ * FUNCTION NAME: lowWatermark
+ *
+ * DESCRIPTION: Messages queued to a held back node below which its senders may go on:
+ * 				NET_LOW_WATERMARK, or half of NET_HIGH_WATERMARK if it is unset or not
+ * 				below the high watermark
+ */
+int Params::lowWatermark() {
+	if ( NET_LOW_WATERMARK < 0 || NET_LOW_WATERMARK >= NET_HIGH_WATERMARK ) {
+		return NET_HIGH_WATERMARK / 2;
+	}
+	return NET_LOW_WATERMARK;
+}
@@ -13,6 +13,21 @@
 
 enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
 
+/**
+ * STRUCT NAME: LinkModel
+ *
+ * DESCRIPTION: Delay of the link from node src to node dst: latency ticks plus up to jitter
+ * 				more, and bandwidth bytes per tick (0 for no limit). A src or dst of -1
+ * 				stands for any node.
+ */
+typedef struct LinkModel {
+	int src;
+	int dst;
+	int latency;
+	int jitter;
+	unsigned long bandwidth;
+} LinkModel;
+
 /**
  * CLASS NAME: Params
  *
@@ -32,9 +47,21 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	char STORE_DIR[256];		// directory of the durable node stores, empty to run in memory
+	char SNAPSHOT_DIR[256];		// directory of the node restart snapshots, empty to disable
+	unsigned long MEMORY_BUDGET;	// bytes every node may store before evicting keys, 0 for no limit
+	unsigned long READ_CACHE;		// bytes of the coordinator read cache of every node, 0 to disable
+	int NET_HIGH_WATERMARK;		// messages queued to one node at which its senders are asked to hold back
+	int NET_LOW_WATERMARK;		// messages queued to a held back node below which its senders go on, -1 for half the high one
+	int NET_INBOX_LIMIT;		// messages queued to one node on one lane past which EmulNet drops what is sent to it
+	LinkModel NET_DEFAULT_LINK;	// delay of every link without a NET_LINK setting
+	vector<LinkModel> NET_LINKS;	// NET_LINK settings, the last one matching a link applies
+	char TRANSPORT[16];			// network of the nodes: "emulnet", "udp" for loopback sockets or "shm" for shared memory
 	Params();
 	void setparams(char *);
 	int getcurrtime();
+	LinkModel linkModel(int src, int dst);
+	int lowWatermark();
 };
 
 #endif /* _PARAMS_H_ */
@@ -0,0 +1,474 @@
+/**********************************
+ * FILE NAME: RangeTable.cpp
+ *
+ * DESCRIPTION: RangeTable class definition
+ **********************************/
+
+#include "RangeTable.h"
+
+/**
+ * constructor
+ */
+RangeTable::RangeTable(): arena(new Arena()), size(0) {
+	for ( int i = 0; i < RING_SIZE; i++ ) {
+		ranges[i] = NULL;
+		filters[i] = NULL;
+		filterNegatives[i] = 0;
+		filterFalsePositives[i] = 0;
+		filterHits[i] = 0;
+	}
+}
+
+/**
+ * Destructor
+ */
+RangeTable::~RangeTable() {
+	clear();
+	delete arena;
+}
+
+/**
+ * FUNCTION NAME: keyHash
+ *
+ * DESCRIPTION: Hash of a key that both picks its ring position and feeds its range's filter,
+ * 				computed on the key bytes in place
+ */
+size_t RangeTable::keyHash(const char *key, size_t keyLen) {
+	return FlatTable::hashBytes(key, keyLen, RT_HASH_SEED);
+}
+
+/**
+ * FUNCTION NAME: token
+ *
+ * DESCRIPTION: Ring position of a key. Must agree with MP2Node::hashFunction.
+ */
+size_t RangeTable::token(const char *key, size_t keyLen) {
+	return keyHash(key, keyLen) % RING_SIZE;
+}
+
+/**
+ * FUNCTION NAME: rangeFor
+ *
+ * DESCRIPTION: Table of a token, created on first use
+ */
+FlatTable *RangeTable::rangeFor(size_t token) {
+	if ( ranges[token] == NULL ) {
+		ranges[token] = new FlatTable(arena);
+		filters[token] = new BloomFilter(BLOOM_MIN_KEYS);
+	}
+	return ranges[token];
+}
+
+/**
+ * FUNCTION NAME: screen
+ *
+ * DESCRIPTION: Finds the range of a key and asks its filter first. Only the lookups a
+ * 				filter answers count as negatives, not those of empty ranges.
+ *
+ * RETURNS:
+ * the range to probe, or NULL if the key is certainly absent
+ */
+FlatTable *RangeTable::screen(const char *key, size_t keyLen, size_t &hash) const {
+	hash = keyHash(key, keyLen);
+	size_t token = hash % RING_SIZE;
+	if ( ranges[token] == NULL ) {
+		// nothing to screen, not a filter outcome
+		return NULL;
+	}
+	if ( !filters[token]->mayContain(hash) ) {
+		filterNegatives[token]++;
+		return NULL;
+	}
+	return ranges[token];
+}
+
+/**
+ * FUNCTION NAME: recordLookup
+ *
+ * DESCRIPTION: Counts the outcome of a lookup the filter let through
+ */
+void RangeTable::recordLookup(size_t token, bool found) const {
+	if ( found ) {
+		filterHits[token]++;
+	}
+	else {
+		filterFalsePositives[token]++;
+	}
+}
+
+/**
+ * FUNCTION NAME: added
+ *
+ * DESCRIPTION: Adds a new key to its range's filter, growing the filter once it holds
+ * 				more keys than it was sized for
+ */
+void RangeTable::added(size_t token, size_t hash) {
+	size++;
+	filters[token]->add(hash);
+	if ( filters[token]->isOverloaded() ) {
+		rebuildFilter(token);
+	}
+}
+
+/**
+ * FUNCTION NAME: rebuildFilter
+ *
+ * DESCRIPTION: Replaces the filter of a range by one sized for twice its keys
+ */
+void RangeTable::rebuildFilter(size_t token) {
+	BloomFilter *filter = new BloomFilter(ranges[token]->getSize() * 2);
+	for ( FlatTable::iterator it = ranges[token]->begin(); it != ranges[token]->end(); ++it ) {
+		filter->add(keyHash(it.keyData(), it.keyLength()));
+	}
+	delete filters[token];
+	filters[token] = filter;
+}
+
+/**
+ * FUNCTION NAME: emplace
+ *
+ * DESCRIPTION: Inserts key with an uninitialized value buffer of valueLen bytes
+ * 				unless the key is already present
+ *
+ * RETURNS:
+ * value buffer if inserted
+ * NULL if the key already existed
+ */
+char *RangeTable::emplace(const char *key, size_t keyLen, size_t valueLen) {
+	size_t hash = keyHash(key, keyLen);
+	size_t token = hash % RING_SIZE;
+	char *buffer = rangeFor(token)->emplace(key, keyLen, valueLen);
+	if ( buffer != NULL ) {
+		added(token, hash);
+	}
+	return buffer;
+}
+
+/**
+ * FUNCTION NAME: assign
+ *
+ * DESCRIPTION: Resizes the value buffer of an existing key to valueLen bytes
+ *
+ * RETURNS:
+ * value buffer if the key was found
+ * NULL otherwise
+ */
+char *RangeTable::assign(const char *key, size_t keyLen, size_t valueLen) {
+	size_t hash;
+	FlatTable *range = screen(key, keyLen, hash);
+	if ( range == NULL ) {
+		return NULL;
+	}
+	char *buffer = range->assign(key, keyLen, valueLen);
+	recordLookup(hash % RING_SIZE, buffer != NULL);
+	return buffer;
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Looks up key without copying its value
+ *
+ * RETURNS:
+ * pointer to the value bytes if found
+ * NULL otherwise
+ */
+const char *RangeTable::lookup(const char *key, size_t keyLen, size_t &valueLen) {
+	size_t hash;
+	FlatTable *range = screen(key, keyLen, hash);
+	if ( range == NULL ) {
+		return NULL;
+	}
+	const char *value = range->lookup(key, keyLen, valueLen);
+	recordLookup(hash % RING_SIZE, value != NULL);
+	return value;
+}
+
+/**
+ * FUNCTION NAME: emplace
+ *
+ * DESCRIPTION: Inserts (key, value) unless the key is already present
+ *
+ * RETURNS:
+ * true if inserted
+ * false if the key already existed
+ */
+bool RangeTable::emplace(const string &key, const string &value) {
+	char *buffer = emplace(key.data(), key.size(), value.size());
+	if ( buffer == NULL ) {
+		return false;
+	}
+	memcpy(buffer, value.data(), value.size());
+	return true;
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Looks up key and copies its value out
+ *
+ * RETURNS:
+ * true if found
+ * false otherwise
+ */
+bool RangeTable::find(const string &key, string &value) {
+	size_t valueLen;
+	const char *data = lookup(key.data(), key.size(), valueLen);
+	if ( data == NULL ) {
+		return false;
+	}
+	value.assign(data, valueLen);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: assign
+ *
+ * DESCRIPTION: Replaces the value of an existing key
+ *
+ * RETURNS:
+ * true if the key was found
+ * false otherwise
+ */
+bool RangeTable::assign(const string &key, const string &value) {
+	char *buffer = assign(key.data(), key.size(), value.size());
+	if ( buffer == NULL ) {
+		return false;
+	}
+	memcpy(buffer, value.data(), value.size());
+	return true;
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * DESCRIPTION: Removes key from its range
+ *
+ * RETURNS:
+ * number of removed entries (0 or 1)
+ */
+size_t RangeTable::erase(const string &key) {
+	size_t hash;
+	FlatTable *range = screen(key.data(), key.size(), hash);
+	if ( range == NULL ) {
+		return 0;
+	}
+	bool found = range->erase(key) > 0;
+	recordLookup(hash % RING_SIZE, found);
+	if ( !found ) {
+		return 0;
+	}
+	filters[hash % RING_SIZE]->remove(hash);
+	size--;
+	return 1;
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: Returns 1 if key is present, 0 otherwise
+ */
+size_t RangeTable::count(const string &key) const {
+	size_t hash;
+	FlatTable *range = screen(key.data(), key.size(), hash);
+	if ( range == NULL ) {
+		return 0;
+	}
+	size_t found = range->count(key);
+	recordLookup(hash % RING_SIZE, found > 0);
+	return found;
+}
+
+/**
+ * FUNCTION NAME: empty
+ *
+ * DESCRIPTION: Returns if no range holds an entry
+ */
+bool RangeTable::empty() const {
+	return size == 0;
+}
+
+/**
+ * FUNCTION NAME: getSize
+ *
+ * DESCRIPTION: Returns the number of entries over all ranges
+ */
+size_t RangeTable::getSize() const {
+	return size;
+}
+
+/**
+ * FUNCTION NAME: getMemoryUsage
+ *
+ * DESCRIPTION: Bytes allocated for the stored entries: the arena blocks of keys and values
+ * 				and, for every range, its table (free slots included) and filter
+ */
+size_t RangeTable::getMemoryUsage() const {
+	size_t bytes = arena->getBytesAllocated();
+	for ( int i = 0; i < RING_SIZE; i++ ) {
+		if ( ranges[i] != NULL ) {
+			bytes += ranges[i]->getFootprint();
+		}
+		if ( filters[i] != NULL ) {
+			bytes += filters[i]->getFootprint();
+		}
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: entryBytes
+ *
+ * DESCRIPTION: Arena bytes an entry takes and gives back when erased: its value block and,
+ * 				unless the key is stored inline, its key block. The table and filter of its
+ * 				range keep their size.
+ */
+size_t RangeTable::entryBytes(size_t keyLen, size_t valueLen) {
+	size_t bytes = Arena::blockSize(valueLen);
+	if ( keyLen > FT_INLINE_KEY ) {
+		bytes += Arena::blockSize(keyLen);
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: getArena
+ *
+ * DESCRIPTION: Returns the arena shared by all ranges
+ */
+Arena *RangeTable::getArena() const {
+	return arena;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Removes every range. The shared arena is released in bulk.
+ */
+void RangeTable::clear() {
+	for ( int i = 0; i < RING_SIZE; i++ ) {
+		delete ranges[i];
+		delete filters[i];
+		ranges[i] = NULL;
+		filters[i] = NULL;
+	}
+	arena->reset();
+	size = 0;
+}
+
+/**
+ * FUNCTION NAME: getRange
+ *
+ * DESCRIPTION: Table holding the keys of a token, for iteration
+ *
+ * RETURNS:
+ * the range, or NULL if it holds nothing
+ */
+FlatTable *RangeTable::getRange(size_t token) const {
+	return ranges[token] != NULL && !ranges[token]->empty() ? ranges[token] : NULL;
+}
+
+/**
+ * FUNCTION NAME: rangeCount
+ *
+ * DESCRIPTION: Number of keys in the range of a token
+ */
+size_t RangeTable::rangeCount(size_t token) const {
+	return ranges[token] == NULL ? 0 : ranges[token]->getSize();
+}
+
+/**
+ * FUNCTION NAME: rangeBytes
+ *
+ * DESCRIPTION: Key and value bytes held by the range of a token
+ */
+size_t RangeTable::rangeBytes(size_t token) const {
+	return ranges[token] == NULL ? 0 : ranges[token]->getBytes();
+}
+
+/**
+ * FUNCTION NAME: dropRange
+ *
+ * DESCRIPTION: Removes every key of a token
+ */
+void RangeTable::dropRange(size_t token) {
+	if ( ranges[token] == NULL ) {
+		return;
+	}
+	size -= ranges[token]->getSize();
+	delete ranges[token];
+	delete filters[token];
+	ranges[token] = NULL;
+	filters[token] = NULL;
+}
+
+/**
+ * FUNCTION NAME: transferRange
+ *
+ * DESCRIPTION: Moves every key of a token into destination. Keys the destination
+ * 				already holds keep their value there.
+ */
+void RangeTable::transferRange(size_t token, RangeTable &destination) {
+	if ( ranges[token] == NULL || &destination == this ) {
+		return;
+	}
+	FlatTable *target = destination.rangeFor(token);
+	for ( FlatTable::iterator it = ranges[token]->begin(); it != ranges[token]->end(); ++it ) {
+		char *buffer = target->emplace(it.keyData(), it.keyLength(), it.valueLength());
+		if ( buffer != NULL ) {
+			memcpy(buffer, it.valueData(), it.valueLength());
+			destination.added(token, keyHash(it.keyData(), it.keyLength()));
+		}
+	}
+	dropRange(token);
+}
+
+/**
+ * FUNCTION NAME: getFilter
+ *
+ * DESCRIPTION: Filter of the range of a token
+ *
+ * RETURNS:
+ * the filter, or NULL while the range is empty
+ */
+const BloomFilter *RangeTable::getFilter(size_t token) const {
+	return filters[token];
+}
+
+/**
+ * FUNCTION NAME: rangeFalsePositiveRate
+ *
+ * DESCRIPTION: Observed share of lookups for keys absent from a range that its filter let through
+ */
+double RangeTable::rangeFalsePositiveRate(size_t token) const {
+	unsigned long absent = filterNegatives[token] + filterFalsePositives[token];
+	return absent == 0 ? 0.0 : (double)filterFalsePositives[token] / absent;
+}
+
+/**
+ * FUNCTION NAME: getFilterStats
+ *
+ * DESCRIPTION: Filtered lookups over all ranges: rejected by a filter, let through but
+ * 				absent, and let through and found
+ */
+void RangeTable::getFilterStats(unsigned long &negatives, unsigned long &falsePositives, unsigned long &hits) const {
+	negatives = 0;
+	falsePositives = 0;
+	hits = 0;
+	for ( int i = 0; i < RING_SIZE; i++ ) {
+		negatives += filterNegatives[i];
+		falsePositives += filterFalsePositives[i];
+		hits += filterHits[i];
+	}
+}
+
+/**
+ * FUNCTION NAME: falsePositiveRate
+ *
+ * DESCRIPTION: Observed false positive rate of the filters of the whole node
+ */
+double RangeTable::falsePositiveRate() const {
+	unsigned long negatives, falsePositives, hits;
+	getFilterStats(negatives, falsePositives, hits);
+	return negatives + falsePositives == 0 ? 0.0 : (double)falsePositives / (negatives + falsePositives);
+}
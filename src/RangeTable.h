@@ -0,0 +1,93 @@
+/**********************************
+ * FILE NAME: RangeTable.h
+ *
+ * DESCRIPTION: Header file of RangeTable class
+ **********************************/
+
+#ifndef RANGETABLE_H_
+#define RANGETABLE_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include "FlatTable.h"
+#include "Arena.h"
+#include "BloomFilter.h"
+
+/*
+ * Macros
+ */
+// seed of the key hash, so that ring positions and filters do not follow the probes of
+// the range's table, which all keys of the range would otherwise share the low bits of
+#define RT_HASH_SEED 0xc70f6907
+
+/**
+ * CLASS NAME: RangeTable
+ *
+ * DESCRIPTION: Node local storage split by ring token. Every key lives in the FlatTable
+ * 				of its ring position (the same position MP2Node::hashFunction gives it),
+ * 				so ownership changes can count, iterate, move or drop a whole range
+ * 				without looking at the rest of the node's keys. All ranges share one Arena.
+ * 				Every range also keeps a counting Bloom filter, so lookups of absent keys are
+ * 				mostly answered without probing the range's table.
+ */
+class RangeTable {
+private:
+	Arena *arena;
+	// one table per ring token, NULL while the range is empty
+	FlatTable *ranges[RING_SIZE];
+	// filter of every non-empty range
+	BloomFilter *filters[RING_SIZE];
+	size_t size;
+	// outcome of the filtered lookups of every range
+	mutable unsigned long filterNegatives[RING_SIZE];
+	mutable unsigned long filterFalsePositives[RING_SIZE];
+	mutable unsigned long filterHits[RING_SIZE];
+
+	RangeTable(const RangeTable &another);
+	RangeTable& operator =(const RangeTable &another);
+
+	FlatTable *rangeFor(size_t token);
+	FlatTable *screen(const char *key, size_t keyLen, size_t &hash) const;
+	void recordLookup(size_t token, bool found) const;
+	void added(size_t token, size_t hash);
+	void rebuildFilter(size_t token);
+
+public:
+	RangeTable();
+	virtual ~RangeTable();
+
+	static size_t keyHash(const char *key, size_t keyLen);
+	static size_t token(const char *key, size_t keyLen);
+	static size_t entryBytes(size_t keyLen, size_t valueLen);
+
+	char *emplace(const char *key, size_t keyLen, size_t valueLen);
+	char *assign(const char *key, size_t keyLen, size_t valueLen);
+	const char *lookup(const char *key, size_t keyLen, size_t &valueLen);
+	bool emplace(const string &key, const string &value);
+	bool find(const string &key, string &value);
+	bool assign(const string &key, const string &value);
+	size_t erase(const string &key);
+	size_t count(const string &key) const;
+	bool empty() const;
+	size_t getSize() const;
+	size_t getMemoryUsage() const;
+	Arena *getArena() const;
+	void clear();
+
+	// range operations, proportional to the size of the range
+	FlatTable *getRange(size_t token) const;
+	size_t rangeCount(size_t token) const;
+	size_t rangeBytes(size_t token) const;
+	void dropRange(size_t token);
+	void transferRange(size_t token, RangeTable &destination);
+
+	// negative lookup filters
+	const BloomFilter *getFilter(size_t token) const;
+	double rangeFalsePositiveRate(size_t token) const;
+	void getFilterStats(unsigned long &negatives, unsigned long &falsePositives, unsigned long &hits) const;
+	double falsePositiveRate() const;
+};
+
+#endif /* RANGETABLE_H_ */
@@ -0,0 +1,142 @@
+/**********************************
+ * FILE NAME: ReadCache.cpp
+ *
+ * DESCRIPTION: ReadCache class definition
+ **********************************/
+
+#include "ReadCache.h"
+
+/**
+ * constructor
+ */
+ReadCache::ReadCache(size_t budget): budget(budget), bytes(0), hits(0), misses(0), invalidations(0), evictions(0) {}
+
+/**
+ * FUNCTION NAME: remove
+ *
+ * DESCRIPTION: Drops the entry at position of the index
+ */
+void ReadCache::remove(unordered_map<string, list<CachedRead>::iterator>::iterator position) {
+	list<CachedRead>::iterator entry = position->second;
+	bytes -= entry->key.size() + entry->value.size() + READ_CACHE_ENTRY_OVERHEAD;
+	index.erase(position);
+	entries.erase(entry);
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Looks up key at globaltime now. An entry whose lease ended is dropped.
+ *
+ * RETURNS:
+ * true on a hit (value is set)
+ * false otherwise
+ */
+bool ReadCache::lookup(const string &key, int now, string &value) {
+	unordered_map<string, list<CachedRead>::iterator>::iterator position = index.find(key);
+	if ( position == index.end() ) {
+		misses++;
+		return false;
+	}
+	if ( position->second->lease <= now ) {
+		remove(position);
+		misses++;
+		return false;
+	}
+	entries.splice(entries.begin(), entries, position->second);
+	value = position->second->value;
+	hits++;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: insert
+ *
+ * DESCRIPTION: Caches the value of key until globaltime lease, evicting the least
+ * 				recently used keys to stay within the budget
+ */
+void ReadCache::insert(const string &key, const string &value, int lease) {
+	size_t charge = key.size() + value.size() + READ_CACHE_ENTRY_OVERHEAD;
+	unordered_map<string, list<CachedRead>::iterator>::iterator position = index.find(key);
+	if ( position != index.end() ) {
+		remove(position);
+	}
+	if ( charge > budget ) {
+		return;
+	}
+	while ( bytes + charge > budget ) {
+		remove(index.find(entries.back().key));
+		evictions++;
+	}
+	CachedRead entry;
+	entry.key = key;
+	entry.value = value;
+	entry.lease = lease;
+	entries.push_front(entry);
+	index[key] = entries.begin();
+	bytes += charge;
+}
+
+/**
+ * FUNCTION NAME: invalidate
+ *
+ * DESCRIPTION: Drops key, e.g. because its primary replica revoked the lease
+ *
+ * RETURNS:
+ * true if key was cached
+ * false otherwise
+ */
+bool ReadCache::invalidate(const string &key) {
+	unordered_map<string, list<CachedRead>::iterator>::iterator position = index.find(key);
+	if ( position == index.end() ) {
+		return false;
+	}
+	remove(position);
+	invalidations++;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: getBytes
+ *
+ * DESCRIPTION: Returns the bytes charged to the cached keys
+ */
+size_t ReadCache::getBytes() {
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: getHits
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long ReadCache::getHits() {
+	return hits;
+}
+
+/**
+ * FUNCTION NAME: getMisses
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long ReadCache::getMisses() {
+	return misses;
+}
+
+/**
+ * FUNCTION NAME: getInvalidations
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long ReadCache::getInvalidations() {
+	return invalidations;
+}
+
+/**
+ * FUNCTION NAME: getEvictions
+ *
+ * DESCRIPTION: getter
+ */
+unsigned long ReadCache::getEvictions() {
+	return evictions;
+}
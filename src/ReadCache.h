@@ -0,0 +1,68 @@
+/**********************************
+ * FILE NAME: ReadCache.h
+ *
+ * DESCRIPTION: Header file of ReadCache class
+ **********************************/
+
+#ifndef READCACHE_H_
+#define READCACHE_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include <list>
+#include <unordered_map>
+
+/*
+ * Macros
+ */
+// bytes charged to every cached key besides its key and value (list and index nodes)
+#define READ_CACHE_ENTRY_OVERHEAD 96
+
+/**
+ * STRUCT NAME: CachedRead
+ *
+ * DESCRIPTION: Value of a key read through quorum, valid until its lease ends
+ */
+typedef struct CachedRead {
+	string key;
+	string value;
+	int lease;
+} CachedRead;
+
+/**
+ * CLASS NAME: ReadCache
+ *
+ * DESCRIPTION: Coordinator side cache of recent reads, bounded to a byte budget with
+ * 				least recently used eviction. Every entry is covered by a lease of the key's
+ * 				primary replica, which tells the cache to drop the key when it is written;
+ * 				an entry whose lease ran out is never served.
+ */
+class ReadCache {
+private:
+	// most recently used first
+	list<CachedRead> entries;
+	unordered_map<string, list<CachedRead>::iterator> index;
+	size_t budget;
+	size_t bytes;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long invalidations;
+	unsigned long evictions;
+
+	void remove(unordered_map<string, list<CachedRead>::iterator>::iterator position);
+
+public:
+	ReadCache(size_t budget);
+	bool lookup(const string &key, int now, string &value);
+	void insert(const string &key, const string &value, int lease);
+	bool invalidate(const string &key);
+	size_t getBytes();
+	unsigned long getHits();
+	unsigned long getMisses();
+	unsigned long getInvalidations();
+	unsigned long getEvictions();
+};
+
+#endif /* READCACHE_H_ */
@@ -0,0 +1,515 @@
+/**********************************
+ * FILE NAME: ShardedHashTable.cpp
+ *
+ * DESCRIPTION: ShardedHashTable class definition
+ **********************************/
+
+#include "ShardedHashTable.h"
+
+/**
+ * constructor
+ */
+ShardedHashTable::ShardedHashTable() {
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		// generation 0 marks an empty slot, shards start at 1
+		shards[i].generation.store(1);
+		for ( int j = 0; j < HT_READ_SLOTS; j++ ) {
+			ReadSlot &slot = shards[i].slots[j];
+			slot.seq.store(0);
+			slot.generation.store(0);
+			slot.keyLen.store(0);
+			slot.size.store(0);
+			for ( int k = 0; k < HT_SLOT_WORDS; k++ ) {
+				slot.words[k].store(0);
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: shardOf
+ *
+ * DESCRIPTION: Shard of a key, derived from its ring token
+ */
+size_t ShardedHashTable::shardOf(const string &key) {
+	return RangeTable::token(key.data(), key.size()) % HT_SHARDS;
+}
+
+/**
+ * FUNCTION NAME: slotOf
+ *
+ * DESCRIPTION: Read slot of a key in its shard, from the hash bits the token does not use
+ */
+ReadSlot &ShardedHashTable::slotOf(TableShard &shard, const string &key) {
+	return shard.slots[RangeTable::keyHash(key.data(), key.size()) / RING_SIZE % HT_READ_SLOTS];
+}
+
+/**
+ * FUNCTION NAME: groupByShard
+ *
+ * DESCRIPTION: Fills order with the positions of keys sorted by shard, so a batch
+ * 				visits every shard once
+ */
+void ShardedHashTable::groupByShard(const vector<string> &keys, vector<size_t> &order) {
+	vector<size_t> shard(keys.size());
+	order.resize(keys.size());
+	for ( size_t i = 0; i < keys.size(); i++ ) {
+		shard[i] = shardOf(keys[i]);
+		order[i] = i;
+	}
+	stable_sort(order.begin(), order.end(), [&shard](size_t a, size_t b) { return shard[a] < shard[b]; });
+}
+
+/**
+ * FUNCTION NAME: readSlot
+ *
+ * DESCRIPTION: Reads the stored bytes of key from its read slot, without the shard's
+ * 				lock. The slot is copied word by word between two reads of its sequence;
+ * 				a copy a writer overlapped is thrown away and the read tried again.
+ *
+ * RETURNS:
+ * true if the slot held key (bytes is set)
+ * false if it did not, or kept meeting a writer: the caller takes the lock
+ */
+bool ShardedHashTable::readSlot(const string &key, string &bytes) {
+	if ( key.size() > HT_SLOT_BYTES ) {
+		return false;
+	}
+	TableShard &shard = shards[shardOf(key)];
+	ReadSlot &slot = slotOf(shard, key);
+	uint64_t words[HT_SLOT_WORDS];
+	for ( int attempt = 0; attempt < HT_READ_RETRIES; attempt++ ) {
+		unsigned seq = slot.seq.load(memory_order_acquire);
+		if ( seq & 1 ) {
+			continue;
+		}
+		bool current = slot.generation.load(memory_order_relaxed) == shard.generation.load(memory_order_relaxed);
+		size_t keyLen = slot.keyLen.load(memory_order_relaxed);
+		size_t size = slot.size.load(memory_order_relaxed);
+		bool usable = current && keyLen == key.size() && keyLen + size <= HT_SLOT_BYTES;
+		size_t used = usable ? (keyLen + size + 7) / 8 : 0;
+		for ( size_t i = 0; i < used; i++ ) {
+			words[i] = slot.words[i].load(memory_order_relaxed);
+		}
+		atomic_thread_fence(memory_order_acquire);
+		if ( slot.seq.load(memory_order_relaxed) != seq ) {
+			continue;
+		}
+		const char *copy = (const char *)words;
+		if ( !usable || memcmp(copy, key.data(), keyLen) != 0 ) {
+			return false;
+		}
+		bytes.assign(copy + keyLen, size);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: publish
+ *
+ * DESCRIPTION: Writes the stored bytes of key into its read slot after key was read or
+ * 				written under the shard's lock, or empties the slot if they do not fit or
+ * 				key is gone. The shard's lock makes this the slot's only writer.
+ */
+void ShardedHashTable::publish(TableShard &shard, const string &key) {
+	ReadSlot &slot = slotOf(shard, key);
+	size_t size = 0;
+	const char *data = shard.table.hashTable.lookup(key.data(), key.size(), size);
+	bool fits = data != NULL && key.size() + size <= HT_SLOT_BYTES;
+	unsigned seq = slot.seq.load(memory_order_relaxed);
+	slot.seq.store(seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	if ( fits ) {
+		uint64_t words[HT_SLOT_WORDS];
+		memcpy(words, key.data(), key.size());
+		memcpy((char *)words + key.size(), data, size);
+		size_t used = (key.size() + size + 7) / 8;
+		for ( size_t i = 0; i < used; i++ ) {
+			slot.words[i].store(words[i], memory_order_relaxed);
+		}
+		slot.keyLen.store(key.size(), memory_order_relaxed);
+		slot.size.store(size, memory_order_relaxed);
+		slot.generation.store(shard.generation.load(memory_order_relaxed), memory_order_relaxed);
+	}
+	else {
+		slot.generation.store(0, memory_order_relaxed);
+	}
+	slot.seq.store(seq + 2, memory_order_release);
+}
+
+/**
+ * FUNCTION NAME: retire
+ *
+ * DESCRIPTION: Retires every read slot of a shard whose table dropped keys it was not
+ * 				asked for by name, by moving the shard's generation on
+ */
+void ShardedHashTable::retire(TableShard &shard) {
+	unsigned next = shard.generation.load(memory_order_relaxed) + 1;
+	shard.generation.store(next == 0 ? 1 : next, memory_order_release);
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: HashTable::create on the key's shard
+ */
+bool ShardedHashTable::create(const string &key, const string &value) {
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	bool created = shard.table.create(key, value);
+	publish(shard, key);
+	return created;
+}
+
+/**
+ * FUNCTION NAME: read
+ *
+ * DESCRIPTION: HashTable::read, from the key's read slot if it holds the key
+ */
+string ShardedHashTable::read(const string &key) {
+	string value;
+	if ( readSlot(key, value) ) {
+		return value;
+	}
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	value = shard.table.read(key);
+	publish(shard, key);
+	return value;
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: HashTable::update on the key's shard
+ */
+bool ShardedHashTable::update(const string &key, const string &newValue) {
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	bool updated = shard.table.update(key, newValue);
+	publish(shard, key);
+	return updated;
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: HashTable::deleteKey on the key's shard
+ */
+bool ShardedHashTable::deleteKey(const string &key) {
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	bool deleted = shard.table.deleteKey(key);
+	publish(shard, key);
+	return deleted;
+}
+
+/**
+ * FUNCTION NAME: isEmpty
+ *
+ * DESCRIPTION: Returns if every shard is empty. Shards are checked one after the other,
+ * 				so concurrent writes may or may not be seen.
+ */
+bool ShardedHashTable::isEmpty() {
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		lock_guard<mutex> guard(shards[i].lock);
+		if ( !shards[i].table.isEmpty() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: currentSize
+ *
+ * DESCRIPTION: Sum of the sizes of the shards
+ */
+unsigned long ShardedHashTable::currentSize() {
+	unsigned long size = 0;
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		lock_guard<mutex> guard(shards[i].lock);
+		size += shards[i].table.currentSize();
+	}
+	return size;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Clears every shard
+ */
+void ShardedHashTable::clear() {
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		lock_guard<mutex> guard(shards[i].lock);
+		shards[i].table.clear();
+		retire(shards[i]);
+	}
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: HashTable::count, from the key's read slot if it holds the key
+ */
+unsigned long ShardedHashTable::count(const string &key) {
+	string bytes;
+	if ( readSlot(key, bytes) ) {
+		return 1;
+	}
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	return shard.table.count(key);
+}
+
+/**
+ * FUNCTION NAME: createRecord
+ *
+ * DESCRIPTION: HashTable::createRecord on the key's shard
+ */
+bool ShardedHashTable::createRecord(const string &key, Entry &entry) {
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	bool created = shard.table.createRecord(key, entry);
+	publish(shard, key);
+	return created;
+}
+
+/**
+ * FUNCTION NAME: readRecord
+ *
+ * DESCRIPTION: Copies the record of the key out of its read slot, or out of its shard
+ *
+ * RETURNS:
+ * true if found (tombstones included)
+ * false otherwise
+ */
+bool ShardedHashTable::readRecord(const string &key, Entry &entry) {
+	string bytes;
+	if ( readSlot(key, bytes) && Record::matches(bytes.data(), bytes.size()) ) {
+		entry = Entry(Record(bytes.data()));
+		return true;
+	}
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	Record record;
+	if ( !shard.table.readRecord(key, record) ) {
+		return false;
+	}
+	entry = Entry(record);
+	publish(shard, key);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: updateRecord
+ *
+ * DESCRIPTION: HashTable::updateRecord on the key's shard
+ */
+bool ShardedHashTable::updateRecord(const string &key, Entry &entry) {
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	bool updated = shard.table.updateRecord(key, entry);
+	publish(shard, key);
+	return updated;
+}
+
+/**
+ * FUNCTION NAME: deleteRecord
+ *
+ * DESCRIPTION: HashTable::deleteRecord on the key's shard
+ */
+bool ShardedHashTable::deleteRecord(const string &key, int timestamp) {
+	TableShard &shard = shards[shardOf(key)];
+	lock_guard<mutex> guard(shard.lock);
+	bool deleted = shard.table.deleteRecord(key, timestamp);
+	publish(shard, key);
+	return deleted;
+}
+
+/**
+ * FUNCTION NAME: createBatch
+ *
+ * DESCRIPTION: Creates keys[i] with values[i] for every i, taking each shard's lock once
+ *
+ * RETURNS:
+ * number of created keys
+ */
+size_t ShardedHashTable::createBatch(const vector<string> &keys, const vector<string> &values) {
+	vector<size_t> order;
+	groupByShard(keys, order);
+	size_t created = 0;
+	size_t i = 0;
+	while ( i < order.size() ) {
+		TableShard &shard = shards[shardOf(keys[order[i]])];
+		lock_guard<mutex> guard(shard.lock);
+		for ( ; i < order.size() && &shards[shardOf(keys[order[i]])] == &shard; i++ ) {
+			if ( shard.table.create(keys[order[i]], values[order[i]]) ) {
+				created++;
+			}
+			publish(shard, keys[order[i]]);
+		}
+	}
+	return created;
+}
+
+/**
+ * FUNCTION NAME: readBatch
+ *
+ * DESCRIPTION: Reads every key, values[i] receives the value of keys[i] ("" if absent).
+ * 				Keys found in their read slots take no lock, each shard of the others
+ * 				is locked once.
+ */
+void ShardedHashTable::readBatch(const vector<string> &keys, vector<string> &values) {
+	values.assign(keys.size(), "");
+	vector<string> missed;
+	vector<size_t> positions;
+	for ( size_t i = 0; i < keys.size(); i++ ) {
+		if ( !readSlot(keys[i], values[i]) ) {
+			missed.push_back(keys[i]);
+			positions.push_back(i);
+		}
+	}
+	vector<size_t> order;
+	groupByShard(missed, order);
+	size_t i = 0;
+	while ( i < order.size() ) {
+		TableShard &shard = shards[shardOf(missed[order[i]])];
+		lock_guard<mutex> guard(shard.lock);
+		for ( ; i < order.size() && &shards[shardOf(missed[order[i]])] == &shard; i++ ) {
+			values[positions[order[i]]] = shard.table.read(missed[order[i]]);
+			publish(shard, missed[order[i]]);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: updateBatch
+ *
+ * DESCRIPTION: Updates keys[i] to values[i] for every i, taking each shard's lock once
+ *
+ * RETURNS:
+ * number of updated keys
+ */
+size_t ShardedHashTable::updateBatch(const vector<string> &keys, const vector<string> &values) {
+	vector<size_t> order;
+	groupByShard(keys, order);
+	size_t updated = 0;
+	size_t i = 0;
+	while ( i < order.size() ) {
+		TableShard &shard = shards[shardOf(keys[order[i]])];
+		lock_guard<mutex> guard(shard.lock);
+		for ( ; i < order.size() && &shards[shardOf(keys[order[i]])] == &shard; i++ ) {
+			if ( shard.table.update(keys[order[i]], values[order[i]]) ) {
+				updated++;
+			}
+			publish(shard, keys[order[i]]);
+		}
+	}
+	return updated;
+}
+
+/**
+ * FUNCTION NAME: deleteBatch
+ *
+ * DESCRIPTION: Deletes every key, taking each shard's lock once
+ *
+ * RETURNS:
+ * number of deleted keys
+ */
+size_t ShardedHashTable::deleteBatch(const vector<string> &keys) {
+	vector<size_t> order;
+	groupByShard(keys, order);
+	size_t deleted = 0;
+	size_t i = 0;
+	while ( i < order.size() ) {
+		TableShard &shard = shards[shardOf(keys[order[i]])];
+		lock_guard<mutex> guard(shard.lock);
+		for ( ; i < order.size() && &shards[shardOf(keys[order[i]])] == &shard; i++ ) {
+			if ( shard.table.deleteKey(keys[order[i]]) ) {
+				deleted++;
+			}
+			publish(shard, keys[order[i]]);
+		}
+	}
+	return deleted;
+}
+
+/**
+ * FUNCTION NAME: dropRange
+ *
+ * DESCRIPTION: Drops a token range, which lives entirely in one shard
+ */
+void ShardedHashTable::dropRange(size_t token) {
+	TableShard &shard = shards[token % HT_SHARDS];
+	lock_guard<mutex> guard(shard.lock);
+	shard.table.dropRange(token);
+	retire(shard);
+}
+
+/**
+ * FUNCTION NAME: expireRecords
+ *
+ * DESCRIPTION: HashTable::expireRecords on every shard
+ */
+size_t ShardedHashTable::expireRecords(int now) {
+	size_t expired = 0;
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		lock_guard<mutex> guard(shards[i].lock);
+		size_t dropped = shards[i].table.expireRecords(now);
+		if ( dropped > 0 ) {
+			retire(shards[i]);
+		}
+		expired += dropped;
+	}
+	return expired;
+}
+
+/**
+ * FUNCTION NAME: purgeTombstones
+ *
+ * DESCRIPTION: HashTable::purgeTombstones on every shard, with the budget split evenly
+ */
+size_t ShardedHashTable::purgeTombstones(int horizon, size_t budget) {
+	size_t purged = 0;
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		lock_guard<mutex> guard(shards[i].lock);
+		size_t dropped = shards[i].table.purgeTombstones(horizon, budget / HT_SHARDS + 1);
+		if ( dropped > 0 ) {
+			retire(shards[i]);
+		}
+		purged += dropped;
+	}
+	return purged;
+}
+
+/**
+ * FUNCTION NAME: setMemoryBudget
+ *
+ * DESCRIPTION: Splits a memory budget evenly over the shards, 0 for no limit
+ */
+void ShardedHashTable::setMemoryBudget(size_t budget) {
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		lock_guard<mutex> guard(shards[i].lock);
+		shards[i].table.setMemoryBudget(budget == 0 ? 0 : budget / HT_SHARDS + 1);
+	}
+}
+
+/**
+ * FUNCTION NAME: evictToBudget
+ *
+ * DESCRIPTION: HashTable::evictToBudget on every shard
+ */
+size_t ShardedHashTable::evictToBudget() {
+	size_t evicted = 0;
+	for ( int i = 0; i < HT_SHARDS; i++ ) {
+		lock_guard<mutex> guard(shards[i].lock);
+		size_t dropped = shards[i].table.evictToBudget();
+		if ( dropped > 0 ) {
+			retire(shards[i]);
+		}
+		evicted += dropped;
+	}
+	return evicted;
+}
@@ -0,0 +1,120 @@
+/**********************************
+ * FILE NAME: ShardedHashTable.h
+ *
+ * DESCRIPTION: Header file of ShardedHashTable class
+ **********************************/
+
+#ifndef SHARDEDHASHTABLE_H_
+#define SHARDEDHASHTABLE_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include <atomic>
+#include <mutex>
+#include "HashTable.h"
+
+/*
+ * Macros
+ */
+// number of independently locked shards
+#define HT_SHARDS 16
+// seqlock protected read slots of every shard, and the bytes of key and value one holds
+#define HT_READ_SLOTS 256
+#define HT_SLOT_WORDS 16
+#define HT_SLOT_BYTES (HT_SLOT_WORDS * 8)
+// attempts of an optimistic read that keeps meeting a writer before it takes the lock
+#define HT_READ_RETRIES 4
+
+/**
+ * STRUCT NAME: ReadSlot
+ *
+ * DESCRIPTION: Copy of the stored bytes of one key, read without the shard's lock. The
+ * 				shard's writers make seq odd while they change the slot; a reader copies
+ * 				the slot and keeps the copy only if seq was even and unchanged throughout.
+ * 				Every field is atomic, so a reader racing a writer reads stale bytes but
+ * 				never undefined ones. A slot filled before the shard's generation moved on
+ * 				is stale.
+ */
+typedef struct ReadSlot {
+	atomic<unsigned> seq;
+	atomic<unsigned> generation;
+	atomic<unsigned> keyLen;
+	atomic<unsigned> size;
+	// key bytes followed by the stored bytes
+	atomic<uint64_t> words[HT_SLOT_WORDS];
+} ReadSlot;
+
+/**
+ * STRUCT NAME: TableShard
+ *
+ * DESCRIPTION: One HashTable, the lock that guards it and its read slots
+ */
+typedef struct TableShard {
+	mutex lock;
+	HashTable table;
+	// moves on whenever the table drops keys it did not name (expiry, eviction, ranges)
+	atomic<unsigned> generation;
+	ReadSlot slots[HT_READ_SLOTS];
+} TableShard;
+
+/**
+ * CLASS NAME: ShardedHashTable
+ *
+ * DESCRIPTION: Thread safe HashTable for nodes that serve requests from several threads.
+ * 				Keys are striped over HT_SHARDS shards by ring token, so a whole token
+ * 				range lives in one shard, and every write locks only its key's shard.
+ * 				Reads are optimistic: a key whose bytes fit a read slot is read from the
+ * 				slot under its seqlock, without the lock; others, and reads that keep
+ * 				meeting a writer, lock the shard, since a table lookup updates access
+ * 				metadata (filter counters, CLOCK bits). Every write under the lock also
+ * 				writes its key's slot, and maintenance that drops keys it does not name
+ * 				moves the shard's generation on, which retires all its slots at once.
+ * 				Batch operations take each shard's lock once and never hold two at a
+ * 				time. Results are copies: nothing points into a shard after its lock is
+ * 				released.
+ */
+class ShardedHashTable {
+private:
+	TableShard shards[HT_SHARDS];
+
+	ShardedHashTable(const ShardedHashTable &another);
+	ShardedHashTable& operator =(const ShardedHashTable &another);
+
+	static size_t shardOf(const string &key);
+	static ReadSlot &slotOf(TableShard &shard, const string &key);
+	void groupByShard(const vector<string> &keys, vector<size_t> &order);
+	bool readSlot(const string &key, string &bytes);
+	void publish(TableShard &shard, const string &key);
+	void retire(TableShard &shard);
+
+public:
+	ShardedHashTable();
+	// HashTable API
+	bool create(const string &key, const string &value);
+	string read(const string &key);
+	bool update(const string &key, const string &newValue);
+	bool deleteKey(const string &key);
+	bool isEmpty();
+	unsigned long currentSize();
+	void clear();
+	unsigned long count(const string &key);
+	bool createRecord(const string &key, Entry &entry);
+	bool readRecord(const string &key, Entry &entry);
+	bool updateRecord(const string &key, Entry &entry);
+	bool deleteRecord(const string &key, int timestamp);
+	// batches
+	size_t createBatch(const vector<string> &keys, const vector<string> &values);
+	void readBatch(const vector<string> &keys, vector<string> &values);
+	size_t updateBatch(const vector<string> &keys, const vector<string> &values);
+	size_t deleteBatch(const vector<string> &keys);
+	// maintenance, one shard at a time
+	void dropRange(size_t token);
+	size_t expireRecords(int now);
+	size_t purgeTombstones(int horizon, size_t budget);
+	void setMemoryBudget(size_t budget);
+	size_t evictToBudget();
+};
+
+#endif /* SHARDEDHASHTABLE_H_ */
@@ -0,0 +1,373 @@
+/**********************************
+ * FILE NAME: ShmTransport.cpp
+ *
+ * DESCRIPTION: Definition of the shared memory transport
+ **********************************/
+
+#include "ShmTransport.h"
+
+/**
+ * Constructor: maps a segment with the inbound rings of the EN_GPSZ nodes on every lane
+ */
+ShmTransport::ShmTransport(Params *p): Transport(p), nextid(1), pendingHeader(NULL), pendingSize(0), pendingRing(NULL) {
+	// ids start at 1
+	slots = par->EN_GPSZ + 1;
+	segmentBytes = (size_t)slots * EN_LANES * sizeof(shm_ring);
+
+	segmentFd = memfd_create("kvstore-transport", 0);
+	if ( segmentFd < 0 || ftruncate(segmentFd, segmentBytes) < 0 ) {
+		perror("memfd_create");
+		exit(1);
+	}
+	// the new segment reads as zeroes: empty rings whose space is all SHM_PENDING
+	segment = (char *)mmap(NULL, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, segmentFd, 0);
+	if ( segment == MAP_FAILED ) {
+		perror("mmap");
+		exit(1);
+	}
+	spill.resize(slots * EN_LANES);
+	spilled.resize(slots * EN_LANES, 0);
+}
+
+/**
+ * Destructor
+ */
+ShmTransport::~ShmTransport() {
+	if ( segment != NULL ) {
+		ENcleanup();
+	}
+}
+
+/**
+ * FUNCTION NAME: ENinit
+ *
+ * DESCRIPTION: Gives the node the next id
+ */
+void *ShmTransport::ENinit(Address *myaddr, short port) {
+	assert(nextid < slots);
+	*(int *)(myaddr->addr) = nextid++;
+	*(short *)(&myaddr->addr[4]) = 0;
+	return myaddr;
+}
+
+/**
+ * FUNCTION NAME: idOf
+ *
+ * DESCRIPTION: Node id of addr
+ */
+int ShmTransport::idOf(Address *addr) {
+	int id;
+	memcpy(&id, addr->addr, sizeof(int));
+	return id;
+}
+
+/**
+ * FUNCTION NAME: recordBytes
+ *
+ * DESCRIPTION: Ring bytes of a record of a size byte message: its header and the message
+ * 				padded to whole ints, so every header is aligned
+ */
+uint32_t ShmTransport::recordBytes(int size) {
+	return sizeof(int) + ((size + sizeof(int) - 1) & ~(sizeof(int) - 1));
+}
+
+/**
+ * FUNCTION NAME: ringIndex
+ *
+ * DESCRIPTION: Index of the inbound ring of node dst on lane
+ */
+int ShmTransport::ringIndex(int dst, int lane) {
+	assert(dst >= 0 && dst < slots && lane >= 0 && lane < EN_LANES);
+	return dst * EN_LANES + lane;
+}
+
+/**
+ * FUNCTION NAME: ring
+ *
+ * DESCRIPTION: Ring at index
+ */
+shm_ring *ShmTransport::ring(int index) {
+	return (shm_ring *)segment + index;
+}
+
+/**
+ * FUNCTION NAME: reserveRecord
+ *
+ * DESCRIPTION: Reserves a record of size bytes in ring r, to be committed by commit()
+ * 				once the caller wrote it. Space left before the end of the ring that the
+ * 				record does not fit in is marked SHM_WRAP.
+ *
+ * RETURNS:
+ * where the caller writes the bytes, NULL if the ring has no room
+ */
+char *ShmTransport::reserveRecord(shm_ring *r, int size) {
+	uint32_t need = recordBytes(size);
+	uint32_t reserved = __atomic_load_n(&r->reserved, __ATOMIC_RELAXED);
+	uint32_t at, waste;
+	do {
+		at = reserved & (SHM_RING_BYTES - 1);
+		waste = SHM_RING_BYTES - at < need ? SHM_RING_BYTES - at : 0;
+		uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+		if ( reserved - tail + waste + need > SHM_RING_BYTES ) {
+			return NULL;
+		}
+	} while ( !__atomic_compare_exchange_n(&r->reserved, &reserved, reserved + waste + need, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) );
+
+	if ( waste > 0 ) {
+		__atomic_store_n((int *)(r->data + at), SHM_WRAP, __ATOMIC_RELEASE);
+		at = 0;
+	}
+	pendingHeader = (int *)(r->data + at);
+	pendingSize = size;
+	pendingRing = r;
+	return r->data + at + sizeof(int);
+}
+
+/**
+ * FUNCTION NAME: commit
+ *
+ * DESCRIPTION: Makes the record reserved last visible to its receiver
+ */
+void ShmTransport::commit() {
+	if ( pendingHeader == NULL ) {
+		return;
+	}
+	__atomic_store_n(pendingHeader, pendingSize + 1, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&pendingRing->queued, 1, __ATOMIC_RELAXED);
+	pendingHeader = NULL;
+}
+
+/**
+ * FUNCTION NAME: spillRecord
+ *
+ * DESCRIPTION: Appends a record of size bytes to the messages waiting for space in the
+ * 				ring at index
+ *
+ * RETURNS:
+ * where the caller writes the bytes
+ */
+char *ShmTransport::spillRecord(int index, int size) {
+	int bytes = sizeof(int) + size;
+	deque<en_msg*> &frames = spill[index];
+	if ( frames.empty() ) {
+		waiting.push_back(index);
+	}
+	en_msg *em = frames.empty() ? NULL : frames.back();
+	if ( em == NULL || em->size + bytes > EN_BATCH_BYTES ) {
+		em = allocFrame(EN_BATCH_BYTES);
+		em->lane = index % EN_LANES;
+		frames.push_back(em);
+	}
+	spilled[index]++;
+
+	char *end = (char *)(em + 1) + em->size;
+	memcpy(end, &size, sizeof(int));
+	em->size += bytes;
+	return end + sizeof(int);
+}
+
+/**
+ * FUNCTION NAME: ENreserve
+ *
+ * DESCRIPTION: Sends a message of size bytes that the caller writes into the returned
+ * 				buffer, which is the message's place in the ring of its destination on
+ * 				lane (or behind the messages waiting for room in it). The caller writes
+ * 				the buffer and then calls ENcommit; a caller that does not is committed
+ * 				by its next call to this transport.
+ *
+ * RETURNS:
+ * the buffer, NULL if the message was dropped
+ */
+char *ShmTransport::ENreserve(Address *myaddr, Address *toaddr, int size, int lane) {
+	commit();
+	if ( dropped(size) ) {
+		return NULL;
+	}
+
+	int index = ringIndex(idOf(toaddr), lane);
+	char *buffer = NULL;
+	if ( spill[index].empty() ) {
+		buffer = reserveRecord(ring(index), size);
+	}
+	if ( buffer == NULL ) {
+		buffer = spillRecord(index, size);
+	}
+	return buffer;
+}
+
+/**
+ * FUNCTION NAME: ENcommit
+ *
+ * DESCRIPTION: The caller wrote the message it reserved last: its receiver may take it
+ * 				now, whether or not the sender calls the transport again
+ */
+void ShmTransport::ENcommit() {
+	commit();
+}
+
+/**
+ * FUNCTION NAME: publish
+ *
+ * DESCRIPTION: Commits the record reserved last and moves the messages waiting for ring
+ * 				space that now fit into their rings
+ */
+void ShmTransport::publish() {
+	commit();
+	size_t kept = 0;
+	for ( size_t i = 0; i < waiting.size(); i++ ) {
+		int index = waiting[i];
+		deque<en_msg*> &frames = spill[index];
+		shm_ring *r = ring(index);
+
+		while ( !frames.empty() ) {
+			en_msg *em = frames.front();
+			int pos = 0;
+			while ( pos < em->size ) {
+				int next = pos;
+				char *data;
+				int size;
+				ENnext(em, next, data, size);
+				char *buffer = reserveRecord(r, size);
+				if ( buffer == NULL ) {
+					break;
+				}
+				memcpy(buffer, data, size);
+				commit();
+				spilled[index]--;
+				pos = next;
+			}
+			if ( pos < em->size ) {
+				memmove((char *)(em + 1), (char *)(em + 1) + pos, em->size - pos);
+				em->size -= pos;
+				break;
+			}
+			ENrelease(em);
+			frames.pop_front();
+		}
+
+		if ( !frames.empty() ) {
+			// waits for the receiver to make room
+			waiting[kept++] = index;
+		}
+	}
+	waiting.resize(kept);
+}
+
+/**
+ * FUNCTION NAME: drain
+ *
+ * DESCRIPTION: Copies the committed records of the inbound ring of dst on lane into frames,
+ * 				up to the first record not committed yet, then zeroes the space read and
+ * 				frees it. The records of a ring come from all senders, so the frames
+ * 				leave from zero.
+ */
+void ShmTransport::drain(int dst, int lane, vector<en_msg *> &frames) {
+	shm_ring *r = ring(ringIndex(dst, lane));
+	uint32_t start = r->tail;
+	uint32_t tail = start;
+	en_msg *em = NULL;
+	int taken = 0;
+
+	while ( true ) {
+		uint32_t at = tail & (SHM_RING_BYTES - 1);
+		int header = __atomic_load_n((int *)(r->data + at), __ATOMIC_ACQUIRE);
+		if ( header == SHM_PENDING ) {
+			break;
+		}
+		if ( header == SHM_WRAP ) {
+			tail += SHM_RING_BYTES - at;
+			continue;
+		}
+		int size = header - 1;
+		if ( em == NULL || em->size + (int)sizeof(int) + size > em->capacity ) {
+			if ( em != NULL ) {
+				frames.push_back(em);
+			}
+			em = allocFrame(EN_BATCH_BYTES);
+			memset(&(em->from.addr), 0, sizeof(em->from.addr));
+			memset(&(em->to.addr), 0, sizeof(em->to.addr));
+			memcpy(em->to.addr, &dst, sizeof(int));
+			em->lane = lane;
+		}
+		// laid out as in a frame
+		char *end = (char *)(em + 1) + em->size;
+		memcpy(end, &size, sizeof(int));
+		memcpy(end + sizeof(int), r->data + at + sizeof(int), size);
+		em->size += sizeof(int) + size;
+		tail += recordBytes(size);
+		taken++;
+	}
+	if ( em != NULL ) {
+		frames.push_back(em);
+	}
+	if ( tail == start ) {
+		return;
+	}
+
+	// producers must find the freed space SHM_PENDING
+	uint32_t at = start & (SHM_RING_BYTES - 1);
+	uint32_t span = tail - start;
+	uint32_t first = min(span, (uint32_t)SHM_RING_BYTES - at);
+	memset(r->data + at, 0, first);
+	memset(r->data, 0, span - first);
+	__atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+	__atomic_fetch_sub(&r->queued, taken, __ATOMIC_RELAXED);
+}
+
+/**
+ * FUNCTION NAME: ENrecvFrames
+ *
+ * DESCRIPTION: Zero copy receive: publishes what this process sent, then appends the
+ * 				committed records of the inbound rings of myaddr on lanes to frames, lane by
+ * 				lane in priority order
+ *
+ * RETURN:
+ * number of frames taken
+ */
+int ShmTransport::ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes) {
+	int dst = idOf(myaddr);
+	size_t before = frames.size();
+
+	publish();
+	for ( int lane = 0; lane < EN_LANES; lane++ ) {
+		if ( lanes & LANE_MASK(lane) ) {
+			drain(dst, lane, frames);
+		}
+	}
+
+	return frames.size() - before;
+}
+
+/**
+ * FUNCTION NAME: ENcongested
+ *
+ * DESCRIPTION: Backpressure signal: whether senders to toaddr should hold their messages
+ * 				on lane back until toaddr receives
+ */
+bool ShmTransport::ENcongested(Address *toaddr, int lane) {
+	int index = ringIndex(idOf(toaddr), lane);
+	return __atomic_load_n(&ring(index)->queued, __ATOMIC_RELAXED) >= par->NET_HIGH_WATERMARK || spilled[index] > 0;
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Unmaps the segment and frees the frames. Called exactly once at the end of
+ * 				the program.
+ */
+int ShmTransport::ENcleanup() {
+	pendingHeader = NULL;
+	for ( size_t i = 0; i < spill.size(); i++ ) {
+		for ( size_t j = 0; j < spill[i].size(); j++ ) {
+			free(spill[i][j]);
+		}
+		spill[i].clear();
+	}
+	waiting.clear();
+	releasePool();
+
+	munmap(segment, segmentBytes);
+	close(segmentFd);
+	segment = NULL;
+	return 0;
+}
@@ -0,0 +1,102 @@
+/**********************************
+ * FILE NAME: ShmTransport.h
+ *
+ * DESCRIPTION: Header file of the shared memory transport
+ **********************************/
+
+#ifndef _SHMTRANSPORT_H_
+#define _SHMTRANSPORT_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+#include <deque>
+#include <sys/mman.h>
+#include "Params.h"
+#include "Member.h"
+#include "Transport.h"
+
+// data bytes of the inbound ring of one node on one lane, a power of two
+#define SHM_RING_BYTES (256 * 1024)
+// the shared counters of a ring are kept on cache lines of their own
+#define SHM_CACHE_LINE 64
+// ring record header of space reserved but not committed yet; the consumer zeroes what it read
+#define SHM_PENDING 0
+// ring record header marking that the records go on at the start of the ring
+#define SHM_WRAP -1
+
+/**
+ * Struct Name: shm_ring
+ *
+ * DESCRIPTION: Multiple producer, single consumer ring in the segment, inbound to one node
+ * 				on one lane. reserved and tail count the bytes ever reserved and read.
+ * 				Producers reserve space with a compare and swap on reserved, write their
+ * 				record and then commit it by storing its header: the size plus one, so
+ * 				that an empty message is not taken for SHM_PENDING. Records are padded to
+ * 				whole ints and a record that does not fit before the end of the ring starts
+ * 				over at its beginning.
+ */
+typedef struct shm_ring {
+	alignas(SHM_CACHE_LINE) uint32_t reserved;
+	alignas(SHM_CACHE_LINE) uint32_t tail;
+	// messages committed and not received yet
+	alignas(SHM_CACHE_LINE) int queued;
+	alignas(SHM_CACHE_LINE) char data[SHM_RING_BYTES];
+} shm_ring;
+
+/**
+ * CLASS NAME: ShmTransport
+ *
+ * DESCRIPTION: Transport over a shared memory segment (memfd) holding one lock free inbound
+ * 				ring per node and lane, which every sender shares, so the segment grows
+ * 				with the number of nodes only and messages cost two memcpy and no system
+ * 				call. Senders serialize straight into the ring of the destination and
+ * 				commit the record with ENcommit as soon as the bytes are written, so an
+ * 				idle sender never holds up the ring. A receive reads the rings of its
+ * 				lanes in priority order, up to the first record not committed yet, which
+ * 				a sender reserved and has not written yet. Messages that do not fit
+ * 				a full ring wait in the sender's process, in order. Senders are held back
+ * 				on a lane while NET_HIGH_WATERMARK messages wait for a node on it or
+ * 				messages to it on it are waiting for ring space.
+ * 				Processes forked after construction share the segment.
+ */
+class ShmTransport : public Transport
+{
+private:
+	int nextid;
+	// nodes the segment has rings for, ids 0 to slots - 1
+	int slots;
+	int segmentFd;
+	size_t segmentBytes;
+	char *segment;
+	// header and size of the record this process reserved last and did not commit yet
+	int *pendingHeader;
+	int pendingSize;
+	shm_ring *pendingRing;
+	// frames of the records waiting for ring space, oldest first, by destination node id
+	// and lane, and the rings that have some
+	vector<deque<en_msg*> > spill;
+	vector<int> waiting;
+	// messages waiting for ring space, by destination node id and lane
+	vector<int> spilled;
+
+	static int idOf(Address *addr);
+	static uint32_t recordBytes(int size);
+	int ringIndex(int dst, int lane);
+	shm_ring *ring(int index);
+	char *reserveRecord(shm_ring *r, int size);
+	void commit();
+	char *spillRecord(int index, int size);
+	void publish();
+	void drain(int dst, int lane, vector<en_msg *> &frames);
+public:
+	ShmTransport(Params *p);
+	virtual ~ShmTransport();
+	void *ENinit(Address *myaddr, short port);
+	char *ENreserve(Address *myaddr, Address *toaddr, int size, int lane);
+	int ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes);
+	bool ENcongested(Address *toaddr, int lane);
+	int ENcleanup();
+	void ENcommit();
+};
+
+#endif /* _SHMTRANSPORT_H_ */
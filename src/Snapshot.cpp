@@ -0,0 +1,333 @@
+/**********************************
+ * FILE NAME: Snapshot.cpp
+ *
+ * DESCRIPTION: Snapshot class definition
+ **********************************/
+
+#include "Snapshot.h"
+#include "Entry.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * constructor
+ */
+Snapshot::Snapshot(): fd(-1), base(NULL), mappedSize(0), header(NULL), index(NULL) {}
+
+/**
+ * Destructor
+ */
+Snapshot::~Snapshot() {
+	if ( base != NULL ) {
+		munmap((void *)base, mappedSize);
+	}
+	if ( fd >= 0 ) {
+		close(fd);
+	}
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Dumps the table, the membership list and the ring into a snapshot file.
+ * 				The file is written next to path and renamed over it once complete, so a
+ * 				crash while writing leaves the previous snapshot intact.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool Snapshot::write(string path, RangeTable &table, vector<MemberListEntry> &members, vector<Node> &ring, long heartbeat) {
+	string tmp = path + ".tmp";
+	FILE *fp = fopen(tmp.c_str(), "wb");
+	if ( fp == NULL ) {
+		return false;
+	}
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	uint64_t offset = sizeof(header);
+
+	// Index at most half full so misses stay short
+	size_t capacity = 16;
+	while ( capacity < table.getSize() * 2 ) {
+		capacity <<= 1;
+	}
+	vector<SnapshotSlot> slots(capacity, SnapshotSlot());
+
+	for ( size_t token = 0; token < RING_SIZE; token++ ) {
+		FlatTable *range = table.getRange(token);
+		if ( range == NULL ) {
+			continue;
+		}
+		for ( FlatTable::iterator it = range->begin(); it != range->end(); ++it ) {
+			uint32_t lengths[2] = { (uint32_t)it.keyLength(), (uint32_t)it.valueLength() };
+			ok = ok && fwrite(lengths, sizeof(lengths), 1, fp) == 1;
+			ok = ok && fwrite(it.keyData(), 1, lengths[0], fp) == lengths[0];
+			ok = ok && fwrite(it.valueData(), 1, lengths[1], fp) == lengths[1];
+
+			uint64_t hash = FlatTable::hashBytes(it.keyData(), lengths[0]);
+			size_t i = hash & (capacity - 1);
+			while ( slots[i].offset != 0 ) {
+				i = (i + 1) & (capacity - 1);
+			}
+			slots[i].hash = hash;
+			slots[i].offset = offset;
+			offset += sizeof(lengths) + lengths[0] + lengths[1];
+		}
+	}
+
+	// The fixed size sections are mapped in place, keep them aligned
+	static const char zeros[8] = { 0 };
+	size_t pad = (8 - offset % 8) % 8;
+	ok = ok && fwrite(zeros, 1, pad, fp) == pad;
+	offset += pad;
+
+	header.indexOffset = offset;
+	header.indexCapacity = capacity;
+	header.entryCount = table.getSize();
+	ok = ok && fwrite(&slots[0], sizeof(SnapshotSlot), capacity, fp) == capacity;
+	offset += capacity * sizeof(SnapshotSlot);
+
+	header.memberOffset = offset;
+	header.memberCount = members.size();
+	for ( size_t i = 0; i < members.size(); i++ ) {
+		SnapshotMember member;
+		memset(&member, 0, sizeof(member));
+		member.id = members[i].getid();
+		member.port = members[i].getport();
+		member.heartbeat = members[i].getheartbeat();
+		member.timestamp = members[i].gettimestamp();
+		ok = ok && fwrite(&member, sizeof(member), 1, fp) == 1;
+		offset += sizeof(member);
+	}
+
+	header.ringOffset = offset;
+	header.ringCount = ring.size();
+	for ( size_t i = 0; i < ring.size(); i++ ) {
+		SnapshotRingNode node;
+		memset(&node, 0, sizeof(node));
+		memcpy(node.addr, ring[i].getAddress()->addr, sizeof(ring[i].getAddress()->addr));
+		node.hashCode = ring[i].getHashCode();
+		ok = ok && fwrite(&node, sizeof(node), 1, fp) == 1;
+		offset += sizeof(node);
+	}
+
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.fileSize = offset;
+	header.heartbeat = heartbeat;
+	ok = ok && fseek(fp, 0, SEEK_SET) == 0;
+	ok = ok && fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && fflush(fp) == 0;
+	ok = ok && fsync(fileno(fp)) == 0;
+	ok = (fclose(fp) == 0) && ok;
+
+	if ( !ok || rename(tmp.c_str(), path.c_str()) != 0 ) {
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Maps a snapshot file read only. Nothing is copied: pages are faulted
+ * 				in as lookups and the background rebuild touch them.
+ *
+ * RETURNS:
+ * the snapshot, or NULL if the file is missing, truncated or of another version
+ */
+Snapshot *Snapshot::open(string path) {
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if ( fd < 0 ) {
+		return NULL;
+	}
+	struct stat st;
+	if ( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader) ) {
+		close(fd);
+		return NULL;
+	}
+	void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if ( base == MAP_FAILED ) {
+		close(fd);
+		return NULL;
+	}
+
+	Snapshot *snapshot = new Snapshot();
+	snapshot->fd = fd;
+	snapshot->base = (const char *)base;
+	snapshot->mappedSize = st.st_size;
+	snapshot->header = (const SnapshotHeader *)base;
+
+	const SnapshotHeader *header = snapshot->header;
+	size_t capacity = header->indexCapacity;
+	if ( header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION
+			|| header->fileSize != (uint64_t)st.st_size
+			|| capacity == 0 || (capacity & (capacity - 1)) != 0
+			|| header->indexOffset % 8 != 0 || header->memberOffset % 8 != 0 || header->ringOffset % 8 != 0
+			|| !inside(header->indexOffset, capacity, sizeof(SnapshotSlot), header->fileSize)
+			|| !inside(header->memberOffset, header->memberCount, sizeof(SnapshotMember), header->fileSize)
+			|| !inside(header->ringOffset, header->ringCount, sizeof(SnapshotRingNode), header->fileSize) ) {
+		delete snapshot;
+		return NULL;
+	}
+	snapshot->index = (const SnapshotSlot *)(snapshot->base + header->indexOffset);
+	if ( !snapshot->entriesInside() ) {
+		delete snapshot;
+		return NULL;
+	}
+	return snapshot;
+}
+
+/**
+ * FUNCTION NAME: inside
+ *
+ * DESCRIPTION: Returns if count items of size bytes from offset on end inside a file of
+ * 				fileSize bytes, without overflowing
+ */
+bool Snapshot::inside(uint64_t offset, uint64_t count, size_t size, uint64_t fileSize) {
+	return offset <= fileSize && count <= (fileSize - offset) / size;
+}
+
+/**
+ * FUNCTION NAME: entriesInside
+ *
+ * DESCRIPTION: Checks that every entry of the index lies inside the file after the header
+ * 				and that its value is one whole record, that their number is the entry
+ * 				count, and that the index has an empty cell to end the probes. A truncated
+ * 				or corrupt file fails the check.
+ */
+bool Snapshot::entriesInside() {
+	uint64_t fileSize = header->fileSize;
+	size_t occupied = 0;
+	for ( size_t i = 0; i < header->indexCapacity; i++ ) {
+		uint64_t offset = index[i].offset;
+		if ( offset == 0 ) {
+			continue;
+		}
+		uint32_t lengths[2];
+		if ( offset < sizeof(SnapshotHeader) || !inside(offset, 1, sizeof(lengths), fileSize) ) {
+			return false;
+		}
+		memcpy(lengths, base + offset, sizeof(lengths));
+		if ( (uint64_t)lengths[0] + lengths[1] > fileSize - offset - sizeof(lengths) ) {
+			return false;
+		}
+		if ( !Record::matches(base + offset + sizeof(lengths) + lengths[0], lengths[1]) ) {
+			return false;
+		}
+		occupied++;
+	}
+	return occupied == header->entryCount && occupied < header->indexCapacity;
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Probes the mapped index for a key
+ *
+ * RETURNS:
+ * index slot of the key, or getIndexCapacity() if it is not in the snapshot
+ */
+size_t Snapshot::find(const char *key, size_t keyLen) {
+	size_t capacity = header->indexCapacity;
+	uint64_t hash = FlatTable::hashBytes(key, keyLen);
+	size_t i = hash & (capacity - 1);
+	while ( index[i].offset != 0 ) {
+		if ( index[i].hash == hash ) {
+			const char *entry = base + index[i].offset;
+			uint32_t length;
+			memcpy(&length, entry, sizeof(length));
+			if ( length == keyLen && memcmp(entry + 2 * sizeof(uint32_t), key, keyLen) == 0 ) {
+				return i;
+			}
+		}
+		i = (i + 1) & (capacity - 1);
+	}
+	return capacity;
+}
+
+/**
+ * FUNCTION NAME: entryAt
+ *
+ * DESCRIPTION: Points key and value at the entry of an index slot
+ *
+ * RETURNS:
+ * true if the slot holds an entry
+ * false otherwise
+ */
+bool Snapshot::entryAt(size_t slot, const char *&key, size_t &keyLen, const char *&value, size_t &valueLen) {
+	if ( slot >= header->indexCapacity || index[slot].offset == 0 ) {
+		return false;
+	}
+	const char *entry = base + index[slot].offset;
+	uint32_t lengths[2];
+	memcpy(lengths, entry, sizeof(lengths));
+	key = entry + sizeof(lengths);
+	keyLen = lengths[0];
+	value = key + keyLen;
+	valueLen = lengths[1];
+	return true;
+}
+
+/**
+ * FUNCTION NAME: getEntryCount
+ *
+ * DESCRIPTION: Number of key value pairs in the snapshot
+ */
+size_t Snapshot::getEntryCount() {
+	return header->entryCount;
+}
+
+/**
+ * FUNCTION NAME: getIndexCapacity
+ *
+ * DESCRIPTION: Number of index slots, the bound for entryAt
+ */
+size_t Snapshot::getIndexCapacity() {
+	return header->indexCapacity;
+}
+
+/**
+ * FUNCTION NAME: getMembers
+ *
+ * DESCRIPTION: Membership list at the time of the snapshot
+ */
+vector<MemberListEntry> Snapshot::getMembers() {
+	vector<MemberListEntry> members;
+	const SnapshotMember *stored = (const SnapshotMember *)(base + header->memberOffset);
+	for ( size_t i = 0; i < header->memberCount; i++ ) {
+		members.push_back(MemberListEntry(stored[i].id, stored[i].port, stored[i].heartbeat, stored[i].timestamp));
+	}
+	return members;
+}
+
+/**
+ * FUNCTION NAME: getRing
+ *
+ * DESCRIPTION: Ring at the time of the snapshot
+ */
+vector<Node> Snapshot::getRing() {
+	vector<Node> ring;
+	const SnapshotRingNode *stored = (const SnapshotRingNode *)(base + header->ringOffset);
+	for ( size_t i = 0; i < header->ringCount; i++ ) {
+		Node node;
+		memcpy(node.nodeAddress.addr, stored[i].addr, sizeof(node.nodeAddress.addr));
+		node.setHashCode(stored[i].hashCode);
+		ring.push_back(node);
+	}
+	return ring;
+}
+
+/**
+ * FUNCTION NAME: getHeartbeat
+ *
+ * DESCRIPTION: Heartbeat of the node at the time of the snapshot
+ */
+long Snapshot::getHeartbeat() {
+	return header->heartbeat;
+}
@@ -0,0 +1,117 @@
+/**********************************
+ * FILE NAME: Snapshot.h
+ *
+ * DESCRIPTION: Header file of Snapshot class
+ **********************************/
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+#include "RangeTable.h"
+#include "Member.h"
+#include "Node.h"
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+#define SNAPSHOT_MAGIC 0x4e53564b
+#define SNAPSHOT_VERSION 2
+// snapshot entries moved into the table per rebuild step
+#define SNAPSHOT_REBUILD_BUDGET 256
+
+/**
+ * STRUCT NAME: SnapshotHeader
+ *
+ * DESCRIPTION: First bytes of a snapshot file. Every position in the file is an
+ * 				offset from its start, so the file can be mapped at any address.
+ */
+typedef struct SnapshotHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t fileSize;
+	uint64_t entryCount;
+	// open addressing index of SnapshotSlot, power of two
+	uint64_t indexCapacity;
+	uint64_t indexOffset;
+	uint64_t memberCount;
+	uint64_t memberOffset;
+	uint64_t ringCount;
+	uint64_t ringOffset;
+	int64_t heartbeat;
+} SnapshotHeader;
+
+/**
+ * STRUCT NAME: SnapshotSlot
+ *
+ * DESCRIPTION: Index cell. Offset 0 marks an empty cell; otherwise it points at
+ * 				a 32 bit key length, a 32 bit value length, the key and the value.
+ */
+typedef struct SnapshotSlot {
+	uint64_t hash;
+	uint64_t offset;
+} SnapshotSlot;
+
+/**
+ * STRUCT NAME: SnapshotMember
+ *
+ * DESCRIPTION: Membership list entry as stored in a snapshot
+ */
+typedef struct SnapshotMember {
+	int32_t id;
+	int16_t port;
+	int16_t pad;
+	int64_t heartbeat;
+	int64_t timestamp;
+} SnapshotMember;
+
+/**
+ * STRUCT NAME: SnapshotRingNode
+ *
+ * DESCRIPTION: Ring position as stored in a snapshot
+ */
+typedef struct SnapshotRingNode {
+	char addr[8];
+	uint64_t hashCode;
+} SnapshotRingNode;
+
+/**
+ * CLASS NAME: Snapshot
+ *
+ * DESCRIPTION: Read only, memory mapped snapshot of a node: its hash table, membership list
+ * 				and ring. Lookups probe the mapped index directly, so a restarted node can serve
+ * 				reads before anything has been copied back into memory. The values are the
+ * 				table's records; open rejects a file with any value that is not one.
+ */
+class Snapshot {
+private:
+	int fd;
+	const char *base;
+	size_t mappedSize;
+	const SnapshotHeader *header;
+	const SnapshotSlot *index;
+
+	Snapshot();
+	Snapshot(const Snapshot &another);
+	Snapshot& operator =(const Snapshot &another);
+	static bool inside(uint64_t offset, uint64_t count, size_t size, uint64_t fileSize);
+	bool entriesInside();
+
+public:
+	virtual ~Snapshot();
+	static bool write(string path, RangeTable &table, vector<MemberListEntry> &members, vector<Node> &ring, long heartbeat);
+	static Snapshot *open(string path);
+	size_t find(const char *key, size_t keyLen);
+	bool entryAt(size_t slot, const char *&key, size_t &keyLen, const char *&value, size_t &valueLen);
+	size_t getEntryCount();
+	size_t getIndexCapacity();
+	vector<MemberListEntry> getMembers();
+	vector<Node> getRing();
+	long getHeartbeat();
+};
+
+#endif /* SNAPSHOT_H_ */
@@ -0,0 +1,113 @@
+/**********************************
+ * FILE NAME: TimerWheel.cpp
+ *
+ * DESCRIPTION: TimerWheel class definition
+ **********************************/
+
+#include "TimerWheel.h"
+
+/**
+ * constructor
+ */
+TimerWheel::TimerWheel(): now(0), pending(0) {}
+
+/**
+ * FUNCTION NAME: place
+ *
+ * DESCRIPTION: Puts a timer into the lowest level whose current window holds its expiry.
+ * 				A timer that is already due, either scheduled late or cascaded on its
+ * 				own tick, goes to the expired list rather than a slot.
+ */
+void TimerWheel::place(const WheelTimer &timer) {
+	int expires = timer.expires;
+	if ( expires <= now ) {
+		expired.push_back(timer);
+		return;
+	}
+	for ( int level = 0; level < WHEEL_LEVELS; level++ ) {
+		int shift = WHEEL_BITS * (level + 1);
+		if ( (expires >> shift) == (now >> shift) ) {
+			slots[level][(expires >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)].push_back(timer);
+			return;
+		}
+	}
+	overflow.push_back(timer);
+}
+
+/**
+ * FUNCTION NAME: cascade
+ *
+ * DESCRIPTION: Time has entered the current slot of level: its timers are placed again,
+ * 				which moves them to lower levels
+ */
+void TimerWheel::cascade(int level) {
+	vector<WheelTimer> timers;
+	if ( level == WHEEL_LEVELS ) {
+		timers.swap(overflow);
+	}
+	else {
+		timers.swap(slots[level][(now >> (WHEEL_BITS * level)) & (WHEEL_SLOTS - 1)]);
+	}
+	for ( size_t i = 0; i < timers.size(); i++ ) {
+		place(timers[i]);
+	}
+}
+
+/**
+ * FUNCTION NAME: schedule
+ *
+ * DESCRIPTION: Adds a timer for key at tick expires
+ */
+void TimerWheel::schedule(const string &key, int expires) {
+	WheelTimer timer;
+	timer.key = key;
+	timer.expires = expires;
+	place(timer);
+	pending++;
+}
+
+/**
+ * FUNCTION NAME: advance
+ *
+ * DESCRIPTION: Moves the wheel forward to tick time and appends the timers that fired to due.
+ * 				Every timer fires on its own tick, or on the first advance after it was
+ * 				scheduled if that tick had already passed.
+ */
+void TimerWheel::advance(int time, vector<WheelTimer> &due) {
+	while ( now < time ) {
+		now++;
+		// entering a new window of a level pulls its slot down, highest level first
+		int top = 0;
+		while ( top < WHEEL_LEVELS && (now & ((1 << (WHEEL_BITS * (top + 1))) - 1)) == 0 ) {
+			top++;
+		}
+		for ( int level = top; level >= 1; level-- ) {
+			cascade(level);
+		}
+		vector<WheelTimer> &slot = slots[0][now & (WHEEL_SLOTS - 1)];
+		pending -= slot.size();
+		due.insert(due.end(), slot.begin(), slot.end());
+		slot.clear();
+	}
+	pending -= expired.size();
+	due.insert(due.end(), expired.begin(), expired.end());
+	expired.clear();
+}
+
+/**
+ * FUNCTION NAME: getPending
+ *
+ * DESCRIPTION: Number of timers that have not fired yet
+ */
+size_t TimerWheel::getPending() {
+	return pending;
+}
+
+/**
+ * FUNCTION NAME: getTime
+ *
+ * DESCRIPTION: Returns the tick the wheel was last advanced to
+ */
+int TimerWheel::getTime() {
+	return now;
+}
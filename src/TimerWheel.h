@@ -0,0 +1,64 @@
+/**********************************
+ * FILE NAME: TimerWheel.h
+ *
+ * DESCRIPTION: Header file of TimerWheel class
+ **********************************/
+
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+/**
+ * Header files
+ */
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// levels of the wheel; level l has slots of 64^l ticks
+#define WHEEL_LEVELS 4
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+
+/**
+ * STRUCT NAME: WheelTimer
+ *
+ * DESCRIPTION: Expiry of one key at tick expires
+ */
+typedef struct WheelTimer {
+	string key;
+	int expires;
+} WheelTimer;
+
+/**
+ * CLASS NAME: TimerWheel
+ *
+ * DESCRIPTION: Hierarchical timer wheel. A timer sits in the lowest level whose window
+ * 				contains its expiry and is moved one level down (cascaded) when time
+ * 				enters its slot, so advancing by a tick only touches the timers that
+ * 				are due or about to be. Timers are never cancelled: the owner checks on
+ * 				expiry whether the timer is still current.
+ */
+class TimerWheel {
+private:
+	vector<WheelTimer> slots[WHEEL_LEVELS][WHEEL_SLOTS];
+	// timers beyond the window of the top level
+	vector<WheelTimer> overflow;
+	// timers whose tick has come, handed out at the end of the next advance
+	vector<WheelTimer> expired;
+	// last tick the wheel was advanced to
+	int now;
+	size_t pending;
+
+	void place(const WheelTimer &timer);
+	void cascade(int level);
+
+public:
+	TimerWheel();
+	void schedule(const string &key, int expires);
+	void advance(int time, vector<WheelTimer> &due);
+	size_t getPending();
+	int getTime();
+};
+
+#endif /* TIMERWHEEL_H_ */
@@ -0,0 +1,199 @@
+/**********************************
+ * FILE NAME: Transport.cpp
+ *
+ * DESCRIPTION: Definition of the parts of the Transport interface shared by the backends
+ **********************************/
+
+#include "Transport.h"
+
+/**
+ * Constructor
+ */
+Transport::Transport(Params *p): par(p) {}
+
+/**
+ * Destructor
+ */
+Transport::~Transport() {
+	releasePool();
+}
+
+/**
+ * FUNCTION NAME: dropped
+ *
+ * DESCRIPTION: Decides if a message of size bytes is lost: it is too large, or the test
+ * 				case drops messages and this one is unlucky
+ */
+bool Transport::dropped(int size) {
+	int sendmsg = rand() % 100;
+
+	return (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100));
+}
+
+/**
+ * FUNCTION NAME: allocFrame
+ *
+ * DESCRIPTION: Frame with room for at least bytes bytes, from the pool if one was released
+ */
+en_msg *Transport::allocFrame(int bytes) {
+	int sizeClass = 0;
+	int capacity = EN_MIN_FRAME_BYTES;
+	while ( capacity < bytes ) {
+		capacity *= 2;
+		sizeClass++;
+	}
+	assert(sizeClass < EN_POOL_CLASSES);
+	en_msg *em;
+	if ( pool[sizeClass].empty() ) {
+		em = (en_msg *)malloc(sizeof(en_msg) + capacity);
+	}
+	else {
+		em = pool[sizeClass].back();
+		pool[sizeClass].pop_back();
+	}
+	em->size = 0;
+	em->capacity = capacity;
+	return em;
+}
+
+/**
+ * FUNCTION NAME: ENrelease
+ *
+ * DESCRIPTION: Returns a frame taken with ENrecvFrames to the pool
+ */
+void Transport::ENrelease(en_msg *frame) {
+	int sizeClass = 0;
+	for ( int capacity = EN_MIN_FRAME_BYTES; capacity < frame->capacity; capacity *= 2 ) {
+		sizeClass++;
+	}
+	pool[sizeClass].push_back(frame);
+}
+
+/**
+ * FUNCTION NAME: releasePool
+ *
+ * DESCRIPTION: Frees the pooled frames
+ */
+void Transport::releasePool() {
+	for ( int i = 0; i < EN_POOL_CLASSES; i++ ) {
+		for ( size_t j = 0; j < pool[i].size(); j++ ) {
+			free(pool[i][j]);
+		}
+		pool[i].clear();
+	}
+}
+
+/**
+ * FUNCTION NAME: ENcommit
+ *
+ * DESCRIPTION: Tells the transport the caller wrote the bytes of the message it reserved
+ * 				last. Frames are only sent once closed, so there is nothing to do unless a
+ * 				backend hands every message to its receiver on its own.
+ */
+void Transport::ENcommit() {
+}
+
+/**
+ * FUNCTION NAME: ENnext
+ *
+ * DESCRIPTION: Steps through the messages of a frame: pos starts at 0, data and size are
+ * 				set to the message at pos, which is moved past it. A size prefix that is
+ * 				cut off, negative or runs past the end of the frame ends the frame.
+ *
+ * RETURNS:
+ * false after the last message, or at a message that does not fit the frame
+ */
+bool Transport::ENnext(en_msg *frame, int &pos, char *&data, int &size) {
+	if ( pos < 0 || pos >= frame->size || frame->size - pos < (int)sizeof(int) ) {
+		return false;
+	}
+	char *payload = (char *)(frame + 1);
+	int length;
+	memcpy(&length, payload + pos, sizeof(int));
+	if ( length < 0 || length > frame->size - pos - (int)sizeof(int) ) {
+		return false;
+	}
+	size = length;
+	data = payload + pos + sizeof(int);
+	pos += sizeof(int) + size;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: ENwellFormed
+ *
+ * DESCRIPTION: Returns if the messages of a frame, each prefixed with its size, fill it
+ * 				exactly, e.g. for a frame that came off a socket
+ */
+bool Transport::ENwellFormed(en_msg *frame) {
+	int pos = 0;
+	char *data;
+	int size;
+	while ( ENnext(frame, pos, data, size) ) {
+	}
+	return pos == frame->size;
+}
+
+/**
+ * FUNCTION NAME: ENsend
+ *
+ * DESCRIPTION: Send function: copies the message into the frame to its destination
+ *
+ * RETURNS:
+ * size
+ */
+int Transport::ENsend(Address *myaddr, Address *toaddr, char *data, int size, int lane) {
+	static char temp[2048];
+	char *buffer = ENreserve(myaddr, toaddr, size, lane);
+
+	if ( buffer == NULL ) {
+		return 0;
+	}
+	memcpy(buffer, data, size);
+	ENcommit();
+
+	#ifdef DEBUGLOG
+		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
+	#endif
+
+	return size;
+}
+
+/**
+ * FUNCTION NAME: ENsend
+ *
+ * DESCRIPTION: Send function
+ *
+ * RETURNS:
+ * size
+ */
+int Transport::ENsend(Address *myaddr, Address *toaddr, const string &data, int lane) {
+	// the buffer is only read: it is copied once, into the frame
+	return this->ENsend(myaddr, toaddr, (char *)data.data(), (data.length() * sizeof(char)), lane);
+}
+
+/**
+ * FUNCTION NAME: ENrecv
+ *
+ * DESCRIPTION: Receive function: hands every message waiting for myaddr on lanes to enq
+ *
+ * RETURN:
+ * 0
+ */
+int Transport::ENrecv(Address *myaddr, unsigned lanes, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
+	// times is always assumed to be 1
+	vector<en_msg *> frames;
+	ENrecvFrames(myaddr, frames, lanes);
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		int pos = 0;
+		char *data;
+		int size;
+		while ( ENnext(frames[i], pos, data, size) ) {
+			// The payload is only valid during the call, enq copies what it keeps
+			(*enq)(queue, data, size);
+		}
+		ENrelease(frames[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+/**********************************
+ * FILE NAME: Transport.h
+ *
+ * DESCRIPTION: Header file of the Transport interface shared by the network backends
+ **********************************/
+
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+// payload bytes after which a frame to one destination is closed and a new one started
+#define EN_BATCH_BYTES 65536
+// frames are allocated in power of two sizes from this up to EN_BATCH_BYTES, and pooled
+#define EN_MIN_FRAME_BYTES 4096
+#define EN_POOL_CLASSES 5
+// lanes of traffic, in priority order; a receiver takes a mask of lanes
+#define EN_LANES 4
+#define LANE_MASK(lane) (1u << (lane))
+#define EN_ALL_LANES ((1u << EN_LANES) - 1)
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+
+using namespace std;
+
+/**
+ * Lanes: membership gossip, client requests, replies to them, and stabilization and
+ * other bulk transfers. Every lane has its own frames, counters and backpressure.
+ */
+enum Lane { LANE_MEMBERSHIP, LANE_REQUEST, LANE_REPLY, LANE_BULK };
+
+/**
+ * Struct Name: en_msg
+ */
+typedef struct en_msg {
+	// Number of bytes after the class: messages, each prefixed with its size as an int
+	int size;
+	// Number of bytes allocated after the class
+	int capacity;
+	// Tick the frame was sent (EmulNet: once closed, the tick it is due)
+	int time;
+	// Lane of the messages
+	int lane;
+	// Source node
+	Address from;
+	// Destination node
+	Address to;
+}en_msg;
+
+/**
+ * CLASS NAME: Transport
+ *
+ * DESCRIPTION: Network interface of the nodes. Messages travel in frames: a backend
+ * 				coalesces the messages from one node to another into one frame and the
+ * 				receiver gets whole frames. Senders may serialize straight into a frame
+ * 				(ENreserve, then ENcommit once the bytes are written) and receivers may
+ * 				take the frames themselves (ENrecvFrames)
+ * 				and hand them back to the frame pool once they are done with the
+ * 				messages (ENrelease). ENsend and ENrecv copy, on top of these.
+ * 				Every message travels on a lane, so one transport carries the traffic
+ * 				of both protocols: each lane has its own frames and backpressure, and a
+ * 				receive takes the lanes of its mask, in priority order.
+ */
+class Transport
+{
+protected:
+	Params* par;
+	// released frames by size class
+	vector<en_msg*> pool[EN_POOL_CLASSES];
+
+	Transport(Params *p);
+	en_msg *allocFrame(int bytes);
+	void releasePool();
+	bool dropped(int size);
+public:
+	virtual ~Transport();
+	virtual void *ENinit(Address *myaddr, short port) = 0;
+	virtual char *ENreserve(Address *myaddr, Address *toaddr, int size, int lane) = 0;
+	virtual int ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes) = 0;
+	virtual bool ENcongested(Address *toaddr, int lane) = 0;
+	virtual int ENcleanup() = 0;
+	virtual void ENcommit();
+	int ENsend(Address *myaddr, Address *toaddr, const string &data, int lane);
+	int ENsend(Address *myaddr, Address *toaddr, char *data, int size, int lane);
+	int ENrecv(Address *myaddr, unsigned lanes, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	static bool ENnext(en_msg *frame, int &pos, char *&data, int &size);
+	static bool ENwellFormed(en_msg *frame);
+	void ENrelease(en_msg *frame);
+};
+
+#endif /* _TRANSPORT_H_ */
@@ -0,0 +1,355 @@
+/**********************************
+ * FILE NAME: UdpTransport.cpp
+ *
+ * DESCRIPTION: Definition of the loopback UDP transport
+ **********************************/
+
+#include "UdpTransport.h"
+
+/**
+ * Constructor
+ */
+UdpTransport::UdpTransport(Params *p, unsigned short basePort): Transport(p), basePort(basePort), nextid(1), polledAt(-1) {
+	epollFd = epoll_create1(0);
+	if ( epollFd < 0 ) {
+		perror("epoll_create1");
+		exit(1);
+	}
+}
+
+/**
+ * Destructor
+ */
+UdpTransport::~UdpTransport() {
+	if ( epollFd >= 0 ) {
+		ENcleanup();
+	}
+}
+
+/**
+ * FUNCTION NAME: ENinit
+ *
+ * DESCRIPTION: Gives the node the next id and opens its sockets
+ */
+void *UdpTransport::ENinit(Address *myaddr, short port) {
+	int id = nextid++;
+	memset(myaddr->addr, 0, sizeof(myaddr->addr));
+	memcpy(myaddr->addr, &id, sizeof(int));
+	for ( int lane = 0; lane < EN_LANES; lane++ ) {
+		socketOf(id, lane);
+	}
+	return myaddr;
+}
+
+/**
+ * FUNCTION NAME: idOf
+ *
+ * DESCRIPTION: Node id of addr
+ */
+int UdpTransport::idOf(Address *addr) {
+	int id;
+	memcpy(&id, addr->addr, sizeof(int));
+	assert(id >= 0 && id < UDP_PORT_SPAN);
+	return id;
+}
+
+/**
+ * FUNCTION NAME: grow
+ *
+ * DESCRIPTION: Makes room for the socket, frames and counters of node id
+ */
+void UdpTransport::grow(int id) {
+	if ( id >= (int)open.size() ) {
+		sockets.resize((id + 1) * EN_LANES, -1);
+		readable.resize((id + 1) * EN_LANES, false);
+		open.resize(id + 1);
+		queued.resize((id + 1) * EN_LANES, 0);
+		refused.resize((id + 1) * EN_LANES, 0);
+	}
+}
+
+/**
+ * FUNCTION NAME: socketOf
+ *
+ * DESCRIPTION: Socket of node id on lane, bound to 127.0.0.1 and watched by epoll the
+ * 				first time it is asked for
+ */
+int UdpTransport::socketOf(int id, int lane) {
+	grow(id);
+	int slot = id * EN_LANES + lane;
+	if ( sockets[slot] >= 0 ) {
+		return sockets[slot];
+	}
+	unsigned short port = basePort + lane * UDP_PORT_SPAN + id;
+
+	int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if ( fd < 0 ) {
+		perror("socket");
+		exit(1);
+	}
+	int rcvbuf = UDP_RCVBUF;
+	if ( setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf)) < 0 ) {
+		// the default buffer only drops more under load
+		fprintf(stderr, "Cannot enlarge the receive buffer of node %d: %s\n", id, strerror(errno));
+	}
+
+	struct sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	local.sin_port = htons(port);
+	if ( bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0 ) {
+		fprintf(stderr, "Cannot bind node %d to port %d: %s\n", id, port, strerror(errno));
+		exit(1);
+	}
+
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.u32 = slot;
+	if ( epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0 ) {
+		fprintf(stderr, "Cannot watch the socket of node %d: %s\n", id, strerror(errno));
+		exit(1);
+	}
+
+	sockets[slot] = fd;
+	return fd;
+}
+
+/**
+ * FUNCTION NAME: openFrame
+ *
+ * DESCRIPTION: Frame from myaddr to toaddr on lane with room for bytes more bytes. A frame
+ * 				that would not fit one datagram any more goes to the outbox as it is and a
+ * 				new one is started.
+ */
+en_msg *UdpTransport::openFrame(Address *myaddr, Address *toaddr, int bytes, int lane) {
+	int dst = idOf(toaddr);
+	grow(dst);
+	vector<en_msg *> &frames = open[dst];
+
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		en_msg *em = frames[i];
+		if ( em->lane != lane || memcmp(em->from.addr, myaddr->addr, sizeof(em->from.addr)) != 0 ) {
+			continue;
+		}
+		if ( em->size + bytes <= UDP_FRAME_BYTES ) {
+			if ( em->size + bytes > em->capacity ) {
+				en_msg *bigger = allocFrame(em->size + bytes);
+				bigger->size = em->size;
+				bigger->lane = em->lane;
+				memcpy(&(bigger->from.addr), &(em->from.addr), sizeof(em->from.addr));
+				memcpy(&(bigger->to.addr), &(em->to.addr), sizeof(em->to.addr));
+				memcpy((char *)(bigger + 1), (char *)(em + 1), em->size);
+				ENrelease(em);
+				em = bigger;
+				frames[i] = em;
+			}
+			return em;
+		}
+		outbox.push_back(em);
+		frames.erase(frames.begin() + i);
+		break;
+	}
+
+	en_msg *em = allocFrame(bytes);
+	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
+	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->to.addr));
+	em->lane = lane;
+	frames.push_back(em);
+	return em;
+}
+
+/**
+ * FUNCTION NAME: ENreserve
+ *
+ * DESCRIPTION: Sends a message of size bytes that the caller writes into the returned
+ * 				buffer, which is the message's place in the open frame to its destination
+ * 				on lane. The buffer is valid until the next call to this transport.
+ *
+ * RETURNS:
+ * the buffer, NULL if the message was dropped
+ */
+char *UdpTransport::ENreserve(Address *myaddr, Address *toaddr, int size, int lane) {
+	if ( dropped(size) ) {
+		return NULL;
+	}
+
+	en_msg *em = openFrame(myaddr, toaddr, sizeof(int) + size, lane);
+	char *end = (char *)(em + 1) + em->size;
+	memcpy(end, &size, sizeof(int));
+	em->size += sizeof(int) + size;
+	queued[idOf(toaddr) * EN_LANES + lane]++;
+
+	return end + sizeof(int);
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Sends the outbox and then the open frames lane by lane, one datagram each,
+ * 				in order. Sending stops at the first frame the kernel refuses for lack of
+ * 				buffer space; it and the frames after it wait for the next flush.
+ */
+void UdpTransport::flush() {
+	for ( int lane = 0; lane < EN_LANES; lane++ ) {
+		for ( size_t dst = 0; dst < open.size(); dst++ ) {
+			for ( size_t i = 0; i < open[dst].size(); i++ ) {
+				if ( open[dst][i]->lane == lane ) {
+					outbox.push_back(open[dst][i]);
+				}
+			}
+		}
+	}
+	for ( size_t dst = 0; dst < open.size(); dst++ ) {
+		open[dst].clear();
+	}
+
+	struct sockaddr_in to;
+	memset(&to, 0, sizeof(to));
+	to.sin_family = AF_INET;
+	to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	while ( !outbox.empty() ) {
+		en_msg *em = outbox.front();
+		to.sin_port = htons(basePort + em->lane * UDP_PORT_SPAN + idOf(&em->to));
+		ssize_t sent = sendto(socketOf(idOf(&em->from), em->lane), (char *)(em + 1), em->size, 0, (struct sockaddr *)&to, sizeof(to));
+		if ( sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) ) {
+			break;
+		}
+		// any other error loses the frame, as the network would
+		outbox.pop_front();
+		ENrelease(em);
+	}
+
+	fill(refused.begin(), refused.end(), 0);
+	for ( size_t i = 0; i < outbox.size(); i++ ) {
+		refused[idOf(&outbox[i]->to) * EN_LANES + outbox[i]->lane]++;
+	}
+}
+
+/**
+ * FUNCTION NAME: drain
+ *
+ * DESCRIPTION: Reads every datagram waiting on the socket of node id on lane into a frame.
+ * 				A datagram is dropped unless it comes from the socket of a node on the
+ * 				same lane and its messages fill it exactly, so no size read from it can
+ * 				point outside the frame.
+ */
+void UdpTransport::drain(int id, int lane, vector<en_msg *> &frames) {
+	while ( true ) {
+		en_msg *em = allocFrame(UDP_FRAME_BYTES);
+		struct sockaddr_in from;
+		socklen_t fromLength = sizeof(from);
+		ssize_t received = recvfrom(sockets[id * EN_LANES + lane], (char *)(em + 1), em->capacity, 0, (struct sockaddr *)&from, &fromLength);
+		if ( received < 0 ) {
+			ENrelease(em);
+			break;
+		}
+		em->size = received;
+		em->lane = lane;
+		int src = (int)ntohs(from.sin_port) - basePort - lane * UDP_PORT_SPAN;
+		if ( from.sin_addr.s_addr != htonl(INADDR_LOOPBACK) || src <= 0 || src >= (int)open.size()
+				|| sockets[src * EN_LANES + lane] < 0 || !ENwellFormed(em) ) {
+			ENrelease(em);
+			continue;
+		}
+		memset(&(em->from.addr), 0, sizeof(em->from.addr));
+		memcpy(em->from.addr, &src, sizeof(int));
+		memset(&(em->to.addr), 0, sizeof(em->to.addr));
+		memcpy(em->to.addr, &id, sizeof(int));
+		frames.push_back(em);
+	}
+}
+
+/**
+ * FUNCTION NAME: ENrecvFrames
+ *
+ * DESCRIPTION: Zero copy receive: appends the datagrams waiting for myaddr on lanes to
+ * 				frames, lane by lane in priority order. The first receive of a tick sends
+ * 				what is pending and asks epoll once which sockets have datagrams waiting;
+ * 				the other receives of the tick only read the sockets it reported.
+ *
+ * RETURN:
+ * number of frames taken
+ */
+int UdpTransport::ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes) {
+	int id = idOf(myaddr);
+	size_t before = frames.size();
+	for ( int lane = 0; lane < EN_LANES; lane++ ) {
+		if ( lanes & LANE_MASK(lane) ) {
+			socketOf(id, lane);
+		}
+	}
+
+	if ( polledAt != par->getcurrtime() ) {
+		polledAt = par->getcurrtime();
+		flush();
+		// room for every socket: level triggered, the ready ones would come back first
+		vector<struct epoll_event> events(sockets.size());
+		int ready = epoll_wait(epollFd, events.data(), events.size(), 0);
+		if ( ready < 0 && errno != EINTR ) {
+			perror("epoll_wait");
+			exit(1);
+		}
+		for ( int i = 0; i < ready; i++ ) {
+			readable[events[i].data.u32] = true;
+		}
+	}
+
+	for ( int lane = 0; lane < EN_LANES; lane++ ) {
+		int slot = id * EN_LANES + lane;
+		if ( !(lanes & LANE_MASK(lane)) ) {
+			continue;
+		}
+		if ( readable[slot] ) {
+			drain(id, lane, frames);
+			readable[slot] = false;
+		}
+		// the node caught up, senders may go on
+		queued[slot] = 0;
+	}
+
+	return frames.size() - before;
+}
+
+/**
+ * FUNCTION NAME: ENcongested
+ *
+ * DESCRIPTION: Backpressure signal: whether senders to toaddr should hold their messages
+ * 				on lane back until toaddr receives
+ */
+bool UdpTransport::ENcongested(Address *toaddr, int lane) {
+	int dst = idOf(toaddr);
+	grow(dst);
+	int slot = dst * EN_LANES + lane;
+	return queued[slot] >= par->NET_HIGH_WATERMARK || refused[slot] > 0;
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Closes the sockets and frees the frames. Called exactly once at the end of
+ * 				the program.
+ */
+int UdpTransport::ENcleanup() {
+	for ( size_t i = 0; i < open.size(); i++ ) {
+		for ( size_t j = 0; j < open[i].size(); j++ ) {
+			free(open[i][j]);
+		}
+		open[i].clear();
+	}
+	for ( size_t i = 0; i < outbox.size(); i++ ) {
+		free(outbox[i]);
+	}
+	outbox.clear();
+	releasePool();
+
+	for ( size_t i = 0; i < sockets.size(); i++ ) {
+		if ( sockets[i] >= 0 ) {
+			close(sockets[i]);
+			sockets[i] = -1;
+		}
+	}
+	close(epollFd);
+	epollFd = -1;
+	return 0;
+}
@@ -0,0 +1,76 @@
+/**********************************
+ * FILE NAME: UdpTransport.h
+ *
+ * DESCRIPTION: Header file of the loopback UDP transport
+ **********************************/
+
+#ifndef _UDPTRANSPORT_H_
+#define _UDPTRANSPORT_H_
+
+#include "stdincludes.h"
+#include <deque>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "Params.h"
+#include "Member.h"
+#include "Transport.h"
+
+// payload bytes of one datagram, below the 65507 bytes UDP carries over IPv4
+#define UDP_FRAME_BYTES 60000
+// ports of one lane: node id binds base port + lane * UDP_PORT_SPAN + id
+#define UDP_PORT_SPAN 1000
+// receive buffer asked for every node socket
+#define UDP_RCVBUF (4 * 1024 * 1024)
+
+/**
+ * CLASS NAME: UdpTransport
+ *
+ * DESCRIPTION: Transport over non-blocking UDP sockets on 127.0.0.1. Node id owns a
+ * 				socket per lane, bound to base port + lane * UDP_PORT_SPAN + id, and a
+ * 				frame is one datagram from the socket of its source on its lane. Frames
+ * 				are sent, lane by lane in priority order, when their destination receives
+ * 				or once full, and the sockets with datagrams waiting are found with one
+ * 				epoll_wait per tick.
+ * 				Senders are held back like with EmulNet while NET_HIGH_WATERMARK messages
+ * 				wait for a node, and while the kernel refuses frames to it (EAGAIN).
+ */
+class UdpTransport : public Transport
+{
+private:
+	unsigned short basePort;
+	int nextid;
+	int epollFd;
+	// tick of the last epoll_wait
+	int polledAt;
+	// sockets and readiness by node id and lane
+	vector<int> sockets;
+	vector<bool> readable;
+	// frames still accepting messages, by destination node id
+	vector<vector<en_msg*> > open;
+	// full frames not sent yet, in send order
+	deque<en_msg*> outbox;
+	// messages sent to a node on a lane since it last received from it, and frames to it
+	// the kernel refused, by node id and lane
+	vector<int> queued;
+	vector<int> refused;
+
+	static int idOf(Address *addr);
+	void grow(int id);
+	int socketOf(int id, int lane);
+	en_msg *openFrame(Address *myaddr, Address *toaddr, int bytes, int lane);
+	void flush();
+	void drain(int id, int lane, vector<en_msg *> &frames);
+public:
+	UdpTransport(Params *p, unsigned short basePort);
+	virtual ~UdpTransport();
+	void *ENinit(Address *myaddr, short port);
+	char *ENreserve(Address *myaddr, Address *toaddr, int size, int lane);
+	int ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes);
+	bool ENcongested(Address *toaddr, int lane);
+	int ENcleanup();
+};
+
+#endif /* _UDPTRANSPORT_H_ */
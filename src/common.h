@@ -7,8 +7,10 @@
 // Transaction Id
 static int g_transID = 0;
 
-// message types, reply is the message from node to coordinator
-enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY};
+// message types, reply is the message from node to coordinator,
+// invalidate revokes a read lease the primary replica granted a coordinator,
+// chunk carries a piece of a value too large for a single message
+enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY, INVALIDATE, CHUNK};
 // enum of replica types
 enum ReplicaType {PRIMARY, SECONDARY, TERTIARY};
 
@@ -0,0 +1,76 @@
+/**********************************
+ * FILE NAME: ArenaTest.cpp
+ *
+ * DESCRIPTION: Arena maps sizes to their classes, recycles freed blocks of a class,
+ * 				serves large requests from malloc and accounts for all of it
+ **********************************/
+
+#include "../Arena.h"
+#include <stdint.h>
+#include "Test.h"
+
+int main() {
+	// classes cover every small size with the smallest block that fits
+	CHECK_EQ(Arena::sizeClass(0), 0);
+	CHECK_EQ(Arena::sizeClass(1), 0);
+	CHECK_EQ(Arena::sizeClass(16), 0);
+	CHECK_EQ(Arena::sizeClass(17), 1);
+	CHECK_EQ(Arena::sizeClass(ARENA_MAX_SMALL), ARENA_CLASSES - 1);
+	CHECK_EQ(Arena::sizeClass(ARENA_MAX_SMALL + 1), -1);
+	for ( size_t size = 1; size <= ARENA_MAX_SMALL; size++ ) {
+		int c = Arena::sizeClass(size);
+		CHECK(Arena::classSize(c) >= size);
+		CHECK(c == 0 || Arena::classSize(c - 1) < size);
+		CHECK_EQ(Arena::blockSize(size), Arena::classSize(c));
+	}
+	CHECK_EQ(Arena::blockSize(5000), sizeof(ArenaLarge) + 5000);
+
+	Arena arena;
+	char *a = (char *)arena.allocate(20);
+	char *b = (char *)arena.allocate(30);
+	CHECK_EQ((uintptr_t)a % 16, (uintptr_t)0);
+	CHECK_EQ((size_t)(b - a), (size_t)32);
+	CHECK_EQ(arena.getBytesInUse(), (size_t)50);
+	CHECK_EQ(arena.getBytesAllocated(), (size_t)64);
+	CHECK_EQ(arena.getBytesReserved(), (size_t)ARENA_SLAB_SIZE);
+
+	// a freed block comes back for the next request of its class, last freed first
+	arena.release(a, 20);
+	arena.release(b, 30);
+	CHECK_EQ(arena.getBytesInUse(), (size_t)0);
+	CHECK_EQ(arena.getBytesAllocated(), (size_t)0);
+	CHECK(arena.allocate(32) == b);
+	CHECK(arena.allocate(17) == a);
+	arena.release(NULL, 100);
+
+	// a class takes a new slab once its slab is carved up
+	size_t blocks = ARENA_SLAB_SIZE / Arena::classSize(Arena::sizeClass(100));
+	for ( size_t i = 0; i < blocks; i++ ) {
+		arena.allocate(100);
+	}
+	CHECK_EQ(arena.getBytesReserved(), (size_t)2 * ARENA_SLAB_SIZE);
+	arena.allocate(100);
+	CHECK_EQ(arena.getBytesReserved(), (size_t)3 * ARENA_SLAB_SIZE);
+
+	// large blocks are held and given back one by one
+	char *big = (char *)arena.allocate(10000);
+	char *bigger = (char *)arena.allocate(20000);
+	memset(big, 'x', 10000);
+	memset(bigger, 'y', 20000);
+	CHECK_EQ((uintptr_t)big % 16, (uintptr_t)0);
+	CHECK_EQ(arena.getBytesReserved(), (size_t)3 * ARENA_SLAB_SIZE + 2 * sizeof(ArenaLarge) + 30000);
+	size_t allocated = arena.getBytesAllocated();
+	arena.release(big, 10000);
+	CHECK_EQ(arena.getBytesAllocated(), allocated - sizeof(ArenaLarge) - 10000);
+	CHECK_EQ(arena.getBytesReserved(), (size_t)3 * ARENA_SLAB_SIZE + sizeof(ArenaLarge) + 20000);
+	CHECK_EQ(bigger[19999], 'y');
+
+	// reset gives everything back at once
+	arena.reset();
+	CHECK_EQ(arena.getBytesInUse(), (size_t)0);
+	CHECK_EQ(arena.getBytesAllocated(), (size_t)0);
+	CHECK_EQ(arena.getBytesReserved(), (size_t)0);
+	CHECK(arena.allocate(40) != NULL);
+
+	return TEST_RESULT;
+}
@@ -0,0 +1,110 @@
+/**********************************
+ * FILE NAME: EmulNetTest.cpp
+ *
+ * DESCRIPTION: A message sent at tick t over a link of latency L is delivered at exactly
+ * 				tick t + L, also when it joins the messages of an earlier tick that its
+ * 				destination did not receive yet, and a congested destination stays so
+ * 				until its backlog falls below the low watermark
+ **********************************/
+
+#include "../EmulNet.h"
+#include "Test.h"
+
+/**
+ * FUNCTION NAME: send
+ *
+ * DESCRIPTION: Sends the one byte message tag from from to to on the request lane
+ */
+static void send(EmulNet &network, Address &from, Address &to, char tag) {
+	char *buffer = network.ENreserve(&from, &to, 1, LANE_REQUEST);
+	CHECK(buffer != NULL);
+	if ( buffer != NULL ) {
+		*buffer = tag;
+	}
+}
+
+/**
+ * FUNCTION NAME: receive
+ *
+ * DESCRIPTION: Receives for to at the current tick, recording the tick each message
+ * 				arrived at by its tag
+ */
+static void receive(EmulNet &network, Params &par, Address &to, map<char, int> &arrived) {
+	vector<en_msg *> frames;
+	network.ENrecvFrames(&to, frames, EN_ALL_LANES);
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		int pos = 0;
+		char *data;
+		int size;
+		while ( EmulNet::ENnext(frames[i], pos, data, size) ) {
+			CHECK_EQ(size, 1);
+			CHECK(arrived.count(*data) == 0);
+			arrived[*data] = par.getcurrtime();
+		}
+		network.ENrelease(frames[i]);
+	}
+}
+
+int main() {
+	const int latency = 3;
+	Params par;
+	par.EN_GPSZ = 2;
+	par.MAX_MSG_SIZE = 4000;
+	par.dropmsg = 0;
+	par.MSG_DROP_PROB = 0;
+	par.NET_DEFAULT_LINK.latency = latency;
+	par.globaltime = 0;
+	EmulNet network(&par);
+	Address a, b;
+	network.ENinit(&a, 0);
+	network.ENinit(&b, 0);
+	map<char, int> arrived;
+
+	// the destination receives every tick
+	for ( par.globaltime = 0; par.globaltime < 10; par.globaltime++ ) {
+		if ( par.globaltime == 2 ) {
+			send(network, a, b, 'x');
+		}
+		receive(network, par, b, arrived);
+	}
+	CHECK(arrived.count('x') == 1);
+	CHECK_EQ(arrived['x'], 2 + latency);
+
+	// the destination receives no earlier than the second send, to the same frame
+	for ( par.globaltime = 20; par.globaltime < 30; par.globaltime++ ) {
+		if ( par.globaltime == 20 ) {
+			send(network, a, b, 'y');
+		}
+		if ( par.globaltime == 22 ) {
+			send(network, a, b, 'z');
+		}
+		if ( par.globaltime >= 22 ) {
+			receive(network, par, b, arrived);
+		}
+	}
+	CHECK(arrived.count('y') == 1 && arrived.count('z') == 1);
+	CHECK_EQ(arrived['y'], 20 + latency);
+	CHECK_EQ(arrived['z'], 22 + latency);
+
+	// senders are held back from the high watermark until the backlog is under the low one
+	par.NET_HIGH_WATERMARK = 10;
+	par.NET_LOW_WATERMARK = 4;
+	map<int, bool> congested;
+	for ( par.globaltime = 40; par.globaltime < 50; par.globaltime++ ) {
+		if ( par.globaltime == 40 || par.globaltime == 41 ) {
+			for ( char tag = 0; tag < 6; tag++ ) {
+				send(network, a, b, (char)('A' + (par.globaltime - 40) * 6 + tag));
+			}
+		}
+		receive(network, par, b, arrived);
+		congested[par.globaltime] = network.ENcongested(&b, LANE_REQUEST);
+	}
+	CHECK(!congested[40]);
+	CHECK(congested[41]);
+	// half of the backlog arrived: still above the low watermark
+	CHECK(congested[40 + latency]);
+	CHECK(!congested[41 + latency]);
+	CHECK_EQ(arrived['L'], 41 + latency);
+
+	return TEST_RESULT;
+}
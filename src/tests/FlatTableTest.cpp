@@ -0,0 +1,126 @@
+/**********************************
+ * FILE NAME: FlatTableTest.cpp
+ *
+ * DESCRIPTION: FlatTable probes groups that wrap around the end of the slots, shifts
+ * 				runs back across the mirrored control bytes on erase, and doubles once
+ * 				more than 7/8 of its slots would be used
+ **********************************/
+
+#include "../FlatTable.h"
+#include "Test.h"
+
+/**
+ * FUNCTION NAME: keysAt
+ *
+ * DESCRIPTION: First count keys whose home slot in a table of capacity slots is home
+ */
+static vector<string> keysAt(size_t home, size_t capacity, size_t count) {
+	vector<string> keys;
+	for ( int i = 0; keys.size() < count; i++ ) {
+		string key = "key" + to_string(i);
+		if ( ((FlatTable::hashBytes(key.data(), key.size()) >> 7) & (capacity - 1)) == home ) {
+			keys.push_back(key);
+		}
+	}
+	return keys;
+}
+
+/**
+ * FUNCTION NAME: slotOf
+ *
+ * DESCRIPTION: Slot key is stored in, the capacity if absent
+ */
+static size_t slotOf(FlatTable &table, const string &key) {
+	for ( FlatTable::iterator it = table.begin(); it != table.end(); ++it ) {
+		if ( it.key() == key ) {
+			return it.getIndex();
+		}
+	}
+	return table.getCapacity();
+}
+
+int main() {
+	string value;
+
+	// a run starting in the last slot wraps around to the first ones
+	FlatTable table;
+	vector<string> last = keysAt(FT_MIN_CAPACITY - 1, FT_MIN_CAPACITY, 4);
+	for ( size_t i = 0; i < last.size(); i++ ) {
+		CHECK(table.emplace(last[i], "v" + last[i]));
+	}
+	CHECK_EQ(table.getCapacity(), (size_t)FT_MIN_CAPACITY);
+	CHECK_EQ(slotOf(table, last[0]), (size_t)FT_MIN_CAPACITY - 1);
+	for ( size_t i = 1; i < last.size(); i++ ) {
+		CHECK_EQ(slotOf(table, last[i]), i - 1);
+		CHECK(table.find(last[i], value));
+		CHECK_EQ(value, "v" + last[i]);
+	}
+	CHECK(!table.emplace(last[2], "again"));
+
+	// a key whose home is taken by the wrapped run goes behind it
+	vector<string> first = keysAt(0, FT_MIN_CAPACITY, 1);
+	CHECK(table.emplace(first[0], "first"));
+	CHECK_EQ(slotOf(table, first[0]), last.size() - 1);
+
+	// erasing the head of the run shifts it back over the end, keys with another home too
+	CHECK_EQ(table.erase(last[0]), (size_t)1);
+	CHECK_EQ(table.erase(last[0]), (size_t)0);
+	CHECK_EQ(slotOf(table, last[1]), (size_t)FT_MIN_CAPACITY - 1);
+	CHECK_EQ(slotOf(table, last[2]), (size_t)0);
+	CHECK_EQ(slotOf(table, last[3]), (size_t)1);
+	CHECK_EQ(slotOf(table, first[0]), (size_t)2);
+	for ( size_t i = 1; i < last.size(); i++ ) {
+		CHECK(table.find(last[i], value));
+		CHECK_EQ(value, "v" + last[i]);
+	}
+	CHECK(table.find(first[0], value));
+	CHECK_EQ(value, "first");
+	CHECK(!table.find(last[0], value));
+
+	// erasing inside the run shifts the rest of it back, up to the first empty slot
+	CHECK_EQ(table.erase(last[2]), (size_t)1);
+	CHECK_EQ(slotOf(table, last[3]), (size_t)0);
+	CHECK_EQ(slotOf(table, first[0]), (size_t)1);
+	CHECK(table.find(first[0], value));
+	CHECK_EQ(table.getSize(), (size_t)3);
+	size_t bytes = first[0].size() + strlen("first");
+	bytes += 2 * last[1].size() + 1 + 2 * last[3].size() + 1;
+	CHECK_EQ(table.getBytes(), bytes);
+
+	// 14 of 16 slots fit, the 15th key doubles the table
+	FlatTable growing;
+	for ( int i = 0; i < FT_MIN_CAPACITY * 7 / 8; i++ ) {
+		CHECK(growing.emplace("g" + to_string(i), to_string(i)));
+	}
+	CHECK_EQ(growing.getCapacity(), (size_t)FT_MIN_CAPACITY);
+	CHECK(growing.emplace("g14", "14"));
+	CHECK_EQ(growing.getCapacity(), (size_t)FT_MIN_CAPACITY * 2);
+	for ( int i = 15; i < 1000; i++ ) {
+		CHECK(growing.emplace("g" + to_string(i), to_string(i)));
+		CHECK(growing.getSize() * 8 <= growing.getCapacity() * 7);
+	}
+	for ( int i = 0; i < 1000; i += 2 ) {
+		CHECK_EQ(growing.erase("g" + to_string(i)), (size_t)1);
+	}
+	for ( int i = 0; i < 1000; i++ ) {
+		CHECK_EQ(growing.count("g" + to_string(i)), (size_t)(i % 2));
+	}
+
+	// keys too long to be inline, and values resized in place
+	string longKey(100, 'k');
+	CHECK(growing.emplace(longKey, "short"));
+	CHECK(growing.assign(longKey, string(5000, 'v')));
+	CHECK(growing.find(longKey, value));
+	CHECK_EQ(value, string(5000, 'v'));
+	CHECK(!growing.assign("absent", "x"));
+
+	// a copy owns its bytes
+	FlatTable copy(growing);
+	growing.clear();
+	CHECK(growing.empty());
+	CHECK_EQ(copy.getSize(), (size_t)501);
+	CHECK(copy.find(longKey, value));
+	CHECK_EQ(value.size(), (size_t)5000);
+
+	return TEST_RESULT;
+}
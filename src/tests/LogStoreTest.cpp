@@ -0,0 +1,253 @@
+/**********************************
+ * FILE NAME: LogStoreTest.cpp
+ *
+ * DESCRIPTION: Crash recovery of LogStore: committed groups survive, uncommitted ones and
+ * 				a torn log tail do not, flushed and compacted runs recover the same keys,
+ * 				and a damaged run is never compacted away
+ **********************************/
+
+#include "../LogStore.h"
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include "Test.h"
+
+/**
+ * FUNCTION NAME: valueOf
+ *
+ * DESCRIPTION: Value of key in table, "<none>" if absent
+ */
+static string valueOf(RangeTable &table, const string &key) {
+	string value;
+	return table.find(key, value) ? value : "<none>";
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Logs key = value
+ */
+static void put(LogStore &store, const string &key, const string &value) {
+	store.put(key.data(), key.size(), value.data(), value.size());
+}
+
+/**
+ * FUNCTION NAME: testCrash
+ *
+ * DESCRIPTION: A process that dies between commits keeps exactly its committed groups
+ */
+static void testCrash(const string &dir) {
+	pid_t child = fork();
+	if ( child == 0 ) {
+		LogStore *store = new LogStore(dir);
+		put(*store, "a", "1");
+		put(*store, "b", "2");
+		store->del("a", 1);
+		put(*store, "c", "3");
+		store->commit();
+		put(*store, "d", "lost");
+		// dies without committing or running the destructor
+		_exit(0);
+	}
+	int status;
+	waitpid(child, &status, 0);
+
+	RangeTable table;
+	LogStore store(dir);
+	CHECK_EQ(store.recover(&table), 4u);
+	CHECK_EQ(valueOf(table, "a"), "<none>");
+	CHECK_EQ(valueOf(table, "b"), "2");
+	CHECK_EQ(valueOf(table, "c"), "3");
+	CHECK_EQ(valueOf(table, "d"), "<none>");
+}
+
+/**
+ * FUNCTION NAME: testTornTail
+ *
+ * DESCRIPTION: A half written group at the end of the log is cut off, and the groups
+ * 				committed after the recovery are replayed behind the valid prefix
+ */
+static void testTornTail(const string &dir) {
+	{
+		LogStore store(dir);
+		put(store, "k1", "v1");
+		store.commit();
+	}
+	FILE *wal = fopen((dir + "/wal.log").c_str(), "ab");
+	CHECK(wal != NULL);
+	fwrite("\x12\x34\x56\x78\x01\x05", 1, 6, wal);
+	fclose(wal);
+	{
+		RangeTable table;
+		LogStore store(dir);
+		CHECK_EQ(store.recover(&table), 1u);
+		CHECK_EQ(valueOf(table, "k1"), "v1");
+		put(store, "k2", "v2");
+		store.commit();
+	}
+	RangeTable table;
+	LogStore store(dir);
+	CHECK_EQ(store.recover(&table), 2u);
+	CHECK_EQ(valueOf(table, "k2"), "v2");
+}
+
+/**
+ * FUNCTION NAME: testRuns
+ *
+ * DESCRIPTION: Keys flushed to sorted runs and merged by compaction recover with their
+ * 				latest value, deletes included
+ */
+static void testRuns(const string &dir) {
+	string value(4096, 'x');
+	size_t keys = 4 * LOG_COMPACT_TRIGGER * LOG_MEMTABLE_LIMIT / value.size() / 3;
+	{
+		LogStore store(dir);
+		for ( size_t i = 0; i < keys; i++ ) {
+			value[0] = 'a' + i % 26;
+			put(store, "key" + to_string(i), value);
+			if ( i % 3 == 0 ) {
+				string key = "key" + to_string(i / 2);
+				store.del(key.data(), key.size());
+			}
+			if ( i % 64 == 0 ) {
+				store.commit();
+			}
+		}
+		store.commit();
+		CHECK(store.getRunCount() >= LOG_COMPACT_TRIGGER);
+		while ( store.compactStep() );
+		CHECK_EQ(store.getRunCount(), 1u);
+	}
+
+	RangeTable table;
+	LogStore store(dir);
+	store.recover(&table);
+	for ( size_t i = 0; i < keys; i++ ) {
+		// key i is deleted at step 2i or 2i + 1, after it was put, if that step is a multiple of 3
+		bool deleted = (2 * i < keys && 2 * i % 3 == 0) || (2 * i + 1 < keys && (2 * i + 1) % 3 == 0);
+		string found = valueOf(table, "key" + to_string(i));
+		if ( deleted ) {
+			CHECK_EQ(found, "<none>");
+		}
+		else {
+			CHECK(found.size() == value.size() && found[0] == (char)('a' + i % 26));
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: fillRuns
+ *
+ * DESCRIPTION: Writes LOG_COMPACT_TRIGGER runs of distinct keys to a store in dir
+ *
+ * RETURNS:
+ * the keys written
+ */
+static size_t fillRuns(const string &dir) {
+	string value(4096, 'r');
+	size_t perRun = LOG_MEMTABLE_LIMIT / value.size() + 1;
+	size_t keys = 0;
+	LogStore store(dir);
+	while ( store.getRunCount() < LOG_COMPACT_TRIGGER ) {
+		for ( size_t i = 0; i < perRun; i++, keys++ ) {
+			put(store, "key" + to_string(keys), value);
+		}
+		store.commit();
+	}
+	return keys;
+}
+
+/**
+ * FUNCTION NAME: damageRun
+ *
+ * DESCRIPTION: Damages the oldest run of the store in dir: cut, overwritten with
+ * 				bytes at offset, or with one value byte flipped
+ *
+ * RETURNS:
+ * the path of the run
+ */
+static string damageRun(const string &dir, const string &how) {
+	char name[64] = "";
+	FILE *manifest = fopen((dir + "/MANIFEST").c_str(), "r");
+	CHECK(manifest != NULL && fscanf(manifest, "%63s", name) == 1);
+	fclose(manifest);
+	string path = dir + "/" + name;
+	struct stat st;
+	CHECK(stat(path.c_str(), &st) == 0);
+
+	if ( how == "truncate" ) {
+		CHECK(truncate(path.c_str(), st.st_size / 2) == 0);
+		return path;
+	}
+	FILE *fp = fopen(path.c_str(), "r+b");
+	CHECK(fp != NULL);
+	if ( how == "length" ) {
+		// the value length of the first entry
+		uint32_t huge = 0xfffffff0;
+		fseek(fp, 1 + sizeof(uint32_t), SEEK_SET);
+		fwrite(&huge, sizeof(huge), 1, fp);
+	}
+	else {
+		fseek(fp, st.st_size / 2, SEEK_SET);
+		int c = fgetc(fp);
+		fseek(fp, st.st_size / 2, SEEK_SET);
+		fputc(c ^ 0x01, fp);
+	}
+	fclose(fp);
+	return path;
+}
+
+/**
+ * FUNCTION NAME: testDamagedRun
+ *
+ * DESCRIPTION: A run that is cut short, holds an impossible length or fails its checksum
+ * 				is recovered as far as it reads, and the compaction keeps it and every
+ * 				other input instead of merging what it read of them
+ */
+static void testDamagedRun(const string &dir, const string &how) {
+	size_t keys = fillRuns(dir);
+	string damaged = damageRun(dir, how);
+
+	RangeTable table;
+	LogStore store(dir);
+	size_t applied = store.recover(&table);
+	CHECK(applied < keys || how == "flip");
+	CHECK(valueOf(table, "key" + to_string(keys - 1)) != "<none>");
+	CHECK(!store.compactStep());
+	CHECK_EQ(store.getRunCount(), (size_t)LOG_COMPACT_TRIGGER);
+	CHECK(access(damaged.c_str(), F_OK) == 0);
+}
+
+/**
+ * FUNCTION NAME: testDamagedCompaction
+ *
+ * DESCRIPTION: A run damaged while it is being merged abandons the compaction
+ */
+static void testDamagedCompaction(const string &dir) {
+	size_t keys = fillRuns(dir);
+	LogStore store(dir);
+	CHECK(store.compactStep());
+	string damaged = damageRun(dir, "truncate");
+	while ( store.compactStep() );
+	CHECK_EQ(store.getRunCount(), (size_t)LOG_COMPACT_TRIGGER);
+	CHECK(access(damaged.c_str(), F_OK) == 0);
+
+	RangeTable table;
+	LogStore reopened(dir);
+	CHECK(reopened.recover(&table) < keys);
+	CHECK(valueOf(table, "key" + to_string(keys - 1)) != "<none>");
+}
+
+int main() {
+	char base[] = "/tmp/logstore-test-XXXXXX";
+	CHECK(mkdtemp(base) != NULL);
+	// the store creates missing parent directories
+	testCrash(string(base) + "/crash/node-1");
+	testTornTail(string(base) + "/torn");
+	testRuns(string(base) + "/runs");
+	testDamagedRun(string(base) + "/truncated", "truncate");
+	testDamagedRun(string(base) + "/length", "length");
+	testDamagedRun(string(base) + "/flipped", "flip");
+	testDamagedCompaction(string(base) + "/merging");
+	system((string("rm -rf ") + base).c_str());
+	return TEST_RESULT;
+}
@@ -0,0 +1,178 @@
+/**********************************
+ * FILE NAME: MessageStreamerTest.cpp
+ *
+ * DESCRIPTION: A streamed value is reassembled whatever order its chunks and message
+ * 				arrive in, chunks whose length or place do not fit are dropped, and
+ * 				messages held back from a congested node are bounded in number and time
+ **********************************/
+
+#include "../MessageStreamer.h"
+#include "../Entry.h"
+#include "Test.h"
+
+/**
+ * CLASS NAME: CaptureTransport
+ *
+ * DESCRIPTION: Transport that keeps every message it is given, in send order, and reports
+ * 				every node as congested while congested is set
+ */
+class CaptureTransport : public Transport {
+public:
+	deque<string> sent;
+	bool congested;
+	CaptureTransport(Params *p): Transport(p), congested(false) {}
+	void *ENinit(Address *myaddr, short port) { return NULL; }
+	char *ENreserve(Address *myaddr, Address *toaddr, int size, int lane) {
+		sent.push_back(string(size, '\0'));
+		return &sent.back()[0];
+	}
+	int ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes) { return 0; }
+	bool ENcongested(Address *toaddr, int lane) { return congested; }
+	int ENcleanup() { return 0; }
+};
+
+/**
+ * FUNCTION NAME: chunk
+ *
+ * DESCRIPTION: A chunk of stream 1 from address from, as it comes off the network
+ */
+static Message chunk(Address &from, size_t offset, size_t length, const string &bytes) {
+	Message message(from, 1, offset, length, bytes);
+	string wire = message.toString();
+	return Message(wire.data(), wire.size());
+}
+
+int main() {
+	Params par;
+	par.MAX_MSG_SIZE = 4000;
+	par.globaltime = 0;
+	Address a("1:0"), b("2:0");
+	CaptureTransport network(&par);
+	MessageStreamer sender(&network, &par, a);
+	MessageStreamer receiver(&network, &par, b);
+
+	// a value larger than one message goes out as chunks, then the message
+	string value;
+	for ( int i = 0; value.size() < 50000; i++ ) {
+		value += to_string(i) + ",";
+	}
+	Message reply(42, a, value, 7, 0);
+	reply.lease = 30;
+	sender.send(&b, reply);
+	CHECK(network.sent.empty());
+	for ( int tick = 0; tick < 10; tick++ ) {
+		sender.pump();
+	}
+	size_t chunks = (value.size() + STREAM_CHUNK_SIZE - 1) / STREAM_CHUNK_SIZE;
+	CHECK_EQ(network.sent.size(), chunks + 1);
+	CHECK_EQ(sender.getChunksSent(), (unsigned long)chunks);
+
+	// every chunk names the transaction of its message
+	for ( size_t i = 0; i + 1 < network.sent.size(); i++ ) {
+		Message message(network.sent[i].data(), network.sent[i].size());
+		CHECK_EQ(message.type, CHUNK);
+		CHECK_EQ(message.transID, 42);
+	}
+
+	// the message first, then the chunks backwards: done with the last chunk only
+	vector<Message> arrivals;
+	arrivals.push_back(Message(network.sent.back().data(), network.sent.back().size()));
+	for ( size_t i = network.sent.size() - 1; i-- > 0; ) {
+		arrivals.push_back(Message(network.sent[i].data(), network.sent[i].size()));
+	}
+	for ( size_t i = 0; i < arrivals.size(); i++ ) {
+		bool ready = receiver.receive(arrivals[i]);
+		CHECK_EQ(ready, i + 1 == arrivals.size());
+		if ( ready ) {
+			CHECK_EQ(arrivals[i].type, READREPLY);
+			CHECK_EQ(arrivals[i].transID, 42);
+			CHECK_EQ(arrivals[i].stream, 0);
+			CHECK_EQ(arrivals[i].timestamp, 7);
+			CHECK_EQ(arrivals[i].lease, 30);
+			CHECK(arrivals[i].value == value);
+		}
+	}
+	CHECK_EQ(receiver.getChunksReceived(), (unsigned long)chunks);
+
+	// a tombstone is replied with its timestamp and flags and no value
+	Message tombstone(43, a, "", 9, RECORD_TOMBSTONE);
+	Message decoded(tombstone.toString());
+	CHECK(decoded.valid);
+	CHECK_EQ(decoded.timestamp, 9);
+	CHECK_EQ(decoded.flags, RECORD_TOMBSTONE);
+	CHECK(decoded.value.empty());
+
+	// a received CREATE views its value in the buffer, a read reply may view a stored one
+	string create = Message(44, a, CREATE, "key", "stored value", SECONDARY).toString();
+	Message created(create.data(), create.size());
+	CHECK(created.valid);
+	CHECK(created.value.empty());
+	CHECK(created.getValueData() >= create.data() && created.getValueData() < create.data() + create.size());
+	CHECK_EQ(string(created.getValueData(), created.getValueSize()), "stored value");
+	CHECK(created.toString() == create);
+	Message viewing(45, a, "", 3, 0);
+	viewing.viewValue(created.getValueData(), created.getValueSize());
+	Message replied(viewing.toString());
+	CHECK_EQ(replied.value, "stored value");
+	CHECK_EQ(viewing.takeValue(), "stored value");
+	CHECK_EQ(viewing.getValueSize(), (size_t)0);
+
+	// chunks that do not fit their stream are dropped before anything is copied
+	Message past = chunk(a, 200, 100, "xy");
+	CHECK(!receiver.receive(past));
+	Message over = chunk(a, 90, 100, string(11, 'x'));
+	CHECK(!receiver.receive(over));
+	Message wrapping = chunk(a, (size_t)-4, 100, string(8, 'x'));
+	CHECK(!receiver.receive(wrapping));
+	Message huge = chunk(a, 0, (size_t)STREAM_MAX_VALUE + 1, "x");
+	CHECK(!receiver.receive(huge));
+	Message empty = chunk(a, 0, 0, "");
+	CHECK(!receiver.receive(empty));
+	CHECK_EQ(receiver.getChunksRejected(), (unsigned long)5);
+
+	// a chunk announcing another length than its stream is dropped too
+	Message first = chunk(a, 0, 100, string(50, 'x'));
+	CHECK(!receiver.receive(first));
+	Message other = chunk(a, 50, 200, string(50, 'y'));
+	CHECK(!receiver.receive(other));
+	CHECK_EQ(receiver.getChunksRejected(), (unsigned long)6);
+
+	// a congested node gets at most STREAM_HOLD_LIMIT messages held back
+	network.sent.clear();
+	network.congested = true;
+	for ( int i = 0; i < STREAM_HOLD_LIMIT + 10; i++ ) {
+		Message request(i, a, READ, "key");
+		sender.send(&b, request);
+	}
+	CHECK(network.sent.empty());
+	CHECK_EQ(sender.getMessagesDeferred(), (unsigned long)STREAM_HOLD_LIMIT);
+	CHECK_EQ(sender.getMessagesDropped(), (unsigned long)10);
+
+	// and they are dropped once held for STREAM_HOLD_TIMEOUT ticks
+	par.globaltime += STREAM_HOLD_TIMEOUT + 1;
+	sender.pump();
+	network.congested = false;
+	sender.pump();
+	CHECK(network.sent.empty());
+	CHECK_EQ(sender.getMessagesDropped(), (unsigned long)STREAM_HOLD_LIMIT + 10);
+
+	// forgetting a failed node drops what is held for it and the streams both ways
+	Address c("3:0");
+	network.congested = true;
+	Message request(1, a, READ, "key");
+	sender.send(&c, request);
+	Message large(2, a, READREPLY, "key", value);
+	sender.send(&c, large);
+	Message partial = chunk(c, 0, 100, string(50, 'x'));
+	CHECK(!receiver.receive(partial));
+	sender.forget(c);
+	receiver.forget(c);
+	network.congested = false;
+	sender.pump();
+	CHECK(network.sent.empty());
+	CHECK_EQ(sender.getMessagesDropped(), (unsigned long)STREAM_HOLD_LIMIT + 11);
+	CHECK_EQ(sender.getStreamsDropped(), (unsigned long)1);
+	CHECK_EQ(receiver.getStreamsDropped(), (unsigned long)1);
+
+	return TEST_RESULT;
+}
@@ -0,0 +1,179 @@
+/**********************************
+ * FILE NAME: ReadCacheTest.cpp
+ *
+ * DESCRIPTION: ReadCache serves a key until its lease ends or it is invalidated, and
+ * 				evicts the least recently used keys to stay within its budget. A
+ * 				coordinator caches nothing from a read whose lease was revoked, also
+ * 				when the replies arrive after the revocation.
+ **********************************/
+
+#include "../MP2Node.h"
+#include "Test.h"
+
+/**
+ * CLASS NAME: CaptureTransport
+ *
+ * DESCRIPTION: Transport that keeps every message it is given, in send order
+ */
+class CaptureTransport : public Transport {
+public:
+	deque<string> sent;
+	CaptureTransport(Params *p): Transport(p) {}
+	void *ENinit(Address *myaddr, short port) { return NULL; }
+	char *ENreserve(Address *myaddr, Address *toaddr, int size, int lane) {
+		sent.push_back(string(size, '\0'));
+		return &sent.back()[0];
+	}
+	int ENrecvFrames(Address *myaddr, vector<en_msg *> &frames, unsigned lanes) { return 0; }
+	bool ENcongested(Address *toaddr, int lane) { return false; }
+	int ENcleanup() { return 0; }
+};
+
+/**
+ * FUNCTION NAME: read
+ *
+ * DESCRIPTION: Reads key at node as its client would
+ *
+ * RETURNS:
+ * the transaction of the READ messages node sent to the replicas
+ * -1 if it answered from its cache
+ */
+static int read(MP2Node &node, CaptureTransport &network, const string &key) {
+	network.sent.clear();
+	node.clientRead(key);
+	if ( network.sent.empty() ) {
+		return -1;
+	}
+	CHECK_EQ(network.sent.size(), (size_t)3);
+	Message message(network.sent[0].data(), network.sent[0].size());
+	CHECK_EQ(message.type, READ);
+	CHECK_EQ(message.key, key);
+	return message.transID;
+}
+
+/**
+ * FUNCTION NAME: reply
+ *
+ * DESCRIPTION: Hands node the READREPLY of from to the read transID, granting a lease
+ * 				until globaltime lease if positive
+ */
+static void reply(MP2Node &node, int transID, Address from, const string &value, int lease) {
+	Message message(transID, from, value, 1, 0);
+	message.lease = lease;
+	string wire = message.toString();
+	Message received(wire.data(), wire.size());
+	node.dispatchMessages(received);
+}
+
+/**
+ * FUNCTION NAME: invalidate
+ *
+ * DESCRIPTION: Hands node the primary replica's revocation of its lease on key
+ */
+static void invalidate(MP2Node &node, Address from, const string &key) {
+	Message message(0, from, INVALIDATE, key);
+	string wire = message.toString();
+	Message received(wire.data(), wire.size());
+	node.dispatchMessages(received);
+}
+
+int main() {
+	// a key is served until the tick its lease ends
+	ReadCache cache(1000);
+	string value;
+	cache.insert("a", "1", 10);
+	CHECK(cache.lookup("a", 9, value));
+	CHECK_EQ(value, "1");
+	CHECK(!cache.lookup("a", 10, value));
+	CHECK(!cache.lookup("a", 5, value));
+	CHECK_EQ(cache.getHits(), (unsigned long)1);
+	CHECK_EQ(cache.getMisses(), (unsigned long)2);
+	CHECK_EQ(cache.getBytes(), (size_t)0);
+
+	// an invalidated key is gone, a second invalidation finds nothing
+	cache.insert("b", "2", 10);
+	CHECK_EQ(cache.getBytes(), (size_t)2 + READ_CACHE_ENTRY_OVERHEAD);
+	CHECK(cache.invalidate("b"));
+	CHECK(!cache.invalidate("b"));
+	CHECK(!cache.lookup("b", 0, value));
+	CHECK_EQ(cache.getInvalidations(), (unsigned long)1);
+
+	// a key inserted again replaces its value and lease
+	cache.insert("c", "3", 10);
+	cache.insert("c", "33", 20);
+	CHECK(cache.lookup("c", 15, value));
+	CHECK_EQ(value, "33");
+	CHECK_EQ(cache.getBytes(), (size_t)3 + READ_CACHE_ENTRY_OVERHEAD);
+
+	// the least recently used keys make room, a key larger than the budget is not cached
+	ReadCache small(3 * (2 + READ_CACHE_ENTRY_OVERHEAD));
+	small.insert("x", "1", 10);
+	small.insert("y", "2", 10);
+	small.insert("z", "3", 10);
+	CHECK(small.lookup("x", 0, value));
+	small.insert("w", "4", 10);
+	CHECK_EQ(small.getEvictions(), (unsigned long)1);
+	CHECK(!small.lookup("y", 0, value));
+	CHECK(small.lookup("x", 0, value));
+	CHECK(small.lookup("z", 0, value));
+	CHECK(small.lookup("w", 0, value));
+	small.insert("big", string(1000, 'v'), 10);
+	CHECK(!small.lookup("big", 0, value));
+	CHECK(small.lookup("w", 0, value));
+	CHECK_EQ(small.getBytes(), (size_t)3 * (2 + READ_CACHE_ENTRY_OVERHEAD));
+
+	// a coordinator of a ring of three nodes, logging to a scratch directory
+	char dir[] = "/tmp/readcachetestXXXXXX";
+	CHECK(mkdtemp(dir) != NULL);
+	CHECK_EQ(chdir(dir), 0);
+	Params par;
+	par.MAX_MSG_SIZE = 4000;
+	par.READ_CACHE = 10000;
+	par.globaltime = 10;
+	Log log(&par);
+	CaptureTransport network(&par);
+	Address a("1:0"), b("2:0"), c("3:0");
+	Member member;
+	member.inited = true;
+	member.inGroup = true;
+	for ( int id = 1; id <= 3; id++ ) {
+		member.memberList.push_back(MemberListEntry(id, 0, 0, 0));
+	}
+	MP2Node node(&member, &par, &network, &log, &a);
+	node.updateRing();
+
+	// a leased quorum read is answered locally the next time
+	int transID = read(node, network, "k1");
+	CHECK(transID > 0);
+	reply(node, transID, b, "v1", 20);
+	reply(node, transID, c, "v1", 0);
+	node.checkMessages();
+	CHECK_EQ(read(node, network, "k1"), -1);
+
+	// the revocation overtakes the replies on another lane: the lease they carry is stale
+	transID = read(node, network, "k2");
+	CHECK(transID > 0);
+	invalidate(node, b, "k2");
+	reply(node, transID, b, "old", 20);
+	reply(node, transID, c, "old", 0);
+	node.checkMessages();
+	CHECK(read(node, network, "k2") > 0);
+
+	// revoked between the replies: the later reply does not grant the lease again
+	transID = read(node, network, "k3");
+	CHECK(transID > 0);
+	reply(node, transID, c, "old", 0);
+	invalidate(node, b, "k3");
+	reply(node, transID, b, "old", 20);
+	node.checkMessages();
+	CHECK(read(node, network, "k3") > 0);
+
+	// the revocation covers only the read that was waiting
+	transID = read(node, network, "k3");
+	reply(node, transID, b, "new", 20);
+	reply(node, transID, c, "new", 0);
+	node.checkMessages();
+	CHECK_EQ(read(node, network, "k3"), -1);
+
+	return TEST_RESULT;
+}
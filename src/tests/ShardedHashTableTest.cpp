@@ -0,0 +1,159 @@
+/**********************************
+ * FILE NAME: ShardedHashTableTest.cpp
+ *
+ * DESCRIPTION: ShardedHashTable behaves like HashTable, its read slots follow every
+ * 				write and retire with expiry and dropped ranges, batches report what
+ * 				they did, and readers racing writers only ever see whole values
+ **********************************/
+
+#include "../ShardedHashTable.h"
+#include <thread>
+#include "Test.h"
+
+// threads of each kind in the race
+#define RACE_THREADS 4
+#define RACE_KEYS 64
+#define RACE_WRITES 20000
+#define RACE_READS 50000
+
+/**
+ * FUNCTION NAME: versioned
+ *
+ * DESCRIPTION: Value of version c: c repeated a number of times that c determines, some
+ * 				short enough for a read slot and some not
+ */
+static string versioned(char c) {
+	return string(8 + (unsigned char)c % 150, c);
+}
+
+/**
+ * FUNCTION NAME: whole
+ *
+ * DESCRIPTION: Returns if value is exactly one version, not pieces of several
+ */
+static bool whole(const string &value) {
+	return !value.empty() && value == versioned(value[0]);
+}
+
+int main() {
+	ShardedHashTable *table = new ShardedHashTable();
+
+	// the HashTable API, with reads served from the slots the writes fill
+	CHECK(table->isEmpty());
+	CHECK(table->create("a", "1"));
+	CHECK(table->create("b", "2"));
+	CHECK_EQ(table->read("a"), "1");
+	CHECK_EQ(table->read("a"), "1");
+	CHECK(table->update("a", "11"));
+	CHECK_EQ(table->read("a"), "11");
+	CHECK(!table->update("c", "3"));
+	CHECK_EQ(table->read("c"), "");
+	CHECK_EQ(table->count("b"), (unsigned long)1);
+	CHECK_EQ(table->currentSize(), (unsigned long)2);
+	CHECK(table->deleteKey("b"));
+	CHECK(!table->deleteKey("b"));
+	CHECK_EQ(table->read("b"), "");
+	CHECK_EQ(table->count("b"), (unsigned long)0);
+
+	// values too large for a slot are read under the lock
+	string large(1000, 'x');
+	CHECK(table->create("large", large));
+	CHECK_EQ(table->read("large"), large);
+	CHECK(table->update("large", "small"));
+	CHECK_EQ(table->read("large"), "small");
+
+	// records, tombstones and expiry
+	Entry entry("v", 3, SECONDARY);
+	entry.expires = 5;
+	CHECK(table->createRecord("r", entry));
+	Entry found("", 0, PRIMARY);
+	CHECK(table->readRecord("r", found));
+	CHECK_EQ(found.value, "v");
+	CHECK_EQ(found.timestamp, 3);
+	CHECK_EQ(found.replica, SECONDARY);
+	CHECK_EQ(found.expires, 5);
+	CHECK_EQ(table->expireRecords(10), (size_t)1);
+	CHECK(!table->readRecord("r", found));
+	Entry kept("k", 4, PRIMARY);
+	CHECK(table->createRecord("t", kept));
+	CHECK(table->readRecord("t", found));
+	CHECK(table->deleteRecord("t", 6));
+	CHECK(table->readRecord("t", found));
+	CHECK(found.isTombstone());
+	CHECK_EQ(found.timestamp, 6);
+	CHECK(!table->deleteRecord("t", 7));
+
+	// a dropped range takes its keys out of the slots too
+	CHECK_EQ(table->read("a"), "11");
+	table->dropRange(RangeTable::token("a", 1));
+	CHECK_EQ(table->read("a"), "");
+	CHECK_EQ(table->count("a"), (unsigned long)0);
+	table->clear();
+	CHECK_EQ(table->read("large"), "");
+	CHECK(table->isEmpty());
+
+	// batches visit the keys of every shard together and keep the caller's order
+	vector<string> keys, values;
+	for ( int i = 0; i < 1000; i++ ) {
+		keys.push_back("key" + to_string(i));
+		values.push_back("value" + to_string(i));
+	}
+	CHECK_EQ(table->createBatch(keys, values), (size_t)1000);
+	vector<string> read;
+	table->readBatch(keys, read);
+	CHECK(read == values);
+	vector<string> some(keys.begin(), keys.begin() + 10);
+	some.push_back("absent");
+	vector<string> updates(some.size(), "new");
+	CHECK_EQ(table->updateBatch(some, updates), (size_t)10);
+	table->readBatch(some, read);
+	CHECK_EQ(read[0], "new");
+	CHECK_EQ(read[9], "new");
+	CHECK_EQ(read[10], "");
+	CHECK_EQ(table->deleteBatch(some), (size_t)10);
+	CHECK_EQ(table->currentSize(), (unsigned long)990);
+	table->readBatch(keys, read);
+	CHECK_EQ(read[5], "");
+	CHECK_EQ(read[500], "value500");
+	table->clear();
+
+	// readers racing writers never see a torn or missing value
+	vector<string> race;
+	for ( int i = 0; i < RACE_KEYS; i++ ) {
+		race.push_back("race" + to_string(i));
+		table->create(race[i], versioned('a'));
+	}
+	atomic<int> torn(0);
+	vector<thread> threads;
+	for ( int t = 0; t < RACE_THREADS; t++ ) {
+		threads.push_back(thread([table, &race, t]() {
+			for ( int i = 0; i < RACE_WRITES; i++ ) {
+				table->update(race[(i * 7 + t) % RACE_KEYS], versioned((char)('a' + (i + t) % 26)));
+			}
+		}));
+		threads.push_back(thread([table, &race, &torn, t]() {
+			vector<string> batch;
+			for ( int i = 0; i < RACE_READS; i++ ) {
+				if ( !whole(table->read(race[(i + t) % RACE_KEYS])) ) {
+					torn++;
+				}
+				if ( i % 1000 == 0 ) {
+					table->readBatch(race, batch);
+					for ( size_t j = 0; j < batch.size(); j++ ) {
+						if ( !whole(batch[j]) ) {
+							torn++;
+						}
+					}
+				}
+			}
+		}));
+	}
+	for ( size_t t = 0; t < threads.size(); t++ ) {
+		threads[t].join();
+	}
+	CHECK_EQ(torn.load(), 0);
+	CHECK_EQ(table->currentSize(), (unsigned long)RACE_KEYS);
+
+	delete table;
+	return TEST_RESULT;
+}
@@ -0,0 +1,151 @@
+/**********************************
+ * FILE NAME: SnapshotTest.cpp
+ *
+ * DESCRIPTION: Snapshot files that are truncated, whose entries point outside the file or
+ * 				whose values are not whole records are rejected by Snapshot::open, and
+ * 				records are read from unaligned places in the mapped file
+ **********************************/
+
+#include "../Snapshot.h"
+#include "../Entry.h"
+#include "Test.h"
+
+/**
+ * FUNCTION NAME: readFile
+ *
+ * DESCRIPTION: Bytes of the file at path
+ */
+static string readFile(const string &path) {
+	string bytes;
+	char chunk[4096];
+	size_t n;
+	FILE *fp = fopen(path.c_str(), "rb");
+	while ( fp != NULL && (n = fread(chunk, 1, sizeof(chunk), fp)) > 0 ) {
+		bytes.append(chunk, n);
+	}
+	if ( fp != NULL ) {
+		fclose(fp);
+	}
+	return bytes;
+}
+
+/**
+ * FUNCTION NAME: writeFile
+ *
+ * DESCRIPTION: Replaces the file at path with bytes
+ */
+static void writeFile(const string &path, const string &bytes) {
+	FILE *fp = fopen(path.c_str(), "wb");
+	fwrite(bytes.data(), 1, bytes.size(), fp);
+	fclose(fp);
+}
+
+/**
+ * FUNCTION NAME: opens
+ *
+ * DESCRIPTION: Returns if the file holding bytes opens as a snapshot
+ */
+static bool opens(const string &path, const string &bytes) {
+	writeFile(path, bytes);
+	Snapshot *snapshot = Snapshot::open(path);
+	delete snapshot;
+	return snapshot != NULL;
+}
+
+int main() {
+	char path[] = "/tmp/snapshot-test-XXXXXX";
+	int fd = mkstemp(path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	RangeTable table;
+	for ( int i = 0; i < 100; i++ ) {
+		Entry entry(string(i, 'v'), i, PRIMARY);
+		string record(entry.recordSize(), '\0');
+		entry.writeRecord(&record[0]);
+		table.emplace("key" + to_string(i), record);
+	}
+	vector<MemberListEntry> members;
+	vector<Node> ring;
+	CHECK(Snapshot::write(path, table, members, ring, 7));
+	string good = readFile(path);
+
+	Snapshot *snapshot = Snapshot::open(path);
+	CHECK(snapshot != NULL);
+	if ( snapshot != NULL ) {
+		CHECK_EQ(snapshot->getEntryCount(), 100u);
+		const char *key, *value;
+		size_t keyLen, valueLen;
+		CHECK(snapshot->entryAt(snapshot->find("key42", 5), key, keyLen, value, valueLen));
+		Record record(value);
+		CHECK_EQ(record.getTimestamp(), 42);
+		CHECK_EQ(record.getValue(), string(42, 'v'));
+		// the entries follow each other, so records start at any byte
+		bool unaligned = false;
+		for ( size_t i = 0; i < snapshot->getIndexCapacity(); i++ ) {
+			if ( snapshot->entryAt(i, key, keyLen, value, valueLen) ) {
+				unaligned = unaligned || (uintptr_t)value % sizeof(int) != 0;
+				CHECK_EQ(Record(value).getValueLength() + sizeof(RecordHeader), valueLen);
+			}
+		}
+		CHECK(unaligned);
+		delete snapshot;
+	}
+
+	SnapshotHeader header;
+	memcpy(&header, good.data(), sizeof(header));
+
+	// cut short, with the header telling the truth about the new size
+	string truncated = good.substr(0, good.size() - 10);
+	header.fileSize = truncated.size();
+	memcpy(&truncated[0], &header, sizeof(header));
+	CHECK(!opens(path, truncated));
+	header.fileSize = good.size();
+
+	// an index cell pointing past the end of the file, or into the header
+	const SnapshotSlot *slots = (const SnapshotSlot *)(good.data() + header.indexOffset);
+	size_t used = 0;
+	while ( slots[used].offset == 0 ) {
+		used++;
+	}
+	size_t cell = header.indexOffset + used * sizeof(SnapshotSlot) + offsetof(SnapshotSlot, offset);
+	uint64_t offsets[] = { good.size() - 4, good.size() + 4096, 8, ~(uint64_t)0 };
+	for ( size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++ ) {
+		string corrupt = good;
+		memcpy(&corrupt[cell], &offsets[i], sizeof(uint64_t));
+		CHECK(!opens(path, corrupt));
+	}
+
+	// an entry whose value length runs past the end of the file
+	string corrupt = good;
+	uint32_t valueLen = 0x7fffffff;
+	memcpy(&corrupt[slots[used].offset + sizeof(uint32_t)], &valueLen, sizeof(valueLen));
+	CHECK(!opens(path, corrupt));
+
+	// a record whose header claims fewer or more value bytes than its entry holds
+	uint32_t lengths[2];
+	memcpy(lengths, &good[slots[used].offset], sizeof(lengths));
+	size_t recordAt = slots[used].offset + sizeof(lengths) + lengths[0];
+	uint32_t claims[] = { lengths[1] - (uint32_t)sizeof(RecordHeader) + 1, 0x7fffffff };
+	for ( size_t i = 0; i < sizeof(claims) / sizeof(claims[0]); i++ ) {
+		corrupt = good;
+		memcpy(&corrupt[recordAt + offsetof(RecordHeader, valueLen)], &claims[i], sizeof(uint32_t));
+		CHECK(!opens(path, corrupt));
+	}
+
+	// an entry too short for a record header
+	corrupt = good;
+	uint32_t shortLen = sizeof(RecordHeader) - 1;
+	memcpy(&corrupt[slots[used].offset + sizeof(uint32_t)], &shortLen, sizeof(shortLen));
+	CHECK(!opens(path, corrupt));
+
+	// an index section overflowing the file size
+	corrupt = good;
+	header.indexOffset = ~(uint64_t)0 - 8;
+	memcpy(&corrupt[0], &header, sizeof(header));
+	CHECK(!opens(path, corrupt));
+
+	CHECK(opens(path, good));
+	unlink(path);
+	return TEST_RESULT;
+}
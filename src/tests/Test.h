@@ -0,0 +1,29 @@
+/**********************************
+ * FILE NAME: Test.h
+ *
+ * DESCRIPTION: Checks shared by the unit tests. A test program runs its checks in main
+ * 				and returns TEST_RESULT; make test runs every test program.
+ **********************************/
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+static int testFailures = 0;
+
+/*
+ * Macros
+ */
+// reports a failed condition with its place and goes on with the test
+#define CHECK(cond) do { \
+		if ( !(cond) ) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+			testFailures++; \
+		} \
+	} while ( 0 )
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+// exit status of a test program, printing its outcome
+#define TEST_RESULT (printf("%s: %s\n", __FILE__, testFailures == 0 ? "passed" : "FAILED"), testFailures == 0 ? 0 : 1)
+
+#endif /* TEST_H_ */
@@ -0,0 +1,59 @@
+/**********************************
+ * FILE NAME: TimerWheelTest.cpp
+ *
+ * DESCRIPTION: Every TimerWheel timer fires on exactly its own tick, on every level of
+ * 				the wheel and from the overflow list
+ **********************************/
+
+#include "../TimerWheel.h"
+#include "Test.h"
+
+int main() {
+	TimerWheel wheel;
+	vector<WheelTimer> due;
+
+	// ticks on each level, on and next to slot and window boundaries, and in the overflow
+	int ticks[] = { 1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 262143, 262144, 262145,
+			(1 << 24) - 1, 1 << 24, (1 << 24) + 1, (1 << 24) + 4096 };
+	size_t count = sizeof(ticks) / sizeof(ticks[0]);
+	for ( size_t i = 0; i < count; i++ ) {
+		wheel.schedule("t" + to_string(ticks[i]), ticks[i]);
+	}
+	CHECK_EQ(wheel.getPending(), count);
+
+	size_t fired = 0;
+	for ( int now = 1; now <= ticks[count - 1]; now++ ) {
+		wheel.advance(now, due);
+		for ( size_t i = 0; i < due.size(); i++ ) {
+			CHECK_EQ(due[i].expires, now);
+			CHECK_EQ(due[i].key, "t" + to_string(now));
+		}
+		fired += due.size();
+		due.clear();
+	}
+	CHECK_EQ(fired, count);
+	CHECK_EQ(wheel.getPending(), (size_t)0);
+
+	// a timer scheduled for a tick that has passed fires on the next advance
+	int now = wheel.getTime();
+	wheel.schedule("late", now - 10);
+	wheel.schedule("current", now);
+	wheel.advance(now, due);
+	CHECK_EQ(due.size(), (size_t)2);
+	due.clear();
+
+	// a jump over several ticks hands out every timer in between once
+	wheel.schedule("a", now + 5);
+	wheel.schedule("b", now + 70);
+	wheel.schedule("c", now + 200);
+	wheel.advance(now + 100, due);
+	CHECK_EQ(due.size(), (size_t)2);
+	due.clear();
+	wheel.advance(now + 199, due);
+	CHECK(due.empty());
+	wheel.advance(now + 200, due);
+	CHECK_EQ(due.size(), (size_t)1);
+	CHECK_EQ(wheel.getPending(), (size_t)0);
+
+	return TEST_RESULT;
+}
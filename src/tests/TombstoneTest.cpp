@@ -0,0 +1,85 @@
+/**********************************
+ * FILE NAME: TombstoneTest.cpp
+ *
+ * DESCRIPTION: A tombstone in the HashTable is only replaced by a newer write, wins a
+ * 				tie against a write of the same tick and is purged past its horizon
+ **********************************/
+
+#include "../HashTable.h"
+#include "Test.h"
+
+/**
+ * FUNCTION NAME: isDeleted
+ *
+ * DESCRIPTION: Returns if the key is held as a tombstone
+ */
+static bool isDeleted(HashTable &ht, const string &key) {
+	Record record;
+	return ht.readRecord(key, record) && record.isTombstone();
+}
+
+/**
+ * FUNCTION NAME: valueOf
+ *
+ * DESCRIPTION: Value held for the key, empty if it is missing or deleted
+ */
+static string valueOf(HashTable &ht, const string &key) {
+	Record record;
+	if ( !ht.readRecord(key, record) || record.isTombstone() ) {
+		return "";
+	}
+	return record.getValue();
+}
+
+int main() {
+	HashTable ht;
+
+	// a stale copy written before the delete does not bring the key back
+	Entry first("one", 10, PRIMARY);
+	CHECK(ht.createRecord("k", first));
+	CHECK(ht.deleteRecord("k", 20));
+	Entry stale("one", 15, SECONDARY);
+	CHECK(ht.createRecord("k", stale));
+	CHECK(isDeleted(ht, "k"));
+
+	// a write of the same tick as the delete loses to it
+	Entry tie("two", 20, PRIMARY);
+	CHECK(ht.createRecord("k", tie));
+	CHECK(isDeleted(ht, "k"));
+	CHECK(Entry::supersedes(20, true, 20, false));
+	CHECK(!Entry::supersedes(20, false, 20, true));
+
+	// a newer write replaces the tombstone
+	Entry newer("three", 21, PRIMARY);
+	CHECK(ht.createRecord("k", newer));
+	CHECK_EQ(valueOf(ht, "k"), string("three"));
+
+	// a live record is never replaced by create, whatever its timestamp
+	Entry later("four", 30, PRIMARY);
+	CHECK(ht.createRecord("k", later));
+	CHECK_EQ(valueOf(ht, "k"), string("three"));
+
+	// a delete stamped after a live record hides it, an older tombstone does not
+	CHECK(ht.deleteRecord("k", 40));
+	CHECK(!ht.deleteRecord("k", 41));
+	Entry old("zero", 5, SECONDARY, RECORD_TOMBSTONE);
+	CHECK(ht.createRecord("k", old));
+	Record record;
+	CHECK(ht.readRecord("k", record));
+	CHECK_EQ(record.getTimestamp(), 40);
+
+	// tombstones are kept until the horizon passes their timestamp
+	CHECK(ht.createRecord("other", first));
+	CHECK_EQ(ht.purgeTombstones(40, RING_SIZE * 4), (size_t)0);
+	CHECK(isDeleted(ht, "k"));
+	// small steps, as the background compaction takes, until the sweep reaches the key
+	size_t purged = 0;
+	for ( int i = 0; i < RING_SIZE && purged == 0; i++ ) {
+		purged = ht.purgeTombstones(41, 8);
+	}
+	CHECK_EQ(purged, (size_t)1);
+	CHECK(!ht.readRecord("k", record));
+	CHECK_EQ(valueOf(ht, "other"), string("one"));
+
+	return TEST_RESULT;
+}
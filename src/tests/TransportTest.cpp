@@ -0,0 +1,176 @@
+/**********************************
+ * FILE NAME: TransportTest.cpp
+ *
+ * DESCRIPTION: A frame whose size prefixes do not fit it ends at the first bad one,
+ * 				UdpTransport drops datagrams that do not come from a node's socket, and
+ * 				a ShmTransport message reaches its receiver while its sender sits idle
+ **********************************/
+
+#include "../UdpTransport.h"
+#include "../ShmTransport.h"
+#include <sys/wait.h>
+#include "Test.h"
+
+// ports of the test transport, clear of the default PORTNUM
+#define TEST_BASE_PORT 30000
+
+/**
+ * FUNCTION NAME: frameOf
+ *
+ * DESCRIPTION: Frame holding bytes as its payload, to be freed by the caller
+ */
+static en_msg *frameOf(const string &bytes) {
+	en_msg *frame = (en_msg *)malloc(sizeof(en_msg) + bytes.size());
+	memset(frame, 0, sizeof(en_msg));
+	frame->size = bytes.size();
+	frame->capacity = bytes.size();
+	memcpy(frame + 1, bytes.data(), bytes.size());
+	return frame;
+}
+
+/**
+ * FUNCTION NAME: prefixed
+ *
+ * DESCRIPTION: message prefixed with size, as it is in a frame
+ */
+static string prefixed(int size, const string &message) {
+	return string((char *)&size, sizeof(int)) + message;
+}
+
+/**
+ * FUNCTION NAME: receive
+ *
+ * DESCRIPTION: Messages to addr that network has now, on any lane
+ */
+static vector<string> receive(Transport &network, Address &addr) {
+	vector<string> received;
+	vector<en_msg *> frames;
+	network.ENrecvFrames(&addr, frames, EN_ALL_LANES);
+	for ( size_t i = 0; i < frames.size(); i++ ) {
+		int pos = 0;
+		char *data;
+		int size;
+		while ( Transport::ENnext(frames[i], pos, data, size) ) {
+			received.push_back(string(data, size));
+		}
+		network.ENrelease(frames[i]);
+	}
+	return received;
+}
+
+/**
+ * FUNCTION NAME: messagesOf
+ *
+ * DESCRIPTION: Messages ENnext finds in a frame of bytes
+ */
+static vector<string> messagesOf(const string &bytes, bool &wellFormed) {
+	en_msg *frame = frameOf(bytes);
+	vector<string> messages;
+	int pos = 0;
+	char *data;
+	int size;
+	while ( Transport::ENnext(frame, pos, data, size) ) {
+		messages.push_back(string(data, size));
+	}
+	wellFormed = Transport::ENwellFormed(frame);
+	free(frame);
+	return messages;
+}
+
+int main() {
+	bool wellFormed;
+
+	// messages that fill the frame exactly
+	vector<string> messages = messagesOf(prefixed(2, "ab") + prefixed(0, "") + prefixed(3, "cde"), wellFormed);
+	CHECK_EQ(messages.size(), (size_t)3);
+	CHECK_EQ(messages[2], "cde");
+	CHECK(wellFormed);
+	messagesOf("", wellFormed);
+	CHECK(wellFormed);
+
+	// a size past the end, a negative one and a cut off prefix end the frame there
+	messages = messagesOf(prefixed(2, "ab") + prefixed(100, "cde"), wellFormed);
+	CHECK_EQ(messages.size(), (size_t)1);
+	CHECK(!wellFormed);
+	messages = messagesOf(prefixed(-8, "abcdefgh"), wellFormed);
+	CHECK(messages.empty());
+	CHECK(!wellFormed);
+	messages = messagesOf(prefixed(1, "a") + "xy", wellFormed);
+	CHECK_EQ(messages.size(), (size_t)1);
+	CHECK(!wellFormed);
+	messages = messagesOf(prefixed(0x7fffffff, "a"), wellFormed);
+	CHECK(messages.empty());
+
+	// a datagram from a node arrives, one from a port no node owns does not
+	Params par;
+	par.MAX_MSG_SIZE = 4000;
+	par.dropmsg = 0;
+	par.globaltime = 0;
+	UdpTransport network(&par, TEST_BASE_PORT);
+	Address a, b;
+	network.ENinit(&a, 0);
+	network.ENinit(&b, 0);
+	CHECK_EQ(network.ENsend(&a, &b, "hello", LANE_REQUEST), 5);
+
+	int stranger = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	local.sin_port = htons(TEST_BASE_PORT + LANE_REQUEST * UDP_PORT_SPAN + 500);
+	CHECK_EQ(bind(stranger, (struct sockaddr *)&local, sizeof(local)), 0);
+	struct sockaddr_in to = local;
+	int id;
+	memcpy(&id, b.addr, sizeof(int));
+	to.sin_port = htons(TEST_BASE_PORT + LANE_REQUEST * UDP_PORT_SPAN + id);
+	string forged = prefixed(6, "forged");
+	CHECK(sendto(stranger, forged.data(), forged.size(), 0, (struct sockaddr *)&to, sizeof(to)) == (ssize_t)forged.size());
+
+	vector<string> received;
+	for ( par.globaltime = 1; par.globaltime < 4; par.globaltime++ ) {
+		vector<en_msg *> frames;
+		network.ENrecvFrames(&b, frames, EN_ALL_LANES);
+		for ( size_t i = 0; i < frames.size(); i++ ) {
+			CHECK(frames[i]->from == a);
+			int pos = 0;
+			char *data;
+			int size;
+			while ( Transport::ENnext(frames[i], pos, data, size) ) {
+				received.push_back(string(data, size));
+			}
+			network.ENrelease(frames[i]);
+		}
+	}
+	CHECK_EQ(received.size(), (size_t)1);
+	CHECK(!received.empty() && received[0] == "hello");
+	close(stranger);
+
+	// a forked sender that goes idle after sending does not hold its message back
+	par.EN_GPSZ = 2;
+	ShmTransport shared(&par);
+	Address sender, receiver;
+	shared.ENinit(&sender, 0);
+	shared.ENinit(&receiver, 0);
+	int sent[2], done[2];
+	CHECK(pipe(sent) == 0 && pipe(done) == 0);
+	pid_t child = fork();
+	if ( child == 0 ) {
+		char c = 0;
+		shared.ENsend(&sender, &receiver, "shared", LANE_REQUEST);
+		if ( write(sent[1], &c, 1) != 1 || read(done[0], &c, 1) != 1 ) {
+			_exit(1);
+		}
+		_exit(0);
+	}
+	char c = 0;
+	CHECK_EQ(read(sent[0], &c, 1), (ssize_t)1);
+	received = receive(shared, receiver);
+	CHECK_EQ(received.size(), (size_t)1);
+	CHECK(!received.empty() && received[0] == "shared");
+	CHECK_EQ(write(done[1], &c, 1), (ssize_t)1);
+	int status;
+	CHECK_EQ(waitpid(child, &status, 0), child);
+	CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	return TEST_RESULT;
+}